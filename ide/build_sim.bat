@@ -41,6 +41,23 @@ cl /nologo /W4 /O2 /I "%SRC_DIR%" ^
     "%SRC_DIR%\pipeline.c" ^
     "%SRC_DIR%\cache.c" ^
     "%SRC_DIR%\bus.c" ^
+    "%SRC_DIR%\pipeline_dual.c" ^
+    "%SRC_DIR%\profile.c" ^
+    "%SRC_DIR%\sharing.c" ^
+    "%SRC_DIR%\busstats.c" ^
+    "%SRC_DIR%\missclass.c" ^
+    "%SRC_DIR%\interval.c" ^
+    "%SRC_DIR%\platform.c" ^
+    "%SRC_DIR%\bench.c" ^
+    "%SRC_DIR%\verify.c" ^
+    "%SRC_DIR%\schedule.c" ^
+    "%SRC_DIR%\mesisim.c" ^
+    "%SRC_DIR%\sweep.c" ^
+    "%SRC_DIR%\memtrace.c" ^
+    "%SRC_DIR%\stackdist.c" ^
+    "%SRC_DIR%\functional.c" ^
+    "%SRC_DIR%\jit.c" ^
+    "%SRC_DIR%\batch.c" ^
     /link /SUBSYSTEM:CONSOLE
 
 if %ERRORLEVEL% EQU 0 (
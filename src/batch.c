@@ -0,0 +1,672 @@
+/*
+ * =============================================================================
+ * Lockstep Batch of Functional Runs
+ * =============================================================================
+ * sim --batch=DIR runs one program on many data sets: DIR/imem0-3.txt is
+ * the program, and every subdirectory of DIR with a memin.txt is one
+ * instance, whose outputs (memout, regout, dsram, tsram, stats) are
+ * written next to its memin.txt. Instances run in functional mode
+ * (functional.c): ISA semantics and caches, no timing.
+ *
+ * Instances are grouped BATCH_LANES at a time. A group keeps its
+ * instances' registers as structure-of-arrays, regs[core][reg][lane], and
+ * steps all lanes together while they are at the same PCs: one decode
+ * and dispatch per instruction for the whole group, with the ALU and
+ * branch compares done across lanes (one AVX2 vector when built with
+ * AVX2, e.g. cl /arch:AVX2 or gcc -mavx2, a lane loop otherwise). Loads,
+ * stores and atomics go to each lane's own caches and memory.
+ *
+ * A branch whose outcome or target differs between lanes splits the
+ * group: lanes that agree with the lowest active lane stay, the others
+ * leave with their state copied into FuncCores and finish on their own
+ * through func_schedule, from the same point in the same turn. With
+ * --no-jit every instance therefore follows the schedule of a separate
+ * --functional --no-jit run exactly. Groups run on --jobs worker threads.
+ * --batch-compare also runs every instance separately, in this process
+ * (its own Simulator through func_schedule, same options, no process
+ * start-up), and compares the throughput in instance-instructions per
+ * second.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+
+#ifdef __AVX2__
+#include <immintrin.h>
+#endif
+
+#define ALL_LANES   ((1u << BATCH_LANES) - 1)
+
+typedef struct {
+    char            name[PLATFORM_NAME_MAX];
+    Simulator*      sim;
+    FuncCore*       fcs;                // Own state once out of lockstep
+    bool            diverged;
+    int             resume_core;        // Where its schedule continues
+    uint64_t        resume_used;        // Instructions of that core's turn already run
+    // Results
+    uint64_t        instructions;
+    uint64_t        lockstep_instructions;
+    StopReason      stopped;
+    bool            failed;
+    double          separate_s;         // --batch-compare
+} BatchInstance;
+
+// Up to BATCH_LANES instances at the same PCs
+typedef struct {
+    int32_t         regs[NUM_CORES][NUM_REGISTERS][BATCH_LANES];
+    BatchInstance*  lane[BATCH_LANES];
+    uint32_t        active;             // Lanes still in lockstep
+    uint32_t        split;              // Lanes leaving at the current instruction
+    // Control state, shared by the active lanes
+    uint32_t        pc[NUM_CORES];
+    uint32_t        npc[NUM_CORES];
+    int             shadow[NUM_CORES];
+    bool            done[NUM_CORES];
+    bool            at_barrier[NUM_CORES];
+    uint64_t        instructions[NUM_CORES];
+    uint64_t        barrier_waits[NUM_CORES];
+} BatchGroup;
+
+typedef struct {
+    SimConfig       config;
+    const char*     dir;
+    Simulator*      program;            // imem0-3 of DIR
+    Instruction     code[NUM_CORES][IMEM_DEPTH];
+    BatchInstance*  instances;
+    int             count;
+    int             groups;
+    volatile long   next;
+} Batch;
+
+static const int32_t zero_lanes[BATCH_LANES];
+
+/* =============================================================================
+ * LANE OPERATIONS
+ * =============================================================================
+ */
+
+// Source operand of every lane: R0 is 0, R1 the immediate (in tmp)
+static const int32_t* lanes_read(BatchGroup* g, int c, const Instruction* inst, int reg,
+                                 int32_t* tmp) {
+    if (reg == 0) return zero_lanes;
+    if (reg == 1) {
+        for (int l = 0; l < BATCH_LANES; l++) tmp[l] = inst->immediate;
+        return tmp;
+    }
+    return g->regs[c][reg];
+}
+
+static void lanes_alu(uint8_t op, int32_t* d, const int32_t* a, const int32_t* b) {
+#ifdef __AVX2__
+    __m256i va = _mm256_loadu_si256((const __m256i*)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+    __m256i sh = _mm256_and_si256(vb, _mm256_set1_epi32(0x1F));
+    __m256i r;
+    switch (op) {
+        case OP_ADD: r = _mm256_add_epi32(va, vb); break;
+        case OP_SUB: r = _mm256_sub_epi32(va, vb); break;
+        case OP_AND: r = _mm256_and_si256(va, vb); break;
+        case OP_OR:  r = _mm256_or_si256(va, vb); break;
+        case OP_XOR: r = _mm256_xor_si256(va, vb); break;
+        case OP_MUL: r = _mm256_mullo_epi32(va, vb); break;
+        case OP_SLL: r = _mm256_sllv_epi32(va, sh); break;
+        case OP_SRA: r = _mm256_srav_epi32(va, sh); break;
+        default:     r = _mm256_srlv_epi32(va, sh); break;
+    }
+    _mm256_storeu_si256((__m256i*)d, r);
+#else
+    for (int l = 0; l < BATCH_LANES; l++) {
+        int32_t x = a[l], y = b[l];
+        switch (op) {
+            case OP_ADD: d[l] = (int32_t)((uint32_t)x + (uint32_t)y); break;
+            case OP_SUB: d[l] = (int32_t)((uint32_t)x - (uint32_t)y); break;
+            case OP_AND: d[l] = x & y; break;
+            case OP_OR:  d[l] = x | y; break;
+            case OP_XOR: d[l] = x ^ y; break;
+            case OP_MUL: d[l] = (int32_t)((uint32_t)x * (uint32_t)y); break;
+            case OP_SLL: d[l] = (int32_t)((uint32_t)x << (y & 0x1F)); break;
+            case OP_SRA: d[l] = x >> (y & 0x1F); break;
+            default:     d[l] = (int32_t)((uint32_t)x >> (y & 0x1F)); break;
+        }
+    }
+#endif
+}
+
+// Mask of the lanes where branch op is taken
+static uint32_t lanes_taken(uint8_t op, const int32_t* a, const int32_t* b) {
+#ifdef __AVX2__
+    __m256i va = _mm256_loadu_si256((const __m256i*)a);
+    __m256i vb = _mm256_loadu_si256((const __m256i*)b);
+    __m256i m;
+    bool invert = false;
+    switch (op) {
+        case OP_BEQ: m = _mm256_cmpeq_epi32(va, vb); break;
+        case OP_BNE: m = _mm256_cmpeq_epi32(va, vb); invert = true; break;
+        case OP_BLT: m = _mm256_cmpgt_epi32(vb, va); break;
+        case OP_BGT: m = _mm256_cmpgt_epi32(va, vb); break;
+        case OP_BLE: m = _mm256_cmpgt_epi32(va, vb); invert = true; break;
+        default:     m = _mm256_cmpgt_epi32(vb, va); invert = true; break;     // BGE
+    }
+    uint32_t bits = (uint32_t)_mm256_movemask_ps(_mm256_castsi256_ps(m));
+    return invert ? ~bits & ALL_LANES : bits;
+#else
+    uint32_t bits = 0;
+    for (int l = 0; l < BATCH_LANES; l++) {
+        bool taken;
+        switch (op) {
+            case OP_BEQ: taken = (a[l] == b[l]); break;
+            case OP_BNE: taken = (a[l] != b[l]); break;
+            case OP_BLT: taken = (a[l] < b[l]); break;
+            case OP_BGT: taken = (a[l] > b[l]); break;
+            case OP_BLE: taken = (a[l] <= b[l]); break;
+            default:     taken = (a[l] >= b[l]); break;
+        }
+        if (taken) bits |= 1u << l;
+    }
+    return bits;
+#endif
+}
+
+static int lowest_lane(uint32_t mask) {
+    int l = 0;
+    while (!(mask & (1u << l))) l++;
+    return l;
+}
+
+/* =============================================================================
+ * LOCKSTEP EXECUTION
+ * =============================================================================
+ */
+
+// Memory instruction, lane by lane into each instance's caches
+static void group_memory(BatchGroup* g, int c, const Instruction* inst) {
+    int32_t ta[BATCH_LANES], tb[BATCH_LANES], td[BATCH_LANES];
+    const int32_t* rs = lanes_read(g, c, inst, inst->rs, ta);
+    const int32_t* rt = lanes_read(g, c, inst, inst->rt, tb);
+    const int32_t* rd = lanes_read(g, c, inst, inst->rd, td);
+    int32_t* out = g->regs[c][inst->rd];
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (!(g->active & (1u << l))) continue;
+        FuncCore* fc = &g->lane[l]->fcs[c];
+        uint32_t addr = (uint32_t)rs[l] + (uint32_t)rt[l];
+        int32_t value;
+        switch (inst->opcode) {
+            case OP_LW:  value = func_load(fc, addr); break;
+            case OP_SW:  func_store(fc, addr, rd[l]); continue;
+            case OP_FAA: value = func_faa(fc, addr, rd[l]); break;
+            default:     value = func_cas(fc, (uint32_t)rs[l], rt[l], rd[l]); break;
+        }
+        if (inst->rd >= 2) out[l] = value;
+    }
+}
+
+// Execute the instruction of core c at the group's PC, as func_step does.
+// Returns 1 if the turn goes on, 0 if it ends here, -1 (nothing executed)
+// if the lanes disagree: g->split holds the lanes that must leave first.
+static int group_step(const Batch* b, BatchGroup* g, int c) {
+    const Instruction* inst = &b->code[c][g->pc[c]];
+    uint8_t op = inst->opcode;
+    uint32_t next = (g->npc[c] + 1) & PC_MASK;
+    int more = 1;
+
+    if (op <= OP_SRL) {
+        if (inst->rd >= 2) {
+            int32_t ta[BATCH_LANES], tb[BATCH_LANES];
+            lanes_alu(op, g->regs[c][inst->rd], lanes_read(g, c, inst, inst->rs, ta),
+                      lanes_read(g, c, inst, inst->rt, tb));
+        }
+    } else if (op <= OP_JAL) {
+        int32_t ta[BATCH_LANES], tb[BATCH_LANES], td[BATCH_LANES];
+        const int32_t* target = lanes_read(g, c, inst, inst->rd, td);
+        uint32_t taken = (op == OP_JAL) ? ALL_LANES :
+                         lanes_taken(op, lanes_read(g, c, inst, inst->rs, ta),
+                                     lanes_read(g, c, inst, inst->rt, tb));
+        taken &= g->active;
+
+        // Lanes with the lowest active lane's outcome stay in lockstep
+        int ref = lowest_lane(g->active);
+        uint32_t keep = g->active & ~taken;
+        if (taken & (1u << ref)) {
+            keep = 0;
+            for (int l = 0; l < BATCH_LANES; l++) {
+                if ((taken & (1u << l)) &&
+                    ((uint32_t)target[l] & PC_MASK) == ((uint32_t)target[ref] & PC_MASK)) {
+                    keep |= 1u << l;
+                }
+            }
+            next = (uint32_t)target[ref] & PC_MASK;
+        }
+        if (keep != g->active) {
+            g->split = g->active & ~keep;
+            return -1;
+        }
+        if (op == OP_JAL) {
+            for (int l = 0; l < BATCH_LANES; l++) g->regs[c][15][l] = (int32_t)((g->pc[c] + 1) & PC_MASK);
+        }
+    } else if (op >= OP_LW && op <= OP_CAS) {
+        group_memory(g, c, inst);
+    } else if (op == OP_HALT) {
+        if (g->shadow[c] < 0) g->shadow[c] = FUNC_HALT_SHADOW + 1;
+        more = 0;
+    } else if (op == OP_BAR) {
+        if (g->shadow[c] < 0) {
+            g->at_barrier[c] = true;
+            g->barrier_waits[c]++;
+        }
+        more = 0;
+    } else if (op == OP_MWAIT) {
+        more = 0;
+    }
+
+    g->instructions[c]++;
+    g->pc[c] = g->npc[c];
+    g->npc[c] = next;
+    if (g->shadow[c] > 0 && --g->shadow[c] == 0) g->done[c] = true;
+    return more && !g->done[c];
+}
+
+// Hand the group's state to lane l's FuncCores and Cores
+static void group_release(BatchGroup* g, int l) {
+    BatchInstance* inst = g->lane[l];
+    uint64_t total = 0;
+    for (int c = 0; c < NUM_CORES; c++) {
+        FuncCore* fc = &inst->fcs[c];
+        for (int r = 0; r < NUM_REGISTERS; r++) fc->regs[r] = g->regs[c][r][l];
+        fc->pc = g->pc[c];
+        fc->npc = g->npc[c];
+        fc->shadow = g->shadow[c];
+        fc->done = g->done[c];
+        fc->at_barrier = g->at_barrier[c];
+        fc->core->instruction_count = g->instructions[c];
+        fc->core->barrier_waits = g->barrier_waits[c];
+        fc->core->halted = (g->shadow[c] >= 0);
+        total += g->instructions[c];
+    }
+    inst->lockstep_instructions = total;
+    g->active &= ~(1u << l);
+}
+
+// Lanes of g->split leave during core c's turn, after used instructions
+static void group_split(BatchGroup* g, int c, uint64_t used) {
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (!(g->split & (1u << l))) continue;
+        group_release(g, l);
+        g->lane[l]->diverged = true;
+        g->lane[l]->resume_core = c;
+        g->lane[l]->resume_used = used;
+    }
+    g->split = 0;
+}
+
+// The schedule of func_schedule, for all active lanes at once
+static void group_run(const Batch* b, BatchGroup* g) {
+    uint64_t limit = b->config.max_cycles;
+    bool stopped = false;
+
+    for (;;) {
+        for (int c = 0; c < NUM_CORES && !stopped; c++) {
+            if (g->done[c] || g->at_barrier[c]) continue;
+            uint64_t used = 0;
+            while (used < FUNC_QUANTUM) {
+                int r = group_step(b, g, c);
+                if (r < 0) {
+                    group_split(g, c, used);
+                    continue;
+                }
+                used++;
+                if (r == 0) break;
+            }
+            if (limit && g->instructions[c] > limit) stopped = true;
+        }
+
+        bool running = false, released = true;
+        for (int c = 0; c < NUM_CORES; c++) {
+            running = running || !g->done[c];
+            released = released && (g->shadow[c] >= 0 || g->at_barrier[c]);
+        }
+        if (!running || stopped) break;
+        if (released) {
+            for (int c = 0; c < NUM_CORES; c++) g->at_barrier[c] = false;
+        }
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        if (!(g->active & (1u << l))) continue;
+        if (stopped) g->lane[l]->sim->stopped = STOP_CYCLE_LIMIT;
+        group_release(g, l);
+    }
+}
+
+/* =============================================================================
+ * INSTANCES
+ * =============================================================================
+ */
+
+static void instance_files(const Batch* b, const BatchInstance* inst, SimFiles* files,
+                           char (*paths)[512]) {
+    static const char* kinds[] = { "regout", "dsram", "tsram", "stats" };
+    sim_files_default(files);
+    snprintf(paths[0], 512, "%s/%s/memin.txt", b->dir, inst->name);
+    snprintf(paths[1], 512, "%s/%s/memout.txt", b->dir, inst->name);
+    files->memin = paths[0];
+    files->memout = paths[1];
+    for (int k = 0; k < 4; k++) {
+        for (int c = 0; c < NUM_CORES; c++) {
+            char* p = paths[2 + k * NUM_CORES + c];
+            snprintf(p, 512, "%s/%s/%s%d.txt", b->dir, inst->name, kinds[k], c);
+            if (k == 0) files->regout[c] = p;
+            if (k == 1) files->dsram[c] = p;
+            if (k == 2) files->tsram[c] = p;
+            if (k == 3) files->stats[c] = p;
+        }
+    }
+}
+
+// A simulator with the batch program and the instance's memin
+static Simulator* instance_sim(const Batch* b, const char* memin) {
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    if (!sim || !sim_init(sim)) {
+        if (sim) sim_cleanup(sim);
+        free(sim);
+        return NULL;
+    }
+    sim->config = b->config;
+    for (int c = 0; c < NUM_CORES; c++) {
+        memcpy(sim->core_mem[c].imem[0], b->program->core_mem[c].imem[0],
+               sizeof(sim->core_mem[c].imem[0]));
+    }
+    if (!load_memin(sim, memin)) {
+        sim_cleanup(sim);
+        free(sim);
+        return NULL;
+    }
+    return sim;
+}
+
+static void instance_free(BatchInstance* inst) {
+    if (inst->fcs) {
+        for (int c = 0; c < NUM_CORES; c++) jit_destroy(inst->fcs[c].jit);
+    }
+    free(inst->fcs);
+    inst->fcs = NULL;
+    if (inst->sim) {
+        sim_cleanup(inst->sim);
+        free(inst->sim);
+        inst->sim = NULL;
+    }
+}
+
+// Run group number gi
+static void batch_group(const Batch* b, int gi) {
+    BatchGroup* g = (BatchGroup*)calloc(1, sizeof(BatchGroup));
+    if (!g) {
+        for (int i = gi * BATCH_LANES; i < b->count && i < (gi + 1) * BATCH_LANES; i++) {
+            b->instances[i].failed = true;
+        }
+        return;
+    }
+
+    SimFiles files;
+    char paths[2 + 4 * NUM_CORES][512];
+    for (int l = 0; l < BATCH_LANES; l++) {
+        int i = gi * BATCH_LANES + l;
+        if (i >= b->count) break;
+        BatchInstance* inst = &b->instances[i];
+        instance_files(b, inst, &files, paths);
+        inst->sim = instance_sim(b, files.memin);
+        inst->fcs = (FuncCore*)calloc(NUM_CORES, sizeof(FuncCore));
+        if (!inst->sim || !inst->fcs) {
+            inst->failed = true;
+            instance_free(inst);
+            continue;
+        }
+        // Lockstep lanes run without a translator; one is made if they leave
+        inst->sim->config.jit = false;
+        for (int c = 0; c < NUM_CORES; c++) func_core_init(&inst->fcs[c], inst->sim, c);
+        inst->sim->config.jit = b->config.jit;
+        g->lane[l] = inst;
+        g->active |= 1u << l;
+    }
+
+    // Every lane starts from the same state: PC 0, registers 0
+    if (g->active) {
+        BatchInstance* first = g->lane[lowest_lane(g->active)];
+        for (int c = 0; c < NUM_CORES; c++) {
+            g->pc[c] = first->fcs[c].pc;
+            g->npc[c] = first->fcs[c].npc;
+            g->shadow[c] = -1;
+            for (int r = 0; r < NUM_REGISTERS; r++) {
+                for (int l = 0; l < BATCH_LANES; l++) g->regs[c][r][l] = first->fcs[c].regs[r];
+            }
+        }
+        group_run(b, g);
+    }
+
+    for (int l = 0; l < BATCH_LANES; l++) {
+        BatchInstance* inst = g->lane[l];
+        if (!inst) continue;
+        if (inst->diverged) {
+            for (int c = 0; c < NUM_CORES; c++) {
+                inst->fcs[c].jit = b->config.jit ? jit_create() : NULL;
+            }
+            func_schedule(inst->sim, inst->fcs, inst->resume_core, inst->resume_used);
+        }
+        for (int c = 0; c < NUM_CORES; c++) {
+            func_core_finish(&inst->fcs[c]);
+            inst->instructions += inst->sim->cores[c].instruction_count;
+        }
+        inst->stopped = inst->sim->stopped;
+    }
+    free(g);
+}
+
+// Outputs of instance i, after its group has run
+static void batch_write(const Batch* b, int i) {
+    BatchInstance* inst = &b->instances[i];
+    SimFiles files;
+    char paths[2 + 4 * NUM_CORES][512];
+    if (!inst->sim) return;
+    instance_files(b, inst, &files, paths);
+    write_outputs(inst->sim, &files);
+    instance_free(inst);
+}
+
+// --batch-compare: instance i on its own
+static void batch_separate(const Batch* b, int i) {
+    BatchInstance* inst = &b->instances[i];
+    SimFiles files;
+    char paths[2 + 4 * NUM_CORES][512];
+    instance_files(b, inst, &files, paths);
+
+    double start = platform_now();
+    Simulator* sim = instance_sim(b, files.memin);
+    FuncCore* fcs = (FuncCore*)calloc(NUM_CORES, sizeof(FuncCore));
+    if (sim && fcs) {
+        for (int c = 0; c < NUM_CORES; c++) func_core_init(&fcs[c], sim, c);
+        func_schedule(sim, fcs, 0, 0);
+        for (int c = 0; c < NUM_CORES; c++) func_core_finish(&fcs[c]);
+    }
+    free(fcs);
+    if (sim) {
+        sim_cleanup(sim);
+        free(sim);
+    }
+    inst->separate_s = platform_now() - start;
+}
+
+typedef enum {
+    PASS_LOCKSTEP,      // Groups
+    PASS_WRITE,         // Instance outputs
+    PASS_SEPARATE       // Instances alone (--batch-compare)
+} BatchPass;
+
+typedef struct {
+    Batch*      batch;
+    BatchPass   pass;
+} BatchJob;
+
+static void batch_worker(void* arg, int worker) {
+    BatchJob* job = (BatchJob*)arg;
+    Batch* b = job->batch;
+    (void)worker;
+    int total = (job->pass == PASS_LOCKSTEP) ? b->groups : b->count;
+    for (;;) {
+        long i = platform_fetch_add(&b->next, 1);
+        if (i >= total) break;
+        switch (job->pass) {
+            case PASS_LOCKSTEP: batch_group(b, (int)i); break;
+            case PASS_WRITE:    batch_write(b, (int)i); break;
+            default:            batch_separate(b, (int)i); break;
+        }
+    }
+}
+
+// Run one pass on workers threads; returns its wall time
+static double batch_pass(Batch* b, BatchPass pass, int workers) {
+    BatchJob job = { b, pass };
+    b->next = 0;
+    double start = platform_now();
+    platform_run_parallel(workers, batch_worker, &job);
+    return platform_now() - start;
+}
+
+/* =============================================================================
+ * ENTRY
+ * =============================================================================
+ */
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp(((const BatchInstance*)a)->name, ((const BatchInstance*)b)->name);
+}
+
+static bool batch_load(Batch* b) {
+    char (*names)[PLATFORM_NAME_MAX] =
+        (char (*)[PLATFORM_NAME_MAX])calloc(BATCH_MAX_INSTANCES, PLATFORM_NAME_MAX);
+    int n = names ? platform_list_dirs(b->dir, names, BATCH_MAX_INSTANCES) : -1;
+    if (n < 0) {
+        fprintf(stderr, "Error: Cannot read batch directory %s\n", b->dir);
+        free(names);
+        return false;
+    }
+    for (int i = 0; i < n; i++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/%s/memin.txt", b->dir, names[i]);
+        FILE* fp = fopen(path, "r");
+        if (!fp) continue;
+        fclose(fp);
+        snprintf(b->instances[b->count++].name, PLATFORM_NAME_MAX, "%s", names[i]);
+    }
+    free(names);
+    qsort(b->instances, b->count, sizeof(BatchInstance), compare_names);
+    b->groups = (b->count + BATCH_LANES - 1) / BATCH_LANES;
+
+    b->program = (Simulator*)malloc(sizeof(Simulator));
+    if (!b->program || !sim_init(b->program)) return false;
+    bool ok = true;
+    for (int c = 0; c < NUM_CORES; c++) {
+        char path[512];
+        snprintf(path, sizeof(path), "%s/imem%d.txt", b->dir, c);
+        ok = load_imem(&b->program->cores[c], 0, path) && ok;
+        for (int pc = 0; pc < IMEM_DEPTH; pc++) {
+            b->code[c][pc] = decode_instruction(b->program->cores[c].thread[0].imem[pc]);
+        }
+    }
+    return ok;
+}
+
+static void print_report(const Batch* b, double seconds, double separate_s, bool compare) {
+    uint64_t total = 0, lockstep = 0;
+    printf("%-20s %14s %9s %8s", "instance", "instructions", "lockstep", "status");
+    printf(compare ? " %10s\n" : "\n", "alone_s");
+    for (int i = 0; i < b->count; i++) {
+        const BatchInstance* inst = &b->instances[i];
+        const char* status = inst->failed ? "error" :
+                             inst->stopped == STOP_CYCLE_LIMIT ? "limit" : "ok";
+        printf("%-20s %14llu %8.1f%% %8s", inst->name, (unsigned long long)inst->instructions,
+               inst->instructions ? 100.0 * inst->lockstep_instructions / inst->instructions : 0.0,
+               status);
+        if (compare) {
+            printf(" %10.3f\n", inst->separate_s);
+        } else {
+            printf("\n");
+        }
+        total += inst->instructions;
+        lockstep += inst->lockstep_instructions;
+    }
+
+    printf("\n%d instances in %d groups of %d (%s), %.1f%% of instructions in lockstep\n",
+           b->count, b->groups, BATCH_LANES,
+#ifdef __AVX2__
+           "AVX2",
+#else
+           "scalar lanes",
+#endif
+           total ? 100.0 * lockstep / total : 0.0);
+    printf("Batch:    %.3f s, %.1f M instance-instructions/s\n", seconds,
+           seconds > 0 ? total / seconds / 1e6 : 0.0);
+    if (compare) {
+        printf("Separate (in-process, one Simulator per instance, no process start-up):\n");
+        printf("          %.3f s, %.1f M instance-instructions/s (%.2fx batch speedup)\n",
+               separate_s, separate_s > 0 ? total / separate_s / 1e6 : 0.0,
+               seconds > 0 ? separate_s / seconds : 0.0);
+    }
+}
+
+// sim --batch=DIR [--batch-compare]: returns the process exit code
+int batch_run(const SimConfig* config, const char* dir, bool compare, int jobs) {
+    Batch* b = (Batch*)calloc(1, sizeof(Batch));
+    if (!b) {
+        fprintf(stderr, "Error: Failed to allocate batch\n");
+        return 1;
+    }
+    b->dir = dir;
+    b->instances = (BatchInstance*)calloc(BATCH_MAX_INSTANCES, sizeof(BatchInstance));
+
+    // Functional runs; report options would write the same files per instance
+    b->config = *config;
+    b->config.functional = true;
+    b->config.quiet = true;
+    b->config.issue_width = 1;
+    b->config.hw_threads = 1;
+    b->config.profile = false;
+    b->config.sharing_profile = false;
+    b->config.bus_stats = false;
+    b->config.miss_classes = false;
+    b->config.interval = 0;
+    b->config.mem_trace = false;
+    b->config.stack_distance = false;
+    b->config.verify_dir = NULL;
+
+    int code = 1;
+    if (!b->instances || !batch_load(b)) {
+        fprintf(stderr, "Error: Cannot load batch %s\n", dir);
+    } else if (b->count == 0) {
+        fprintf(stderr, "Error: No instances (DIR/<name>/memin.txt) in %s\n", dir);
+    } else {
+        int workers = (jobs > 0) ? jobs : platform_cpu_count();
+        if (workers > b->groups) workers = b->groups;
+        printf("Batch %s: %d instances, %d worker%s\n", dir, b->count, workers,
+               workers == 1 ? "" : "s");
+        double seconds = batch_pass(b, PASS_LOCKSTEP, workers);
+        workers = (jobs > 0) ? jobs : platform_cpu_count();
+        if (workers > b->count) workers = b->count;
+        batch_pass(b, PASS_WRITE, workers);
+        double separate_s = compare ? batch_pass(b, PASS_SEPARATE, workers) : 0.0;
+        print_report(b, seconds, separate_s, compare);
+        code = 0;
+        for (int i = 0; i < b->count; i++) {
+            if (b->instances[i].failed) code = 1;
+        }
+    }
+
+    if (b->program) {
+        sim_cleanup(b->program);
+        free(b->program);
+    }
+    free(b->instances);
+    free(b);
+    return code;
+}
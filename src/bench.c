@@ -0,0 +1,480 @@
+/*
+ * =============================================================================
+ * Benchmark Mode - Host-Side Simulator Performance
+ * =============================================================================
+ * sim --bench runs a fixed set of workloads and measures the simulator
+ * itself, not the simulated machine:
+ * - the test directories (tests/simple, tests/counter, ...)
+ * - generated stress kernels: alu_loop (pipeline only, no misses), stream
+ *   (every core walks its own 4K-word region) and pingpong (every core
+ *   updates its own word of one shared block)
+ * Each workload runs --bench-reps times through simulate_files with the
+ * normal outputs (traces included) written under --bench-out; the fastest
+ * run counts. Reported: wall time, simulated cycles/s and instructions/s,
+ * peak RSS, and the host time split across core_cycle, bus_cycle, tracing
+ * and file I/O (run_simulation reads the clock ~4 times a cycle while
+ * measuring). A microbenchmark then times core_cycle alone, per simulated
+ * core-cycle.
+ * --bench-save writes the results as JSON, one workload per line;
+ * --bench-baseline compares against such a file and exits with 1 if any
+ * workload's cycles/s dropped by more than --bench-threshold percent.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+
+typedef struct {
+    char        name[32];
+    RunTiming   best;
+    uint64_t    peak_rss;       // Process peak after the workload
+} BenchResult;
+
+// Stress kernel generator: writes imem0-3.txt and memin.txt into dir
+typedef bool (*BenchGenerator)(const char* dir);
+
+/* =============================================================================
+ * OPTIONS
+ * =============================================================================
+ */
+
+void bench_options_init(BenchOptions* opts) {
+    memset(opts, 0, sizeof(BenchOptions));
+    opts->tests_dir = BENCH_DEFAULT_TESTS;
+    opts->out_dir = BENCH_DEFAULT_OUT;
+    opts->reps = BENCH_DEFAULT_REPS;
+    opts->threshold = BENCH_DEFAULT_THRESHOLD;
+}
+
+// Apply one "--bench..." argument. Returns false if not recognised.
+bool bench_parse_option(BenchOptions* opts, const char* arg) {
+    const char* val;
+
+    if (strcmp(arg, "--bench") == 0) {
+        opts->enabled = true;
+    } else if ((val = option_value(arg, "--bench-tests=")) != NULL) {
+        opts->tests_dir = val;
+    } else if ((val = option_value(arg, "--bench-out=")) != NULL) {
+        opts->out_dir = val;
+    } else if ((val = option_value(arg, "--bench-only=")) != NULL) {
+        opts->only = val;
+    } else if ((val = option_value(arg, "--bench-save=")) != NULL) {
+        opts->save_file = val;
+    } else if ((val = option_value(arg, "--bench-baseline=")) != NULL) {
+        opts->baseline_file = val;
+    } else if ((val = option_value(arg, "--bench-reps=")) != NULL) {
+        if (!option_int(val, 1, INT_MAX, &opts->reps)) return false;
+    } else if ((val = option_value(arg, "--bench-threshold=")) != NULL) {
+        if (!option_int(val, 0, INT_MAX, &opts->threshold)) return false;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* =============================================================================
+ * STRESS KERNELS
+ * =============================================================================
+ * Branch targets use rd = R1, which holds the branch's own immediate.
+ */
+
+static uint32_t enc(int op, int rd, int rs, int rt, int imm) {
+    return ((uint32_t)(op & 0xFF) << 24) | ((uint32_t)(rd & 0xF) << 20) |
+           ((uint32_t)(rs & 0xF) << 16) | ((uint32_t)(rt & 0xF) << 12) | (uint32_t)(imm & 0xFFF);
+}
+
+static bool write_words(const char* dir, const char* name, const uint32_t* words, int n) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    FILE* fp = fopen(path, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        return false;
+    }
+    for (int i = 0; i < n; i++) fprintf(fp, "%08X\n", words[i]);
+    fclose(fp);
+    return true;
+}
+
+static bool write_kernel(const char* dir, uint32_t prog[NUM_CORES][16], int len) {
+    static const uint32_t memin[1] = { 0 };
+    for (int c = 0; c < NUM_CORES; c++) {
+        char name[32];
+        snprintf(name, sizeof(name), "imem%d.txt", c);
+        if (!write_words(dir, name, prog[c], len)) return false;
+    }
+    return write_words(dir, "memin.txt", memin, 1);
+}
+
+// alu_loop program of core c into code, returns its length
+static int alu_loop_code(int c, uint32_t code[16]) {
+    uint32_t p[] = {
+        enc(OP_ADD, 2, 0, 1, 0),        // i = 0
+        enc(OP_ADD, 3, 0, 1, 1),
+        enc(OP_SLL, 3, 3, 1, 14),       // n = 16384
+        enc(OP_ADD, 4, 4, 2, 0),        // LOOP (3)
+        enc(OP_XOR, 6, 4, 1, 0x55),
+        enc(OP_SUB, 7, 6, 2, c),
+        enc(OP_ADD, 2, 2, 1, 1),
+        enc(OP_BNE, 1, 2, 3, 3),
+        enc(OP_ADD, 0, 0, 0, 0),        // Delay slot
+        enc(OP_HALT, 0, 0, 0, 0),
+    };
+    memcpy(code, p, sizeof(p));
+    return (int)(sizeof(p) / sizeof(p[0]));
+}
+
+// 16384 iterations of dependent ALU work, no memory traffic
+static bool gen_alu_loop(const char* dir) {
+    uint32_t prog[NUM_CORES][16];
+    int len = 0;
+    for (int c = 0; c < NUM_CORES; c++) len = alu_loop_code(c, prog[c]);
+    return write_kernel(dir, prog, len);
+}
+
+// Read-modify-write of 4096 words at (core + 1) << 16: one miss per block
+static bool gen_stream(const char* dir) {
+    uint32_t prog[NUM_CORES][16];
+    for (int c = 0; c < NUM_CORES; c++) {
+        uint32_t p[] = {
+            enc(OP_ADD, 2, 0, 1, c + 1),
+            enc(OP_SLL, 2, 2, 1, 16),       // addr = (core + 1) << 16
+            enc(OP_ADD, 3, 0, 1, 1),
+            enc(OP_SLL, 3, 3, 1, 12),
+            enc(OP_ADD, 3, 3, 2, 0),        // end = addr + 4096
+            enc(OP_LW, 4, 2, 0, 0),         // LOOP (5)
+            enc(OP_ADD, 4, 4, 1, 1),
+            enc(OP_SW, 4, 2, 0, 0),
+            enc(OP_ADD, 2, 2, 1, 1),
+            enc(OP_BNE, 1, 2, 3, 5),
+            enc(OP_ADD, 0, 0, 0, 0),        // Delay slot
+            enc(OP_HALT, 0, 0, 0, 0),
+        };
+        memcpy(prog[c], p, sizeof(p));
+    }
+    return write_kernel(dir, prog, 12);
+}
+
+// 1000 increments of MEM[core]: all cores fight over block 0
+static bool gen_pingpong(const char* dir) {
+    uint32_t prog[NUM_CORES][16];
+    for (int c = 0; c < NUM_CORES; c++) {
+        uint32_t p[] = {
+            enc(OP_ADD, 2, 0, 1, c),        // addr = core
+            enc(OP_ADD, 3, 0, 1, 1000),     // n
+            enc(OP_ADD, 5, 0, 1, 0),        // i = 0
+            enc(OP_LW, 4, 2, 0, 0),         // LOOP (3)
+            enc(OP_ADD, 4, 4, 1, 1),
+            enc(OP_SW, 4, 2, 0, 0),
+            enc(OP_ADD, 5, 5, 1, 1),
+            enc(OP_BNE, 1, 5, 3, 3),
+            enc(OP_ADD, 0, 0, 0, 0),        // Delay slot
+            enc(OP_HALT, 0, 0, 0, 0),
+        };
+        memcpy(prog[c], p, sizeof(p));
+    }
+    return write_kernel(dir, prog, 10);
+}
+
+static const char* const bench_tests[] = {
+    "simple", "counter", "mulserial", "mulparallel", "atomic_counter"
+};
+
+static const struct {
+    const char*     name;
+    BenchGenerator  gen;
+} bench_kernels[] = {
+    { "alu_loop", gen_alu_loop },
+    { "stream",   gen_stream },
+    { "pingpong", gen_pingpong },
+};
+
+/* =============================================================================
+ * RUNNING
+ * =============================================================================
+ */
+
+static bool file_exists(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    fclose(fp);
+    return true;
+}
+
+// Per-workload file names, in storage owned by the caller
+typedef struct {
+    char    imem[NUM_CORES][512];
+    char    regout[NUM_CORES][512];
+    char    core_trace[NUM_CORES][512];
+    char    dsram[NUM_CORES][512];
+    char    tsram[NUM_CORES][512];
+    char    stats[NUM_CORES][512];
+    char    memin[512];
+    char    memout[512];
+    char    bus_trace[512];
+} BenchPaths;
+
+static const char* bench_path(char* buf, const char* dir, const char* name) {
+    snprintf(buf, 512, "%s/%s", dir, name);
+    return buf;
+}
+
+// Inputs from in_dir, all outputs to out_dir
+static void bench_files(SimFiles* files, BenchPaths* p, const char* in_dir, const char* out_dir) {
+    SimFiles names;
+    sim_files_default(&names);
+    sim_files_default(files);
+    for (int i = 0; i < NUM_CORES; i++) {
+        files->imem[i] = bench_path(p->imem[i], in_dir, names.imem[i]);
+        files->regout[i] = bench_path(p->regout[i], out_dir, names.regout[i]);
+        files->core_trace[i] = bench_path(p->core_trace[i], out_dir, names.core_trace[i]);
+        files->dsram[i] = bench_path(p->dsram[i], out_dir, names.dsram[i]);
+        files->tsram[i] = bench_path(p->tsram[i], out_dir, names.tsram[i]);
+        files->stats[i] = bench_path(p->stats[i], out_dir, names.stats[i]);
+    }
+    files->memin = bench_path(p->memin, in_dir, names.memin);
+    files->memout = bench_path(p->memout, out_dir, names.memout);
+    files->bus_trace = bench_path(p->bus_trace, out_dir, names.bus_trace);
+}
+
+// Run one workload reps times, keeping the fastest run
+static bool bench_workload(const SimConfig* config, const BenchOptions* opts,
+                           const char* name, const char* in_dir, const char* out_dir,
+                           BenchResult* result) {
+    static BenchPaths paths;
+    SimFiles files;
+
+    bench_files(&files, &paths, in_dir, out_dir);
+    if (!file_exists(files.imem[0]) || !file_exists(files.memin)) {
+        printf("%-16s skipped (no inputs in %s)\n", name, in_dir);
+        return false;
+    }
+
+    snprintf(result->name, sizeof(result->name), "%s", name);
+    for (int r = 0; r < opts->reps; r++) {
+        RunTiming timing;
+        if (simulate_files(config, &files, &timing, NULL) != 0) return false;
+        if (!timing.finished) {
+            // Stopped by --max-cycles or a deadlock: nothing worth timing
+            printf("%-16s skipped (stopped at cycle %llu before every core halted)\n", name,
+                   (unsigned long long)timing.cycles);
+            return false;
+        }
+        if (r == 0 || timing.total_s < result->best.total_s) result->best = timing;
+    }
+    result->peak_rss = platform_peak_rss();
+    return true;
+}
+
+static double per_sec(uint64_t count, double seconds) {
+    return seconds > 0 ? (double)count / seconds : 0.0;
+}
+
+static double percent(double part, double whole) {
+    return whole > 0 ? 100.0 * part / whole : 0.0;
+}
+
+static void print_result(const BenchResult* r) {
+    const RunTiming* t = &r->best;
+    printf("%-16s %10llu %10llu %8.3f %8.3f %8.3f %5.1f %5.1f %5.1f %5.1f %7.1f\n",
+           r->name, (unsigned long long)t->cycles, (unsigned long long)t->instructions,
+           t->total_s, per_sec(t->cycles, t->total_s) / 1e6,
+           per_sec(t->instructions, t->total_s) / 1e6,
+           percent(t->core_s, t->total_s), percent(t->bus_s, t->total_s),
+           percent(t->trace_s, t->total_s), percent(t->io_s, t->total_s),
+           (double)r->peak_rss / (1024.0 * 1024.0));
+}
+
+/* =============================================================================
+ * CORE_CYCLE MICROBENCHMARK
+ * =============================================================================
+ * Host cost of one pipeline step: alu_loop on every core, core_cycle called
+ * directly for BENCH_MICRO_CYCLES cycles with no bus cycle, traces or clock
+ * reads in the timed loop. alu_loop takes ~180K cycles to HALT, so every
+ * core stays busy throughout.
+ */
+
+#define BENCH_MICRO_CYCLES  150000
+
+// Fastest of reps, in host ns per core-cycle (0 if out of memory)
+static double micro_core_cycle(const SimConfig* config, int issue_width, int reps) {
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    double best = 0;
+    if (!sim) return 0;
+
+    for (int r = 0; r < reps; r++) {
+        if (!sim_init(sim)) {
+            sim_cleanup(sim);
+            break;
+        }
+        sim->config = *config;
+        sim->config.issue_width = issue_width;
+        config_resolve(&sim->config);
+        for (int c = 0; c < NUM_CORES; c++) {
+            alu_loop_code(c, sim->cores[c].thread[0].imem);
+        }
+        sim_start(sim);
+
+        double start = platform_now();
+        for (int i = 0; i < BENCH_MICRO_CYCLES; i++) {
+            for (int c = 0; c < NUM_CORES; c++) core_cycle(&sim->cores[c], sim);
+            sim->cycle++;
+        }
+        double ns = (platform_now() - start) * 1e9 / ((double)BENCH_MICRO_CYCLES * NUM_CORES);
+
+        sim_cleanup(sim);
+        if (r == 0 || ns < best) best = ns;
+    }
+    free(sim);
+    return best;
+}
+
+/* =============================================================================
+ * JSON BASELINE
+ * =============================================================================
+ * One workload object per line, so a baseline is read back line by line.
+ */
+
+static bool save_results(const char* filename, const BenchOptions* opts,
+                         const BenchResult* results, int count, const double core_cycle_ns[2]) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return false;
+    }
+    fprintf(fp, "{\n  \"reps\": %d,\n  \"peak_rss\": %llu,\n"
+                "  \"core_cycle_ns\": %.2f,\n  \"core_cycle_dual_ns\": %.2f,\n  \"workloads\": [\n",
+            opts->reps, (unsigned long long)platform_peak_rss(), core_cycle_ns[0], core_cycle_ns[1]);
+    for (int i = 0; i < count; i++) {
+        const RunTiming* t = &results[i].best;
+        fprintf(fp, "    {\"name\": \"%s\", \"cycles\": %llu, \"instructions\": %llu, "
+                    "\"wall_s\": %.6f, \"cycles_per_sec\": %.1f, \"insts_per_sec\": %.1f, "
+                    "\"core_s\": %.6f, \"bus_s\": %.6f, \"trace_s\": %.6f, \"io_s\": %.6f, "
+                    "\"peak_rss\": %llu}%s\n",
+                results[i].name, (unsigned long long)t->cycles,
+                (unsigned long long)t->instructions, t->total_s,
+                per_sec(t->cycles, t->total_s), per_sec(t->instructions, t->total_s),
+                t->core_s, t->bus_s, t->trace_s, t->io_s,
+                (unsigned long long)results[i].peak_rss, (i < count - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n}\n");
+    fclose(fp);
+    return true;
+}
+
+// Numeric value of "key": in line, or false
+static bool json_number(const char* line, const char* key, double* value) {
+    char pattern[64];
+    snprintf(pattern, sizeof(pattern), "\"%s\": ", key);
+    const char* p = strstr(line, pattern);
+    return p && sscanf(p + strlen(pattern), "%lf", value) == 1;
+}
+
+// Compare with a saved baseline. Returns the number of regressions, -1 if
+// the baseline cannot be read.
+static int compare_baseline(const char* filename, int threshold,
+                            const BenchResult* results, int count) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open baseline %s\n", filename);
+        return -1;
+    }
+
+    printf("\nAgainst baseline %s (regression: > %d%% slower)\n", filename, threshold);
+    printf("%-16s %12s %12s %8s\n", "workload", "base Mcyc/s", "now Mcyc/s", "change");
+
+    int regressions = 0;
+    char line[1024];
+    while (fgets(line, sizeof(line), fp)) {
+        char name[32];
+        const char* p = strstr(line, "\"name\": \"");
+        double base_cps, base_cycles;
+        if (!p || sscanf(p + 9, "%31[^\"]", name) != 1) continue;
+        if (!json_number(line, "cycles_per_sec", &base_cps) ||
+            !json_number(line, "cycles", &base_cycles)) {
+            continue;
+        }
+
+        for (int i = 0; i < count; i++) {
+            if (strcmp(results[i].name, name) != 0) continue;
+            const RunTiming* t = &results[i].best;
+            double now_cps = per_sec(t->cycles, t->total_s);
+            double change = base_cps > 0 ? 100.0 * (now_cps - base_cps) / base_cps : 0.0;
+            bool slower = change < -(double)threshold;
+
+            printf("%-16s %12.3f %12.3f %+7.1f%%%s%s\n", name, base_cps / 1e6, now_cps / 1e6,
+                   change, slower ? "  REGRESSION" : "",
+                   ((uint64_t)base_cycles != t->cycles) ? "  (simulated cycles differ)" : "");
+            if (slower) regressions++;
+        }
+    }
+    fclose(fp);
+    return regressions;
+}
+
+/* =============================================================================
+ * ENTRY POINT
+ * =============================================================================
+ */
+
+int bench_run(const SimConfig* config, const BenchOptions* opts) {
+    SimConfig run_config = *config;
+    BenchResult results[BENCH_MAX_WORKLOADS];
+    int count = 0;
+    int ntests = (int)(sizeof(bench_tests) / sizeof(bench_tests[0]));
+    int nkernels = (int)(sizeof(bench_kernels) / sizeof(bench_kernels[0]));
+
+    run_config.quiet = true;
+    if (!platform_mkdir(opts->out_dir)) {
+        fprintf(stderr, "Error: Cannot create %s\n", opts->out_dir);
+        return 1;
+    }
+
+    printf("Benchmark: %d rep(s) per workload, outputs in %s\n\n", opts->reps, opts->out_dir);
+    printf("%-16s %10s %10s %8s %8s %8s %5s %5s %5s %5s %7s\n", "workload", "cycles",
+           "insts", "wall_s", "Mcyc/s", "Minst/s", "core%", "bus%", "trc%", "io%", "rss_MB");
+
+    for (int w = 0; w < ntests + nkernels && count < BENCH_MAX_WORKLOADS; w++) {
+        const char* name = (w < ntests) ? bench_tests[w] : bench_kernels[w - ntests].name;
+        char in_dir[256], out_dir[256];
+
+        if (opts->only && !strstr(name, opts->only)) continue;
+        snprintf(out_dir, sizeof(out_dir), "%s/%s", opts->out_dir, name);
+        if (!platform_mkdir(out_dir)) {
+            fprintf(stderr, "Error: Cannot create %s\n", out_dir);
+            return 1;
+        }
+        if (w < ntests) {
+            snprintf(in_dir, sizeof(in_dir), "%s/%s", opts->tests_dir, name);
+        } else {
+            // Generated kernels keep their inputs next to their outputs
+            snprintf(in_dir, sizeof(in_dir), "%s", out_dir);
+            if (!bench_kernels[w - ntests].gen(in_dir)) return 1;
+        }
+
+        if (bench_workload(&run_config, opts, name, in_dir, out_dir, &results[count])) {
+            print_result(&results[count]);
+            count++;
+        }
+    }
+
+    double core_cycle_ns[2] = { 0, 0 };
+    if (!opts->only || strstr("core_cycle", opts->only)) {
+        core_cycle_ns[0] = micro_core_cycle(&run_config, 1, opts->reps);
+        core_cycle_ns[1] = micro_core_cycle(&run_config, 2, opts->reps);
+        printf("\ncore_cycle alone (alu_loop, %d cycles x %d cores): %.2f ns per core-cycle, "
+               "%.2f dual-issue\n", BENCH_MICRO_CYCLES, NUM_CORES, core_cycle_ns[0],
+               core_cycle_ns[1]);
+    }
+    printf("\nPeak RSS: %.1f MB\n", (double)platform_peak_rss() / (1024.0 * 1024.0));
+
+    if (opts->save_file) {
+        if (!save_results(opts->save_file, opts, results, count, core_cycle_ns)) return 1;
+        printf("Saved %s\n", opts->save_file);
+    }
+    if (opts->baseline_file) {
+        int regressions = compare_baseline(opts->baseline_file, opts->threshold, results, count);
+        if (regressions != 0) return 1;
+    }
+    return 0;
+}
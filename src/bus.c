@@ -20,6 +20,18 @@
  * - Then: 8 consecutive Flush cycles (one word per cycle)
  * - If another cache has M state, that cache supplies data via Flush
  *   and memory updates in parallel
+ * - Optional (config.c2c_clean): a clean E/S holder supplies the block
+ *   instead of memory, after config.c2c_latency cycles
+ * 
+ * Writeback Buffer (optional, config.wb_buffer):
+ * - Dirty victims are queued per core instead of written back instantly
+ * - Demand BusRd/BusRdX always win arbitration; a queued victim is drained
+ *   as 8 Flush cycles (origid = owner, no delay) only in idle bus slots
+ * - A request for a block still in any buffer is supplied from the buffer
+ * 
+ * Barrier Unit (BAR instruction):
+ * - Not a bus transaction; a core that reaches BAR sleeps until every core
+ *   that has not halted has arrived
  * =============================================================================
  */
 
@@ -63,15 +75,31 @@ void bus_snoop(Simulator* sim, BusCommand cmd, uint32_t addr, int requester) {
     sim->bus.snoop_shared = false;
     sim->bus.snoop_has_modified = false;
     sim->bus.snoop_modified_core = -1;
+    sim->bus.snoop_clean_core = -1;
+    sim->bus.snoop_buffer_core = -1;
     
-    // All other caches snoop
-    for (int i = 0; i < NUM_CORES; i++) {
-        if (i == requester) continue;
+    // Every other cache holding the block snoops, in ascending core order
+    uint64_t holders = cache_holders(sim, addr) & ~CORE_BIT(requester);
+    for (int i = 0; holders; i++, holders >>= 1) {
+        if (!(holders & 1)) continue;
         
         if (cmd == BUS_CMD_BUSRD) {
-            mesi_snoop_busrd(&sim->cores[i], sim, addr, requester);
+            mesi_snoop_busrd(&sim->cores[i], sim, addr);
         } else if (cmd == BUS_CMD_BUSRDX) {
-            mesi_snoop_busrdx(&sim->cores[i], sim, addr, requester);
+            mesi_snoop_busrdx(&sim->cores[i], sim, addr);
+        }
+    }
+    
+    // Writeback buffers snoop too, the requester's own included (it may be
+    // re-reading a block it just evicted). The entry leaves the buffer and
+    // is written to memory as it is flushed to the requester.
+    if (sim->config.wb_buffer) {
+        for (int i = 0; i < NUM_CORES; i++) {
+            if (wb_buffer_take(&sim->cores[i], addr, sim->bus.snoop_buffer_data)) {
+                sim->bus.snoop_buffer_core = i;
+                sim->cores[i].wb_snoop_hits++;
+                break;
+            }
         }
     }
 }
@@ -83,7 +111,8 @@ void bus_snoop(Simulator* sim, BusCommand cmd, uint32_t addr, int requester) {
 
 // Start memory response (called when BusRd/BusRdX is granted)
 static void memory_start_response(Simulator* sim, int core_id, uint32_t block_addr, 
-                                   bool is_rdx, int data_source, bool shared) {
+                                   bool is_rdx, int data_source, bool source_dirty,
+                                   bool shared) {
     MemoryResponse* resp = &sim->bus.mem_response;
     
     resp->valid = true;
@@ -91,11 +120,20 @@ static void memory_start_response(Simulator* sim, int core_id, uint32_t block_ad
     resp->block_addr = block_addr;
     resp->is_rdx = is_rdx;
     resp->data_source = data_source;
+    resp->source_dirty = source_dirty;
     resp->words_sent = 0;
     resp->shared = shared;
+    resp->is_writeback = false;
+    resp->data_buffered = false;
     
-    // 16 cycle delay before first word
-    resp->cycles_remaining = MEM_RESPONSE_DELAY;
+    // 16 cycle delay before first word (config.mem_delay; shorter
+    // intervention latency when cache-to-cache transfer is enabled and a
+    // peer supplies it)
+    if (sim->config.c2c_clean && data_source >= 0) {
+        resp->cycles_remaining = sim->config.c2c_latency;
+    } else {
+        resp->cycles_remaining = sim->config.mem_delay;
+    }
 }
 
 // Send one Flush word
@@ -112,16 +150,23 @@ static void memory_send_flush(Simulator* sim) {
     int origid;
     
     // Get data from source
-    if (resp->data_source >= 0 && resp->data_source < NUM_CORES) {
-        // Data from cache with M state
+    if (resp->data_buffered) {
+        // Data from a writeback buffer entry (always dirty)
+        data = resp->block_data[resp->words_sent];
+        origid = resp->data_source;
+        sim->main_memory[word_addr] = data;
+    } else if (resp->data_source >= 0 && resp->data_source < NUM_CORES) {
+        // Data from peer cache (M, or clean E/S with c2c_clean)
         Core* src_core = &sim->cores[resp->data_source];
         int src_index = cache_get_index(resp->block_addr);
         int src_offset = resp->words_sent;
         data = src_core->cache.dsram[(src_index << BLOCK_OFFSET_BITS) | src_offset];
         origid = resp->data_source;
         
-        // Also update main memory (write-back)
-        sim->main_memory[word_addr] = data;
+        // Dirty data also updates main memory (write-back)
+        if (resp->source_dirty) {
+            sim->main_memory[word_addr] = data;
+        }
     } else {
         // Data from main memory
         data = sim->main_memory[word_addr];
@@ -136,6 +181,16 @@ static void memory_send_flush(Simulator* sim) {
     bus->state.shared = resp->shared;
     bus->state.active = true;
     
+    // A writeback drain only updates memory
+    if (resp->is_writeback) {
+        resp->words_sent++;
+        if (resp->words_sent >= CACHE_BLOCK_SIZE) {
+            resp->valid = false;
+            bus->arbiter.transaction_in_progress = false;
+        }
+        return;
+    }
+    
     // Write data to requesting core's cache
     Core* req_core = &sim->cores[resp->requesting_core];
     int req_index = cache_get_index(resp->block_addr);
@@ -147,11 +202,12 @@ static void memory_send_flush(Simulator* sim) {
     // Check if done
     if (resp->words_sent >= CACHE_BLOCK_SIZE) {
         // Update requesting cache's TSRAM
-        TSRAMEntry* entry = &req_core->cache.tsram[req_index];
-        entry->tag = cache_get_tag(resp->block_addr);
+        TSRAMEntry* entry = &CACHE_TSRAM(&req_core->cache, req_index);
+        MESIState mesi;
+        bool forward = false;
         
         if (resp->is_rdx) {
-            entry->mesi = MESI_MODIFIED;
+            mesi = MESI_MODIFIED;
             
             // If this was a write miss, complete the pending write
             if (req_core->pending_is_write) {
@@ -163,11 +219,17 @@ static void memory_send_flush(Simulator* sim) {
         } else {
             // BusRd - state depends on bus_shared
             if (resp->shared) {
-                entry->mesi = MESI_SHARED;
+                mesi = MESI_SHARED;
+                // Newest sharer takes over the Forward role
+                forward = (sim->config.c2c_responder == C2C_RESPONDER_FORWARD);
             } else {
-                entry->mesi = MESI_EXCLUSIVE;
+                mesi = MESI_EXCLUSIVE;
             }
         }
+        *entry = (TSRAMEntry)((cache_get_tag(resp->block_addr) << TSRAM_TAG_SHIFT) | mesi |
+                              (forward ? TSRAM_FORWARD : 0));
+        
+        if (sim->bus_stats) bus_stats_fill(sim, resp->requesting_core);
         
         // Clear core's waiting state
         req_core->waiting_for_bus = false;
@@ -180,6 +242,57 @@ static void memory_send_flush(Simulator* sim) {
     }
 }
 
+/* =============================================================================
+ * WRITEBACK BUFFER DRAIN
+ * =============================================================================
+ */
+
+// Pick a core whose buffered victims should drain now (-1 if none)
+static int wb_drain_select(Simulator* sim) {
+    Bus* bus = &sim->bus;
+    
+    for (int i = 0; i < NUM_CORES; i++) {
+        int core_id = (bus->arbiter.last_drained + 1 + i) % NUM_CORES;
+        int count = sim->cores[core_id].wb_buffer.count;
+        
+        if (count == 0) continue;
+        if (sim->config.wb_drain == WB_DRAIN_EAGER ||
+            count >= sim->config.wb_drain_threshold) {
+            return core_id;
+        }
+    }
+    return -1;
+}
+
+// Put the oldest victim of core_id on the bus; first Flush word goes out now
+static void wb_start_drain(Simulator* sim, int core_id) {
+    Bus* bus = &sim->bus;
+    MemoryResponse* resp = &bus->mem_response;
+    Core* core = &sim->cores[core_id];
+    WBEntry e;
+    
+    wb_buffer_pop(core, &e);
+    core->wb_drained++;
+    
+    resp->valid = true;
+    resp->requesting_core = core_id;
+    resp->block_addr = e.block_addr;
+    resp->is_rdx = false;
+    resp->data_source = core_id;
+    resp->source_dirty = true;
+    resp->words_sent = 0;
+    resp->shared = false;
+    resp->is_writeback = true;
+    resp->data_buffered = true;
+    resp->cycles_remaining = 0;
+    memcpy(resp->block_data, e.data, sizeof(e.data));
+    
+    bus->arbiter.last_drained = core_id;
+    bus->arbiter.transaction_in_progress = true;
+    
+    memory_send_flush(sim);
+}
+
 /* =============================================================================
  * MEMORY CYCLE
  * =============================================================================
@@ -226,7 +339,14 @@ void bus_cycle(Simulator* sim) {
     int granted = bus_arbitrate(sim);
     
     if (granted < 0) {
-        return;  // No requests
+        // No demand requests - idle slot for a buffered writeback
+        if (sim->config.wb_buffer) {
+            int drain = wb_drain_select(sim);
+            if (drain >= 0) {
+                wb_start_drain(sim, drain);
+            }
+        }
+        return;
     }
     
     Core* core = &sim->cores[granted];
@@ -235,10 +355,28 @@ void bus_cycle(Simulator* sim) {
     
     // Before issuing, handle eviction if needed
     int index = cache_get_index(addr);
-    TSRAMEntry* entry = &core->cache.tsram[index];
-    if (entry->mesi == MESI_MODIFIED && entry->tag != cache_get_tag(addr)) {
-        // Need to writeback old block first
-        cache_writeback_block(core, sim, index);
+    TSRAMEntry entry = CACHE_TSRAM(&core->cache, index);
+    if (TSRAM_MESI(entry) == MESI_MODIFIED && TSRAM_TAG(entry) != cache_get_tag(addr)) {
+        if (!sim->config.wb_buffer) {
+            // Need to writeback old block first
+            cache_writeback_block(core, sim, index);
+        } else if (core->wb_buffer.count >= sim->config.wb_depth) {
+            // Buffer full - drain its oldest victim, retry the miss after
+            core->wb_full_stalls++;
+            wb_start_drain(sim, granted);
+            return;
+        } else {
+            wb_buffer_push(core, index);
+        }
+    }
+    
+    // The fill overwrites the victim's DSRAM frame one word per cycle, so
+    // drop the victim now: the core's other threads miss on it instead of
+    // reading a half-filled frame
+    if (TSRAM_TAG(entry) != cache_get_tag(addr)) {
+        TSRAMEntry* victim = &CACHE_TSRAM(&core->cache, index);
+        TSRAM_SET_MESI(*victim, MESI_INVALID);
+        *victim &= ~TSRAM_FORWARD;
     }
     
     // Perform snooping BEFORE setting bus state (to get shared signal)
@@ -258,9 +396,68 @@ void bus_cycle(Simulator* sim) {
     
     // Clear core's pending request flag (but keep waiting_for_bus true)
     core->bus_request_pending = false;
+    if (sim->bus_stats) bus_stats_grant(sim, granted);
     
-    // Start memory response
-    int data_source = bus->snoop_has_modified ? bus->snoop_modified_core : -1;
+    // Start memory response: a buffered victim, else the M holder, else the
+    // designated clean holder, else memory
+    if (bus->snoop_buffer_core >= 0) {
+        memory_start_response(sim, granted, addr, (cmd == BUS_CMD_BUSRDX),
+                              bus->snoop_buffer_core, true, bus->snoop_shared);
+        bus->mem_response.data_buffered = true;
+        memcpy(bus->mem_response.block_data, bus->snoop_buffer_data,
+               sizeof(bus->snoop_buffer_data));
+        return;
+    }
+    
+    int data_source = bus->snoop_has_modified ? bus->snoop_modified_core : 
+                      bus->snoop_clean_core;
+    if (data_source >= 0) {
+        core->c2c_fills++;
+        sim->cores[data_source].c2c_supplies++;
+        if (sim->sharing) sharing_c2c(sim, addr);
+    }
     memory_start_response(sim, granted, addr, (cmd == BUS_CMD_BUSRDX), 
-                          data_source, bus->snoop_shared);
+                          data_source, bus->snoop_has_modified, bus->snoop_shared);
+}
+
+/* =============================================================================
+ * BARRIER UNIT
+ * =============================================================================
+ */
+
+// Called from MEM for BAR. Returns true once released.
+bool barrier_wait(Core* core, Simulator* sim) {
+    BarrierUnit* bar = &sim->barrier;
+    
+    if (!core->bar_waiting) {
+        core->bar_waiting = true;
+        core->bar_generation = bar->generation;
+        core->barrier_waits++;
+        bar->arrived |= (uint64_t)1 << core->core_id;
+        barrier_update(sim);    // Last to arrive releases everyone
+    }
+    
+    if (bar->generation == core->bar_generation) {
+        core->sleeping = true;
+        return false;
+    }
+    core->bar_waiting = false;
+    return true;
+}
+
+// Release the barrier once every running core has arrived (also called
+// every cycle, since a core that halts no longer counts)
+void barrier_update(Simulator* sim) {
+    BarrierUnit* bar = &sim->barrier;
+    if (bar->arrived == 0) return;
+    
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (!sim->cores[i].halted && !(bar->arrived & ((uint64_t)1 << i))) return;
+    }
+    
+    bar->arrived = 0;
+    bar->generation++;
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (sim->cores[i].bar_waiting) sim->cores[i].sleeping = false;
+    }
 }
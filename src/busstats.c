@@ -0,0 +1,176 @@
+/*
+ * =============================================================================
+ * Bus Contention Statistics
+ * =============================================================================
+ * Optional (config.bus_stats, --bus-stats). Written as JSON (busstats.json
+ * next to stats0.txt) for scripts and plots:
+ * - per core: request-to-grant and request-to-fill latency histograms.
+ *   A request counts from the cycle bus_issue_request ran, so an immediate
+ *   grant has latency 1
+ * - bus occupancy: every cycle is idle, command (BusRd/BusRdX issued),
+ *   delay (transaction waiting for its first Flush word), flush (fill
+ *   words) or writeback (buffered victim drain words)
+ * - queue depth: histogram of requests left waiting after arbitration
+ * Histogram bucket b counts latencies in [2^b, 2^(b+1)); bucket 0 also
+ * holds 0 and the last bucket everything above.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+static int latency_bucket(uint64_t cycles) {
+    int b = 0;
+    while (cycles >= 2 && b < BUS_HIST_BUCKETS - 1) {
+        cycles >>= 1;
+        b++;
+    }
+    return b;
+}
+
+static void latency_add(LatencyHist* h, uint64_t cycles) {
+    h->count++;
+    h->sum += cycles;
+    if (cycles > h->max) h->max = cycles;
+    h->buckets[latency_bucket(cycles)]++;
+}
+
+/* =============================================================================
+ * SETUP
+ * =============================================================================
+ */
+
+bool bus_stats_init(Simulator* sim) {
+    sim->bus_stats = (BusStats*)calloc(1, sizeof(BusStats));
+    if (!sim->bus_stats) {
+        fprintf(stderr, "Error: Failed to allocate bus statistics\n");
+        return false;
+    }
+    return true;
+}
+
+void bus_stats_free(Simulator* sim) {
+    free(sim->bus_stats);
+    sim->bus_stats = NULL;
+}
+
+/* =============================================================================
+ * COLLECTION HOOKS
+ * =============================================================================
+ */
+
+// First sight of a request issued in the previous cycle's core_cycle
+static void note_request(BusStats* bs, int core_id, uint64_t cycle) {
+    if (bs->request_open[core_id]) return;
+    bs->request_open[core_id] = true;
+    bs->request_cycle[core_id] = cycle - 1;
+    bs->requests[core_id]++;
+}
+
+// bus_cycle granted core_id's request
+void bus_stats_grant(Simulator* sim, int core_id) {
+    BusStats* bs = sim->bus_stats;
+    note_request(bs, core_id, sim->cycle);
+    latency_add(&bs->grant[core_id], sim->cycle - bs->request_cycle[core_id]);
+}
+
+// Last Flush word of core_id's fill landed
+void bus_stats_fill(Simulator* sim, int core_id) {
+    BusStats* bs = sim->bus_stats;
+    if (!bs->request_open[core_id]) return;
+    latency_add(&bs->fill[core_id], sim->cycle - bs->request_cycle[core_id]);
+    bs->request_open[core_id] = false;
+}
+
+// Once per cycle, after bus_cycle
+void bus_stats_cycle(Simulator* sim) {
+    BusStats* bs = sim->bus_stats;
+    Bus* bus = &sim->bus;
+    BusPhase phase;
+
+    if (bus->state.cmd == BUS_CMD_BUSRD || bus->state.cmd == BUS_CMD_BUSRDX) {
+        phase = BUS_PHASE_COMMAND;
+    } else if (bus->state.cmd == BUS_CMD_FLUSH) {
+        phase = bus->mem_response.is_writeback ? BUS_PHASE_WRITEBACK : BUS_PHASE_FLUSH;
+    } else if (bus->arbiter.transaction_in_progress) {
+        phase = BUS_PHASE_DELAY;
+    } else {
+        phase = BUS_PHASE_IDLE;
+    }
+    bs->phase_cycles[phase]++;
+
+    int depth = 0;
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (!sim->cores[i].bus_request_pending) continue;
+        note_request(bs, i, sim->cycle);
+        depth++;
+    }
+    bs->queue_depth[depth]++;
+}
+
+/* =============================================================================
+ * JSON REPORT
+ * =============================================================================
+ */
+
+static void write_hist(FILE* fp, const char* name, LatencyHist* h, bool last) {
+    fprintf(fp, "      \"%s\": {\"count\": %llu, \"mean\": %.2f, \"max\": %llu, \"hist\": [",
+            name, (unsigned long long)h->count,
+            h->count ? (double)h->sum / (double)h->count : 0.0,
+            (unsigned long long)h->max);
+    for (int b = 0; b < BUS_HIST_BUCKETS; b++) {
+        fprintf(fp, "%s%llu", b ? ", " : "", (unsigned long long)h->buckets[b]);
+    }
+    fprintf(fp, "]}%s\n", last ? "" : ",");
+}
+
+void bus_stats_write(Simulator* sim, const char* filename) {
+    static const char* const phase_names[BUS_PHASE_COUNT] = {
+        "idle", "command", "delay", "flush", "writeback"
+    };
+    BusStats* bs = sim->bus_stats;
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return;
+    }
+
+    uint64_t total = 0;
+    for (int p = 0; p < BUS_PHASE_COUNT; p++) total += bs->phase_cycles[p];
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"cycles\": %llu,\n", (unsigned long long)total);
+
+    fprintf(fp, "  \"occupancy\": {");
+    for (int p = 0; p < BUS_PHASE_COUNT; p++) {
+        fprintf(fp, "%s\"%s\": %llu", p ? ", " : "", phase_names[p],
+                (unsigned long long)bs->phase_cycles[p]);
+    }
+    fprintf(fp, "},\n");
+    fprintf(fp, "  \"utilization\": %.4f,\n",
+            total ? 1.0 - (double)bs->phase_cycles[BUS_PHASE_IDLE] / (double)total : 0.0);
+
+    fprintf(fp, "  \"queue_depth\": [");
+    for (int d = 0; d <= NUM_CORES; d++) {
+        fprintf(fp, "%s%llu", d ? ", " : "", (unsigned long long)bs->queue_depth[d]);
+    }
+    fprintf(fp, "],\n");
+
+    fprintf(fp, "  \"hist_lower_bounds\": [");
+    for (int b = 0; b < BUS_HIST_BUCKETS; b++) {
+        fprintf(fp, "%s%u", b ? ", " : "", b ? (1u << b) : 0u);
+    }
+    fprintf(fp, "],\n");
+
+    fprintf(fp, "  \"cores\": [\n");
+    for (int i = 0; i < NUM_CORES; i++) {
+        fprintf(fp, "    {\n");
+        fprintf(fp, "      \"core\": %d,\n", i);
+        fprintf(fp, "      \"requests\": %llu,\n", (unsigned long long)bs->requests[i]);
+        write_hist(fp, "grant", &bs->grant[i], false);
+        write_hist(fp, "fill", &bs->fill[i], true);
+        fprintf(fp, "    }%s\n", (i < NUM_CORES - 1) ? "," : "");
+    }
+    fprintf(fp, "  ]\n");
+    fprintf(fp, "}\n");
+    fclose(fp);
+}
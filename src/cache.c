@@ -17,11 +17,19 @@
  * - Tag:   12 bits
  * 
  * MESI States: 0=Invalid, 1=Shared, 2=Exclusive, 3=Modified
+ * 
+ * TSRAM entries are 16 bits and live in one [index][core] table shared by
+ * all caches (Simulator.tsram), so a snoop checks every cache at once.
  * =============================================================================
  */
 
 #include "sim.h"
 
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define TSRAM_SSE2
+#endif
+
 /* =============================================================================
  * ADDRESS DECOMPOSITION
  * =============================================================================
@@ -58,11 +66,34 @@ static int dsram_addr(int index, int offset) {
  */
 
 static bool cache_hit_check(Cache* cache, uint32_t addr) {
-    int index = cache_get_index(addr);
+    return TSRAM_HOLDS(CACHE_TSRAM(cache, cache_get_index(addr)), cache_get_tag(addr));
+}
+
+// Mask of the cores whose cache holds addr's block (any valid state).
+// Compares the whole Simulator.tsram row of the set at once.
+uint64_t cache_holders(const Simulator* sim, uint32_t addr) {
+    const TSRAMEntry* row = &sim->tsram[cache_get_index(addr) * TSRAM_ROW];
     uint32_t tag = cache_get_tag(addr);
-    TSRAMEntry* entry = &cache->tsram[index];
+    uint64_t mask = 0;
     
-    return (entry->mesi != MESI_INVALID) && (entry->tag == tag);
+#ifdef TSRAM_SSE2
+    const __m128i tag_bits = _mm_set1_epi16(TSRAM_DUMP_MASK & ~TSRAM_MESI_MASK);
+    const __m128i mesi_bits = _mm_set1_epi16(TSRAM_MESI_MASK);
+    const __m128i key = _mm_set1_epi16((short)(tag << TSRAM_TAG_SHIFT));
+    const __m128i zero = _mm_setzero_si128();
+    for (int c = 0; c < TSRAM_ROW; c += 8) {
+        __m128i v = _mm_load_si128((const __m128i*)&row[c]);
+        __m128i same_tag = _mm_cmpeq_epi16(_mm_and_si128(v, tag_bits), key);
+        __m128i invalid = _mm_cmpeq_epi16(_mm_and_si128(v, mesi_bits), zero);
+        __m128i hit = _mm_andnot_si128(invalid, same_tag);
+        mask |= (uint64_t)(_mm_movemask_epi8(_mm_packs_epi16(hit, zero)) & 0xFF) << c;
+    }
+#else
+    for (int c = 0; c < NUM_CORES; c++) {
+        if (TSRAM_HOLDS(row[c], tag)) mask |= CORE_BIT(c);
+    }
+#endif
+    return mask;
 }
 
 /* =============================================================================
@@ -76,23 +107,25 @@ bool cache_read(Core* core, Simulator* sim, uint32_t addr, int32_t* data) {
     int index = cache_get_index(addr);
     int offset = cache_get_offset(addr);
     uint32_t tag = cache_get_tag(addr);
-    TSRAMEntry* entry = &cache->tsram[index];
+    TSRAMEntry* entry = &CACHE_TSRAM(cache, index);
     
     // Check hit
-    if (entry->mesi != MESI_INVALID && entry->tag == tag) {
+    if (TSRAM_HOLDS(*entry, tag)) {
         // Hit!
         *data = cache->dsram[dsram_addr(index, offset)];
         core->read_hits++;
+        if (sim->miss_class) miss_class_hit(sim, core, addr);
         return true;
     }
     
     // Miss - only count miss once per request (when starting bus transaction)
     if (!core->waiting_for_bus && !core->bus_request_pending) {
         core->read_misses++;
+        if (sim->miss_class) miss_class_miss(sim, core, addr, false);
         uint32_t block_addr = cache_get_block_addr(addr);
         
         // Check if eviction needed (current line is Modified with different tag)
-        if (entry->mesi == MESI_MODIFIED && entry->tag != tag) {
+        if (TSRAM_MESI(*entry) == MESI_MODIFIED && TSRAM_TAG(*entry) != tag) {
             // Writeback will happen when we get bus access
         }
         
@@ -114,22 +147,24 @@ bool cache_write(Core* core, Simulator* sim, uint32_t addr, int32_t data) {
     int index = cache_get_index(addr);
     int offset = cache_get_offset(addr);
     uint32_t tag = cache_get_tag(addr);
-    TSRAMEntry* entry = &cache->tsram[index];
+    TSRAMEntry* entry = &CACHE_TSRAM(cache, index);
     
     // Check hit
-    if (entry->mesi != MESI_INVALID && entry->tag == tag) {
+    if (TSRAM_HOLDS(*entry, tag)) {
         // Hit
-        if (entry->mesi == MESI_MODIFIED || entry->mesi == MESI_EXCLUSIVE) {
+        if (TSRAM_MESI(*entry) == MESI_MODIFIED || TSRAM_MESI(*entry) == MESI_EXCLUSIVE) {
             // Can write directly, transition to M
             cache->dsram[dsram_addr(index, offset)] = data;
-            entry->mesi = MESI_MODIFIED;
+            TSRAM_SET_MESI(*entry, MESI_MODIFIED);
             core->write_hits++;
+            if (sim->miss_class) miss_class_hit(sim, core, addr);
             return true;
-        } else if (entry->mesi == MESI_SHARED) {
+        } else if (TSRAM_MESI(*entry) == MESI_SHARED) {
             // Need to upgrade to exclusive (BusRdX)
             // This counts as a write miss (upgrade miss)
             if (!core->waiting_for_bus && !core->bus_request_pending) {
                 core->write_misses++;
+                if (sim->miss_class) miss_class_miss(sim, core, addr, true);
                 uint32_t block_addr = cache_get_block_addr(addr);
                 core->pending_write_data = data;
                 core->pending_store_addr = addr;
@@ -143,6 +178,7 @@ bool cache_write(Core* core, Simulator* sim, uint32_t addr, int32_t data) {
     // Miss - write-allocate policy, need to fetch block first
     if (!core->waiting_for_bus && !core->bus_request_pending) {
         core->write_misses++;
+        if (sim->miss_class) miss_class_miss(sim, core, addr, false);
         uint32_t block_addr = cache_get_block_addr(addr);
         core->pending_write_data = data;
         core->pending_store_addr = addr;
@@ -153,6 +189,78 @@ bool cache_write(Core* core, Simulator* sim, uint32_t addr, int32_t data) {
     return false;  // Stall
 }
 
+/* =============================================================================
+ * ATOMIC READ-MODIFY-WRITE (FAA / CAS)
+ * =============================================================================
+ * Performed only while the line is held in M or E, so no other cache has a
+ * copy. Otherwise a BusRdX is issued (without a pending write) and the RMW
+ * runs when the MEM stage retries in the cycle the last Flush word lands,
+ * before any later request can be granted. Returns true when done.
+ */
+
+bool cache_atomic(Core* core, Simulator* sim, Instruction* inst, uint32_t addr,
+                  int32_t operand, int32_t expected, int32_t* old) {
+    Cache* cache = &core->cache;
+    int index = cache_get_index(addr);
+    int offset = cache_get_offset(addr);
+    uint32_t tag = cache_get_tag(addr);
+    TSRAMEntry* entry = &CACHE_TSRAM(cache, index);
+    
+    if (TSRAM_TAG(*entry) == tag &&
+        (TSRAM_MESI(*entry) == MESI_MODIFIED || TSRAM_MESI(*entry) == MESI_EXCLUSIVE)) {
+        int32_t* word = &cache->dsram[dsram_addr(index, offset)];
+        *old = *word;
+        if (inst->opcode == OP_FAA) {
+            *word = *old + operand;
+        } else if (*old == expected) {
+            *word = operand;
+        } else {
+            core->cas_fail++;
+        }
+        TSRAM_SET_MESI(*entry, MESI_MODIFIED);
+        core->write_hits++;
+        core->atomic_ops++;
+        if (sim->miss_class) miss_class_hit(sim, core, addr);
+        return true;
+    }
+    
+    // Miss or Shared: fetch exclusive ownership first
+    if (!core->waiting_for_bus && !core->bus_request_pending) {
+        core->write_misses++;
+        if (sim->miss_class) {
+            miss_class_miss(sim, core, addr, TSRAM_TAG(*entry) == tag && TSRAM_MESI(*entry) == MESI_SHARED);
+        }
+        bus_issue_request(core, BUS_CMD_BUSRDX, cache_get_block_addr(addr));
+    }
+    return false;  // Stall
+}
+
+/* =============================================================================
+ * MWAIT MONITOR
+ * =============================================================================
+ * MWAIT sleeps only while the monitored line is valid in this cache, so a
+ * write that happened before it (line already invalidated) is never missed.
+ * mesi_snoop_busrdx fires the monitor; the MWAIT then completes on its retry.
+ * Returns true when the MWAIT is done.
+ */
+
+bool monitor_wait(Core* core, uint32_t addr) {
+    if (core->monitor == MONITOR_FIRED) {
+        core->monitor = MONITOR_IDLE;
+        return true;
+    }
+    if (core->monitor == MONITOR_IDLE) {
+        if (!TSRAM_HOLDS(CACHE_TSRAM(&core->cache, cache_get_index(addr)), cache_get_tag(addr))) {
+            return true;    // Nothing cached to watch
+        }
+        core->monitor = MONITOR_ARMED;
+        core->monitor_block = cache_get_block_addr(addr);
+        core->mwait_sleeps++;
+    }
+    core->sleeping = true;
+    return false;
+}
+
 /* =============================================================================
  * CACHE WRITEBACK (for eviction)
  * =============================================================================
@@ -160,12 +268,12 @@ bool cache_write(Core* core, Simulator* sim, uint32_t addr, int32_t data) {
 
 void cache_writeback_block(Core* core, Simulator* sim, int index) {
     Cache* cache = &core->cache;
-    TSRAMEntry* entry = &cache->tsram[index];
+    TSRAMEntry entry = CACHE_TSRAM(cache, index);
     
-    if (entry->mesi != MESI_MODIFIED) return;
+    if (TSRAM_MESI(entry) != MESI_MODIFIED) return;
     
     // Calculate block address from tag and index
-    uint32_t block_addr = (entry->tag << (INDEX_BITS + BLOCK_OFFSET_BITS)) |
+    uint32_t block_addr = (TSRAM_TAG(entry) << (INDEX_BITS + BLOCK_OFFSET_BITS)) |
                           ((uint32_t)index << BLOCK_OFFSET_BITS);
     
     // Write all 8 words to main memory
@@ -174,6 +282,74 @@ void cache_writeback_block(Core* core, Simulator* sim, int index) {
     }
 }
 
+/* =============================================================================
+ * WRITEBACK BUFFER (optional)
+ * =============================================================================
+ * With config.wb_buffer the victim is copied here when the miss is granted
+ * and drained later as a Flush transaction in an idle bus slot (bus.c).
+ * Caller checks for free space; a full buffer forces a drain first.
+ */
+
+// Queue the Modified line at index and invalidate it in TSRAM
+void wb_buffer_push(Core* core, int index) {
+    WritebackBuffer* wb = &core->wb_buffer;
+    TSRAMEntry* entry = &CACHE_TSRAM(&core->cache, index);
+    
+    int slot = (wb->head + wb->count) % WB_BUFFER_MAX_DEPTH;
+    WBEntry* e = &wb->entries[slot];
+    e->block_addr = (TSRAM_TAG(*entry) << (INDEX_BITS + BLOCK_OFFSET_BITS)) |
+                    ((uint32_t)index << BLOCK_OFFSET_BITS);
+    for (int i = 0; i < CACHE_BLOCK_SIZE; i++) {
+        e->data[i] = core->cache.dsram[dsram_addr(index, i)];
+    }
+    wb->count++;
+    core->wb_queued++;
+    
+    TSRAM_SET_MESI(*entry, MESI_INVALID);
+    *entry &= ~TSRAM_FORWARD;
+}
+
+// Remove a queued block (snoop hit). Returns true and its data if present.
+bool wb_buffer_take(Core* core, uint32_t block_addr, int32_t* data) {
+    WritebackBuffer* wb = &core->wb_buffer;
+    
+    for (int i = 0; i < wb->count; i++) {
+        int slot = (wb->head + i) % WB_BUFFER_MAX_DEPTH;
+        if (wb->entries[slot].block_addr != block_addr) continue;
+        
+        memcpy(data, wb->entries[slot].data, sizeof(wb->entries[slot].data));
+        
+        // Close the gap, keeping FIFO order
+        for (int j = i; j < wb->count - 1; j++) {
+            int dst = (wb->head + j) % WB_BUFFER_MAX_DEPTH;
+            int src = (wb->head + j + 1) % WB_BUFFER_MAX_DEPTH;
+            wb->entries[dst] = wb->entries[src];
+        }
+        wb->count--;
+        return true;
+    }
+    return false;
+}
+
+// Dequeue the oldest victim (caller checks count > 0)
+void wb_buffer_pop(Core* core, WBEntry* out) {
+    WritebackBuffer* wb = &core->wb_buffer;
+    *out = wb->entries[wb->head];
+    wb->head = (wb->head + 1) % WB_BUFFER_MAX_DEPTH;
+    wb->count--;
+}
+
+// Write every queued victim straight to memory (end of simulation)
+void wb_buffer_flush(Core* core, Simulator* sim) {
+    WBEntry e;
+    while (core->wb_buffer.count > 0) {
+        wb_buffer_pop(core, &e);
+        for (int i = 0; i < CACHE_BLOCK_SIZE; i++) {
+            sim->main_memory[e.block_addr + i] = e.data[i];
+        }
+    }
+}
+
 /* =============================================================================
  * BUS REQUEST ISSUE
  * =============================================================================
@@ -191,67 +367,77 @@ void bus_issue_request(Core* core, BusCommand cmd, uint32_t block_addr) {
  * =============================================================================
  */
 
-// Called when another core issues BusRd
-void mesi_snoop_busrd(Core* core, Simulator* sim, uint32_t block_addr, int requester) {
-    if (core->core_id == requester) return;
-    
-    Cache* cache = &core->cache;
-    int index = cache_get_index(block_addr);
-    uint32_t tag = cache_get_tag(block_addr);
-    TSRAMEntry* entry = &cache->tsram[index];
+// Offer this cache as the clean (E/S) responder for a snooped block.
+// With LOWEST_ID the first holder wins (bus_snoop visits cores in ascending
+// order); with FORWARD only an E line or an S line tagged Forward may answer.
+static void snoop_offer_clean(Core* core, Simulator* sim, TSRAMEntry entry) {
+    if (!sim->config.c2c_clean || sim->bus.snoop_clean_core >= 0) return;
     
-    // Check if we have this block
-    if (entry->mesi == MESI_INVALID || entry->tag != tag) {
-        return;  // Don't have it
+    if (sim->config.c2c_responder == C2C_RESPONDER_FORWARD &&
+        TSRAM_MESI(entry) != MESI_EXCLUSIVE && !(entry & TSRAM_FORWARD)) {
+        return;
     }
+    sim->bus.snoop_clean_core = core->core_id;
+}
+
+// Called for each other core holding the block when a BusRd is granted
+void mesi_snoop_busrd(Core* core, Simulator* sim, uint32_t block_addr) {
+    TSRAMEntry* entry = &CACHE_TSRAM(&core->cache, cache_get_index(block_addr));
     
     // We have it - set shared signal
     sim->bus.snoop_shared = true;
     
-    switch (entry->mesi) {
+    switch (TSRAM_MESI(*entry)) {
         case MESI_MODIFIED:
             // We have dirty data - we'll supply it
             sim->bus.snoop_has_modified = true;
             sim->bus.snoop_modified_core = core->core_id;
             // Transition M -> S (will happen after data transfer)
-            entry->mesi = MESI_SHARED;
+            TSRAM_SET_MESI(*entry, MESI_SHARED);
+            if (sim->sharing) sharing_downgrade(sim, block_addr);
             break;
             
         case MESI_EXCLUSIVE:
+            snoop_offer_clean(core, sim, *entry);
             // Transition E -> S
-            entry->mesi = MESI_SHARED;
+            TSRAM_SET_MESI(*entry, MESI_SHARED);
             break;
             
         case MESI_SHARED:
+            snoop_offer_clean(core, sim, *entry);
             // Stay S
             break;
             
         default:
             break;
     }
+    
+    // Forward moves to the requester, which is the newest sharer
+    *entry &= ~TSRAM_FORWARD;
 }
 
-// Called when another core issues BusRdX
-void mesi_snoop_busrdx(Core* core, Simulator* sim, uint32_t block_addr, int requester) {
-    if (core->core_id == requester) return;
-    
-    Cache* cache = &core->cache;
-    int index = cache_get_index(block_addr);
-    uint32_t tag = cache_get_tag(block_addr);
-    TSRAMEntry* entry = &cache->tsram[index];
+// Called for each other core holding the block when a BusRdX is granted
+void mesi_snoop_busrdx(Core* core, Simulator* sim, uint32_t block_addr) {
+    TSRAMEntry* entry = &CACHE_TSRAM(&core->cache, cache_get_index(block_addr));
     
-    // Check if we have this block
-    if (entry->mesi == MESI_INVALID || entry->tag != tag) {
-        return;  // Don't have it
-    }
-    
-    // We have it
-    if (entry->mesi == MESI_MODIFIED) {
+    if (TSRAM_MESI(*entry) == MESI_MODIFIED) {
         // We have dirty data - need to supply it before invalidating
         sim->bus.snoop_has_modified = true;
         sim->bus.snoop_modified_core = core->core_id;
+    } else {
+        // Clean copy - DSRAM stays intact until the Flush completes
+        snoop_offer_clean(core, sim, *entry);
     }
     
     // Invalidate our copy
-    entry->mesi = MESI_INVALID;
+    TSRAM_SET_MESI(*entry, MESI_INVALID);
+    *entry &= ~TSRAM_FORWARD;
+    if (sim->sharing) sharing_invalidate(sim, block_addr);
+    if (sim->miss_class) miss_class_invalidate(sim, core, block_addr);
+    
+    // Wake an MWAIT watching this block
+    if (core->monitor == MONITOR_ARMED && core->monitor_block == block_addr) {
+        core->monitor = MONITOR_FIRED;
+        core->sleeping = false;
+    }
 }
@@ -0,0 +1,323 @@
+/*
+ * =============================================================================
+ * Functional Mode
+ * =============================================================================
+ * Optional (config.functional, --functional). Runs every core's program at
+ * the ISA level without the pipeline or the bus: each instruction reads
+ * the registers left by the one before it, so no hazards or stalls exist,
+ * and a run is as fast as the host can decode and dispatch. Semantics
+ * follow the pipeline:
+ * - R0 reads 0, R1 reads the instruction's own immediate, writes to both
+ *   are dropped
+ * - a branch takes effect after its delay slot (pc/npc pair), JAL writes
+ *   its own pc + 1 to R15
+ * - the FUNC_HALT_SHADOW instructions behind a HALT still commit, as they
+ *   are already in the pipeline when HALT reaches WB (hazard-free case)
+ * - BAR waits until every running core has arrived; MWAIT ends the core's
+ *   turn, since another core has to write the monitored line anyway
+ *
+ * Memory goes through the same DSRAM/TSRAM as timed runs, with coherence
+ * resolved at once: a miss snoops the other caches, takes the block from a
+ * Modified copy or memory and invalidates (write) or downgrades (read) the
+ * other copies. Hits, misses and the final caches are meaningful; cycles
+ * and stalls are not counted. Cores take turns of FUNC_QUANTUM
+ * instructions, so spin locks and flags make progress.
+ *
+ * Hot blocks are translated to x86-64 (jit.c) on x86-64 Linux hosts; the
+ * interpreter below runs everything else and every other host.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+
+/* =============================================================================
+ * FUNCTIONAL CACHE
+ * =============================================================================
+ */
+
+static int32_t* line_word(Core* core, int index, int offset) {
+    return &core->cache.dsram[(index << BLOCK_OFFSET_BITS) | offset];
+}
+
+// Make addr's block valid in fc's cache, exclusively for a write. Returns
+// false on a miss (the block had to be fetched or upgraded).
+static bool func_access(FuncCore* fc, uint32_t addr, bool write) {
+    Simulator* sim = fc->sim;
+    Core* core = fc->core;
+    int index = cache_get_index(addr);
+    uint32_t tag = cache_get_tag(addr);
+    uint32_t block_addr = cache_get_block_addr(addr);
+    TSRAMEntry* entry = &CACHE_TSRAM(&core->cache, index);
+    bool present = TSRAM_HOLDS(*entry, tag);
+
+    if (present && (!write || TSRAM_MESI(*entry) != MESI_SHARED)) {
+        if (write) TSRAM_SET_MESI(*entry, MESI_MODIFIED);
+        return true;
+    }
+
+    // Snoop: a Modified peer writes back; a write invalidates every copy
+    uint64_t holders = cache_holders(sim, addr) & ~CORE_BIT(core->core_id);
+    bool shared = holders != 0;
+    for (int i = 0; holders; i++, holders >>= 1) {
+        if (!(holders & 1)) continue;
+        Core* peer = &sim->cores[i];
+        cache_writeback_block(peer, sim, index);
+        TSRAM_SET_MESI(CACHE_TSRAM(&peer->cache, index), write ? MESI_INVALID : MESI_SHARED);
+    }
+
+    if (!present) {
+        cache_writeback_block(core, sim, index);    // Modified victim
+        for (int i = 0; i < CACHE_BLOCK_SIZE; i++) {
+            *line_word(core, index, i) = sim->main_memory[block_addr + i];
+        }
+        TSRAM_SET_TAG(*entry, tag);
+    }
+    TSRAM_SET_MESI(*entry, write ? MESI_MODIFIED : (shared ? MESI_SHARED : MESI_EXCLUSIVE));
+    return false;
+}
+
+// The word of addr in fc's cache, after one counted access. A miss also
+// counts the hit of its retry, as MEM does in timed runs.
+static int32_t* func_word(FuncCore* fc, uint32_t addr, bool write) {
+    Core* core = fc->core;
+    addr &= 0x1FFFFF;
+    if (!func_access(fc, addr, write)) {
+        if (write) {
+            core->write_misses++;
+        } else {
+            core->read_misses++;
+        }
+    }
+    if (write) {
+        core->write_hits++;
+    } else {
+        core->read_hits++;
+    }
+    if (fc->sim->stack_dist) stack_dist_access(fc->sim, core->core_id, addr);
+    return line_word(core, cache_get_index(addr), cache_get_offset(addr));
+}
+
+int32_t func_load(FuncCore* fc, uint32_t addr) {
+    return *func_word(fc, addr, false);
+}
+
+void func_store(FuncCore* fc, uint32_t addr, int32_t value) {
+    *func_word(fc, addr, true) = value;
+}
+
+// FAA and CAS are one write access each, like cache_atomic; both return
+// the old word
+int32_t func_faa(FuncCore* fc, uint32_t addr, int32_t add) {
+    int32_t* word = func_word(fc, addr, true);
+    int32_t old = *word;
+    *word = old + add;
+    fc->core->atomic_ops++;
+    return old;
+}
+
+int32_t func_cas(FuncCore* fc, uint32_t addr, int32_t expected, int32_t value) {
+    int32_t* word = func_word(fc, addr, true);
+    int32_t old = *word;
+    if (old == expected) {
+        *word = value;
+    } else {
+        fc->core->cas_fail++;
+    }
+    fc->core->atomic_ops++;
+    return old;
+}
+
+/* =============================================================================
+ * INTERPRETER
+ * =============================================================================
+ */
+
+// Source operand: R0 is 0, R1 the instruction's immediate
+static int32_t reg_read(const FuncCore* fc, const Instruction* inst, int reg) {
+    if (reg == 0) return 0;
+    if (reg == 1) return inst->immediate;
+    return fc->regs[reg];
+}
+
+static void reg_write(FuncCore* fc, int reg, int32_t value) {
+    if (reg >= 2) fc->regs[reg] = value;
+}
+
+// Execute the instruction at fc->pc and advance pc/npc. Returns false if
+// the core's turn ends here (BAR, MWAIT, HALT).
+static bool func_step(FuncCore* fc) {
+    const Instruction* inst = &fc->code[fc->pc];
+    int32_t rs = reg_read(fc, inst, inst->rs);
+    int32_t rt = reg_read(fc, inst, inst->rt);
+    int32_t rd = reg_read(fc, inst, inst->rd);
+    uint32_t next = (fc->npc + 1) & PC_MASK;
+    bool taken = false;
+    bool more = true;
+
+    switch (inst->opcode) {
+        case OP_ADD: reg_write(fc, inst->rd, rs + rt); break;
+        case OP_SUB: reg_write(fc, inst->rd, rs - rt); break;
+        case OP_AND: reg_write(fc, inst->rd, rs & rt); break;
+        case OP_OR:  reg_write(fc, inst->rd, rs | rt); break;
+        case OP_XOR: reg_write(fc, inst->rd, rs ^ rt); break;
+        case OP_MUL: reg_write(fc, inst->rd, rs * rt); break;
+        case OP_SLL: reg_write(fc, inst->rd, (int32_t)((uint32_t)rs << (rt & 0x1F))); break;
+        case OP_SRA: reg_write(fc, inst->rd, rs >> (rt & 0x1F)); break;
+        case OP_SRL: reg_write(fc, inst->rd, (int32_t)((uint32_t)rs >> (rt & 0x1F))); break;
+        case OP_BEQ: taken = (rs == rt); break;
+        case OP_BNE: taken = (rs != rt); break;
+        case OP_BLT: taken = (rs < rt); break;
+        case OP_BGT: taken = (rs > rt); break;
+        case OP_BLE: taken = (rs <= rt); break;
+        case OP_BGE: taken = (rs >= rt); break;
+        case OP_JAL:
+            taken = true;
+            reg_write(fc, 15, (int32_t)((fc->pc + 1) & PC_MASK));
+            break;
+        case OP_LW:  reg_write(fc, inst->rd, func_load(fc, (uint32_t)(rs + rt))); break;
+        case OP_SW:  func_store(fc, (uint32_t)(rs + rt), rd); break;
+        case OP_FAA: reg_write(fc, inst->rd, func_faa(fc, (uint32_t)(rs + rt), rd)); break;
+        case OP_CAS: reg_write(fc, inst->rd, func_cas(fc, (uint32_t)rs, rt, rd)); break;
+        case OP_HALT:
+            if (fc->shadow < 0) {
+                fc->shadow = FUNC_HALT_SHADOW + 1;  // This one is decremented below
+                fc->core->halted = true;
+            }
+            more = false;
+            break;
+        case OP_BAR:
+            if (fc->shadow < 0) {
+                fc->at_barrier = true;
+                fc->core->barrier_waits++;
+            }
+            more = false;
+            break;
+        case OP_MWAIT:
+            more = false;
+            break;
+        default:
+            break;      // Undefined opcodes retire as NOPs, as in the pipeline
+    }
+    if (taken) next = (uint32_t)rd & PC_MASK;
+
+    fc->core->instruction_count++;
+    fc->pc = fc->npc;
+    fc->npc = next;
+    if (fc->shadow > 0 && --fc->shadow == 0) fc->done = true;
+    return more && !fc->done;
+}
+
+/* =============================================================================
+ * RUN LOOP
+ * =============================================================================
+ */
+
+// Release the barrier once every running core has arrived
+static void func_barrier(FuncCore* fcs) {
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (!fcs[i].core->halted && !fcs[i].at_barrier) return;
+    }
+    for (int i = 0; i < NUM_CORES; i++) fcs[i].at_barrier = false;
+}
+
+// One turn of core fc: up to budget instructions, in whole blocks
+static void func_turn(FuncCore* fc, uint64_t budget) {
+    Core* core = fc->core;
+    uint64_t start = core->instruction_count;
+
+    while (core->instruction_count - start < budget) {
+        // Translated blocks start outside delay slots and HALT shadows
+        if (fc->jit && fc->shadow < 0 && fc->npc == ((fc->pc + 1) & PC_MASK)) {
+            int n = jit_run(fc->jit, fc);
+            if (n > 0) {
+                core->instruction_count += n;
+                core->native_instructions += n;
+                continue;
+            }
+        }
+        if (!func_step(fc)) return;
+    }
+}
+
+// Core core_id of sim, from its thread 0 state
+void func_core_init(FuncCore* fc, Simulator* sim, int core_id) {
+    HwThread* th = &sim->cores[core_id].thread[0];
+    memset(fc, 0, sizeof(FuncCore));
+    fc->sim = sim;
+    fc->core = &sim->cores[core_id];
+    memcpy(fc->regs, th->regs, sizeof(fc->regs));
+    for (int pc = 0; pc < IMEM_DEPTH; pc++) fc->code[pc] = decode_instruction(th->imem[pc]);
+    fc->pc = th->pc;
+    fc->npc = (th->pc + 1) & PC_MASK;
+    fc->shadow = -1;
+    fc->jit = sim->config.jit ? jit_create() : NULL;
+}
+
+// Back into thread 0, for the output files
+void func_core_finish(FuncCore* fc) {
+    HwThread* th = &fc->core->thread[0];
+    memcpy(th->regs, fc->regs, sizeof(th->regs));
+    th->regs[0] = 0;
+    th->pc = fc->pc;
+    th->halted = fc->done;
+    jit_destroy(fc->jit);
+    fc->jit = NULL;
+}
+
+// Round-robin turns until every core is done or the instruction limit is
+// hit. The schedule starts at core first, which has already run used
+// instructions of its turn (0 for a fresh run).
+void func_schedule(Simulator* sim, FuncCore* fcs, int first, uint64_t used) {
+    uint64_t limit = sim->config.max_cycles;
+
+    for (;;) {
+        for (int i = first; i < NUM_CORES && !sim->stopped; i++) {
+            FuncCore* fc = &fcs[i];
+            if (fc->done || fc->at_barrier) continue;
+            func_turn(fc, FUNC_QUANTUM - used);
+            used = 0;
+            if (limit && fc->core->instruction_count > limit) sim->stopped = STOP_CYCLE_LIMIT;
+        }
+        first = 0;
+
+        bool running = false;
+        for (int i = 0; i < NUM_CORES; i++) running = running || !fcs[i].done;
+        if (!running || sim->stopped) return;
+        func_barrier(fcs);
+    }
+}
+
+void functional_run(Simulator* sim) {
+    FuncCore* fcs = (FuncCore*)calloc(NUM_CORES, sizeof(FuncCore));
+    if (!fcs) {
+        fprintf(stderr, "Error: Failed to allocate functional cores\n");
+        return;
+    }
+    for (int i = 0; i < NUM_CORES; i++) func_core_init(&fcs[i], sim, i);
+    if (!sim->config.quiet) {
+        printf("Functional run (%s)...\n", fcs[0].jit ? "x86-64 translation" : "interpreter");
+    }
+
+    double start = platform_now();
+    func_schedule(sim, fcs, 0, 0);
+    double seconds = platform_now() - start;
+    if (sim->stopped == STOP_CYCLE_LIMIT) {
+        fprintf(stderr, "Error: Exceeded %llu instructions\n",
+                (unsigned long long)sim->config.max_cycles);
+    }
+
+    uint64_t total = 0, native = 0;
+    for (int i = 0; i < NUM_CORES; i++) {
+        total += fcs[i].core->instruction_count;
+        native += fcs[i].core->native_instructions;
+        func_core_finish(&fcs[i]);
+    }
+    free(fcs);
+
+    if (!sim->config.quiet) {
+        printf("Functional run complete: %llu instructions in %.3f s (%.1f M/s), %.1f%% translated\n",
+               (unsigned long long)total, seconds, seconds > 0 ? (double)total / seconds / 1e6 : 0.0,
+               total ? 100.0 * (double)native / (double)total : 0.0);
+    }
+}
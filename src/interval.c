@@ -0,0 +1,153 @@
+/*
+ * =============================================================================
+ * Interval Statistics and Buffered Output
+ * =============================================================================
+ * Optional (config.interval > 0, --interval=N). Every N cycles one row per
+ * core holds the change of its counters over the interval:
+ *   cycle, core, cycles, instructions, ipc, read_hit, write_hit, read_miss,
+ *   write_miss, decode_stall, mem_stall, bus_util
+ * bus_util is the fraction of the interval the bus was busy (a command or
+ * Flush word on it, or a transaction waiting for memory); it is the same
+ * for every core. A last, shorter interval covers the end of the run.
+ * Rows go to intervals.csv or intervals.jsonl (--interval-format) through
+ * a BufWriter, which collects output in memory and writes it in large
+ * chunks instead of one small fprintf per value.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include <stdarg.h>
+
+/* =============================================================================
+ * BUFFERED WRITER
+ * =============================================================================
+ */
+
+bool bufw_open(BufWriter* w, const char* filename) {
+    w->len = 0;
+    w->fp = fopen(filename, "w");
+    if (!w->fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return false;
+    }
+    return true;
+}
+
+void bufw_flush(BufWriter* w) {
+    if (w->fp && w->len > 0) fwrite(w->buf, 1, w->len, w->fp);
+    w->len = 0;
+}
+
+void bufw_printf(BufWriter* w, const char* fmt, ...) {
+    va_list ap;
+    size_t room = BUFW_SIZE - w->len;
+
+    va_start(ap, fmt);
+    int n = vsnprintf(w->buf + w->len, room, fmt, ap);
+    va_end(ap);
+    if (n < 0) return;
+
+    if ((size_t)n >= room) {
+        // Did not fit: flush and format again into the empty buffer
+        bufw_flush(w);
+        va_start(ap, fmt);
+        n = vsnprintf(w->buf, BUFW_SIZE, fmt, ap);
+        va_end(ap);
+        if (n < 0) return;
+        if ((size_t)n >= BUFW_SIZE) n = BUFW_SIZE - 1;  // Truncated line
+    }
+    w->len += n;
+}
+
+void bufw_close(BufWriter* w) {
+    if (!w->fp) return;
+    bufw_flush(w);
+    fclose(w->fp);
+    w->fp = NULL;
+}
+
+/* =============================================================================
+ * INTERVAL SAMPLING
+ * =============================================================================
+ */
+
+static void snapshot(Core* core, IntervalCounters* c) {
+    c->cycles = core->cycle_count;
+    c->instructions = core->instruction_count;
+    c->read_hits = core->read_hits;
+    c->write_hits = core->write_hits;
+    c->read_misses = core->read_misses;
+    c->write_misses = core->write_misses;
+    c->decode_stall = core->decode_stall_cycles;
+    c->mem_stall = core->mem_stall_cycles;
+}
+
+bool interval_init(Simulator* sim, const char* filename) {
+    IntervalLog* log = (IntervalLog*)calloc(1, sizeof(IntervalLog));
+    if (!log) {
+        fprintf(stderr, "Error: Failed to allocate interval log\n");
+        return false;
+    }
+    if (!bufw_open(&log->out, filename)) {
+        free(log);
+        return false;
+    }
+    if (sim->config.interval_format == INTERVAL_CSV) {
+        bufw_printf(&log->out, "cycle,core,cycles,instructions,ipc,read_hit,write_hit,"
+                               "read_miss,write_miss,decode_stall,mem_stall,bus_util\n");
+    }
+    sim->intervals = log;
+    return true;
+}
+
+// One row per core for the cycles up to end_cycle since the last sample
+static void interval_emit(Simulator* sim, uint64_t end_cycle) {
+    IntervalLog* log = sim->intervals;
+    uint64_t span = end_cycle - log->last_cycle;
+    if (span == 0) return;
+    double bus_util = (double)log->bus_busy / (double)span;
+
+    for (int i = 0; i < NUM_CORES; i++) {
+        IntervalCounters now, *prev = &log->prev[i];
+        snapshot(&sim->cores[i], &now);
+
+        unsigned long long cycles = now.cycles - prev->cycles;
+        unsigned long long insts = now.instructions - prev->instructions;
+        double ipc = cycles ? (double)insts / (double)cycles : 0.0;
+        const char* fmt = (sim->config.interval_format == INTERVAL_CSV) ?
+            "%llu,%d,%llu,%llu,%.4f,%llu,%llu,%llu,%llu,%llu,%llu,%.4f\n" :
+            "{\"cycle\": %llu, \"core\": %d, \"cycles\": %llu, \"instructions\": %llu, "
+            "\"ipc\": %.4f, \"read_hit\": %llu, \"write_hit\": %llu, \"read_miss\": %llu, "
+            "\"write_miss\": %llu, \"decode_stall\": %llu, \"mem_stall\": %llu, "
+            "\"bus_util\": %.4f}\n";
+
+        bufw_printf(&log->out, fmt, (unsigned long long)end_cycle, i, cycles, insts, ipc,
+                    (unsigned long long)(now.read_hits - prev->read_hits),
+                    (unsigned long long)(now.write_hits - prev->write_hits),
+                    (unsigned long long)(now.read_misses - prev->read_misses),
+                    (unsigned long long)(now.write_misses - prev->write_misses),
+                    (unsigned long long)(now.decode_stall - prev->decode_stall),
+                    (unsigned long long)(now.mem_stall - prev->mem_stall), bus_util);
+        *prev = now;
+    }
+    log->last_cycle = end_cycle;
+    log->bus_busy = 0;
+}
+
+// Once per cycle, after the cores; sim->cycle is the cycle just simulated
+void interval_cycle(Simulator* sim) {
+    IntervalLog* log = sim->intervals;
+    Bus* bus = &sim->bus;
+
+    if (bus->state.active || bus->arbiter.transaction_in_progress) log->bus_busy++;
+    if (sim->cycle % sim->config.interval == 0) interval_emit(sim, sim->cycle);
+}
+
+// Emit the partial last interval and close the file
+void interval_finish(Simulator* sim) {
+    if (!sim->intervals) return;
+    interval_emit(sim, sim->cycle - 1);     // sim->cycle is one past the last cycle
+    bufw_close(&sim->intervals->out);
+    free(sim->intervals);
+    sim->intervals = NULL;
+}
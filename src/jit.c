@@ -0,0 +1,311 @@
+/*
+ * =============================================================================
+ * Block Translator for Functional Mode (x86-64 Linux)
+ * =============================================================================
+ * Translates a core's hot basic blocks into x86-64 code in an mmap'd
+ * buffer. A PC is translated once the interpreter has reached it
+ * JIT_HOT_THRESHOLD times with no branch pending; the block runs from
+ * there up to and including the first branch and its delay slot, stops
+ * before a HALT, BAR or MWAIT (left to the interpreter), or ends after
+ * JIT_MAX_BLOCK instructions. A branch whose delay slot is itself a branch
+ * or stop ends the block before it.
+ *
+ * Generated code is a function uint32_t block(FuncCore* fc) returning the
+ * next PC. rbx holds fc, so architectural register r is [rbx + 4r]:
+ * - operands load into eax/ecx/edx; R0 becomes xor, R1 the immediate
+ * - results are stored only for rd >= 2
+ * - a branch compares in place, before its delay slot, and keeps the
+ *   next PC in r12 (callee-saved, so the slot's calls keep it)
+ * - LW, SW, FAA and CAS call func_load/func_store/func_faa/func_cas, so
+ *   memory goes through the functional cache like interpreted accesses
+ *
+ * The translation cache is one entry per start PC. IMEM is never rewritten
+ * during a run, so blocks are never invalidated; a full buffer drops every
+ * block and starts over. If the buffer cannot be switched between writable
+ * and executable, translation stops and the interpreter takes over. Other
+ * hosts build the stubs at the end, and the interpreter runs everything.
+ * =============================================================================
+ */
+
+// MAP_ANONYMOUS under strict C (-std=c11); must come before the first
+// system header
+#ifdef __linux__
+#define _DEFAULT_SOURCE
+#endif
+
+#include "sim.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+
+#include <sys/mman.h>
+
+#define JIT_BLOCK_BYTES     4096            // Upper bound for one block's code
+#define JIT_UNTRANSLATABLE  ((uint8_t*)1)   // Block would be empty
+
+typedef uint32_t (*JitBlockFn)(FuncCore* fc);
+
+typedef struct {
+    uint8_t*    code;       // NULL until translated
+    uint16_t    first;      // PCs first .. first + count - 1 (mod IMEM_DEPTH)
+    uint16_t    count;
+} JitBlock;
+
+struct JitCache {
+    uint8_t*    buf;
+    size_t      used;
+    bool        disabled;   // mprotect failed: run nothing from buf
+    JitBlock    block[IMEM_DEPTH];
+    uint16_t    heat[IMEM_DEPTH];
+};
+
+// x86 register numbers
+enum { X_EAX = 0, X_ECX = 1, X_EDX = 2, X_ESI = 6 };
+
+/* =============================================================================
+ * CODE EMISSION
+ * =============================================================================
+ */
+
+static void emit1(uint8_t** p, uint8_t b) {
+    *(*p)++ = b;
+}
+
+static void emit_bytes(uint8_t** p, const char* bytes, int n) {
+    memcpy(*p, bytes, n);
+    *p += n;
+}
+
+static void emit4(uint8_t** p, uint32_t v) {
+    memcpy(*p, &v, 4);
+    *p += 4;
+}
+
+// x = architectural register reg as read by inst
+static void emit_read(uint8_t** p, int x, const Instruction* inst, int reg) {
+    if (reg == 0) {
+        emit1(p, 0x31);                         // xor x, x
+        emit1(p, (uint8_t)(0xC0 | x << 3 | x));
+    } else if (reg == 1) {
+        emit1(p, (uint8_t)(0xB8 + x));          // mov x, imm32
+        emit4(p, (uint32_t)inst->immediate);
+    } else {
+        emit1(p, 0x8B);                         // mov x, [rbx + 4 * reg]
+        emit1(p, (uint8_t)(0x43 | x << 3));
+        emit1(p, (uint8_t)(4 * reg));
+    }
+}
+
+// Architectural register reg = eax (R0 and R1 are not written)
+static void emit_write(uint8_t** p, int reg) {
+    if (reg < 2) return;
+    emit_bytes(p, "\x89\x43", 2);               // mov [rbx + 4 * reg], eax
+    emit1(p, (uint8_t)(4 * reg));
+}
+
+// call fn(fc, esi, edx, ecx)
+static void emit_call(uint8_t** p, void* fn) {
+    uint64_t addr = (uint64_t)(uintptr_t)fn;
+    emit_bytes(p, "\x48\x89\xDF", 3);           // mov rdi, rbx
+    emit_bytes(p, "\x48\xB8", 2);               // mov rax, imm64
+    memcpy(*p, &addr, 8);
+    *p += 8;
+    emit_bytes(p, "\xFF\xD0", 2);               // call rax
+}
+
+static bool is_branch(uint8_t op) {
+    return op >= OP_BEQ && op <= OP_JAL;
+}
+
+// Left to the interpreter: they end the core's turn
+static bool is_stop(uint8_t op) {
+    return op == OP_HALT || op == OP_BAR || op == OP_MWAIT;
+}
+
+// One non-branch instruction
+static void emit_inst(uint8_t** p, const Instruction* inst) {
+    static const char alu[][3] = {
+        [OP_ADD] = "\x01\xC8",  [OP_SUB] = "\x29\xC8",  [OP_AND] = "\x21\xC8",
+        [OP_OR]  = "\x09\xC8",  [OP_XOR] = "\x31\xC8",  [OP_MUL] = "\x0F\xAF\xC1",
+        [OP_SLL] = "\xD3\xE0",  [OP_SRA] = "\xD3\xF8",  [OP_SRL] = "\xD3\xE8"
+    };
+    uint8_t op = inst->opcode;
+
+    if (op <= OP_SRL) {
+        if (inst->rd < 2) return;               // No effect
+        emit_read(p, X_EAX, inst, inst->rs);
+        emit_read(p, X_ECX, inst, inst->rt);    // Shift count in cl, masked to 5 bits
+        emit_bytes(p, alu[op], op == OP_MUL ? 3 : 2);
+        emit_write(p, inst->rd);
+    } else if (op == OP_LW || op == OP_SW || op == OP_FAA) {
+        emit_read(p, X_EAX, inst, inst->rs);
+        emit_read(p, X_ECX, inst, inst->rt);
+        emit_bytes(p, "\x01\xC8", 2);           // add eax, ecx
+        emit_bytes(p, "\x89\xC6", 2);           // mov esi, eax
+        if (op == OP_LW) {
+            emit_call(p, (void*)func_load);
+        } else {
+            emit_read(p, X_EDX, inst, inst->rd);
+            emit_call(p, op == OP_SW ? (void*)func_store : (void*)func_faa);
+        }
+        if (op != OP_SW) emit_write(p, inst->rd);
+    } else if (op == OP_CAS) {
+        emit_read(p, X_ESI, inst, inst->rs);
+        emit_read(p, X_EDX, inst, inst->rt);
+        emit_read(p, X_ECX, inst, inst->rd);
+        emit_call(p, (void*)func_cas);
+        emit_write(p, inst->rd);
+    }
+    // Anything else retires as a NOP
+}
+
+// Branch at pc: r12d = the PC after its delay slot
+static void emit_branch(uint8_t** p, const Instruction* inst, uint32_t pc) {
+    static const uint8_t cmov[] = {
+        [OP_BEQ] = 0x44, [OP_BNE] = 0x45, [OP_BLT] = 0x4C,
+        [OP_BGT] = 0x4F, [OP_BLE] = 0x4E, [OP_BGE] = 0x4D
+    };
+
+    emit_read(p, X_EDX, inst, inst->rd);
+    emit_bytes(p, "\x81\xE2", 2);               // and edx, PC_MASK
+    emit4(p, PC_MASK);
+    if (inst->opcode == OP_JAL) {
+        emit_bytes(p, "\x41\x89\xD4", 3);       // mov r12d, edx
+        emit_bytes(p, "\xC7\x43\x3C", 3);       // mov [rbx + 4 * 15], pc + 1
+        emit4(p, (pc + 1) & PC_MASK);
+        return;
+    }
+    emit_read(p, X_EAX, inst, inst->rs);
+    emit_read(p, X_ECX, inst, inst->rt);
+    emit_bytes(p, "\x39\xC8", 2);               // cmp eax, ecx
+    emit_bytes(p, "\x41\xBC", 2);               // mov r12d, fall-through
+    emit4(p, (pc + 2) & PC_MASK);
+    emit_bytes(p, "\x44\x0F", 2);               // cmovcc r12d, edx
+    emit1(p, cmov[inst->opcode]);
+    emit1(p, 0xE2);
+}
+
+/* =============================================================================
+ * TRANSLATION CACHE
+ * =============================================================================
+ */
+
+JitCache* jit_create(void) {
+    JitCache* jc = (JitCache*)calloc(1, sizeof(JitCache));
+    if (!jc) return NULL;
+    void* buf = mmap(NULL, JIT_CODE_SIZE, PROT_READ | PROT_EXEC,
+                     MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (buf == MAP_FAILED) {
+        free(jc);
+        return NULL;
+    }
+    jc->buf = (uint8_t*)buf;
+    return jc;
+}
+
+void jit_destroy(JitCache* jc) {
+    if (!jc) return;
+    munmap(jc->buf, JIT_CODE_SIZE);
+    free(jc);
+}
+
+// Switch the code buffer between writable and executable. On failure the
+// translator is disabled for the rest of the run.
+static bool jit_protect(JitCache* jc, int prot) {
+    if (mprotect(jc->buf, JIT_CODE_SIZE, prot) == 0) return true;
+    fprintf(stderr, "Warning: Cannot change code buffer protection, "
+                    "interpreting from here on\n");
+    jc->disabled = true;
+    return false;
+}
+
+static void jit_translate(JitCache* jc, FuncCore* fc, uint32_t first) {
+    JitBlock* b = &jc->block[first];
+
+    if (JIT_CODE_SIZE - jc->used < JIT_BLOCK_BYTES) {
+        // Full: start over; hot PCs are translated again on their next entry
+        for (int pc = 0; pc < IMEM_DEPTH; pc++) {
+            if (jc->block[pc].code != JIT_UNTRANSLATABLE) jc->block[pc].code = NULL;
+        }
+        jc->used = 0;
+    }
+    if (!jit_protect(jc, PROT_READ | PROT_WRITE)) return;
+
+    uint8_t* start = jc->buf + jc->used;
+    uint8_t* p = start;
+    emit_bytes(&p, "\x53\x41\x54", 3);          // push rbx; push r12
+    emit_bytes(&p, "\x48\x83\xEC\x08", 4);      // sub rsp, 8 (16-byte aligned calls)
+    emit_bytes(&p, "\x48\x89\xFB", 3);          // mov rbx, rdi
+
+    int count = 0;
+    bool branched = false;
+    uint32_t pc = first;
+    while (count < JIT_MAX_BLOCK) {
+        const Instruction* inst = &fc->code[pc];
+        if (is_stop(inst->opcode)) break;
+        if (is_branch(inst->opcode)) {
+            const Instruction* slot = &fc->code[(pc + 1) & PC_MASK];
+            if (is_branch(slot->opcode) || is_stop(slot->opcode)) break;
+            emit_branch(&p, inst, pc);
+            emit_inst(&p, slot);
+            count += 2;
+            branched = true;
+            break;
+        }
+        emit_inst(&p, inst);
+        count++;
+        pc = (pc + 1) & PC_MASK;
+    }
+
+    if (count == 0) {
+        b->code = JIT_UNTRANSLATABLE;
+    } else {
+        if (branched) {
+            emit_bytes(&p, "\x44\x89\xE0", 3);  // mov eax, r12d
+        } else {
+            emit1(&p, 0xB8);                    // mov eax, next pc
+            emit4(&p, (first + count) & PC_MASK);
+        }
+        emit_bytes(&p, "\x48\x83\xC4\x08", 4);  // add rsp, 8
+        emit_bytes(&p, "\x41\x5C\x5B\xC3", 4);  // pop r12; pop rbx; ret
+        b->code = start;
+        b->first = (uint16_t)first;
+        b->count = (uint16_t)count;
+        jc->used = ((size_t)(p - jc->buf) + 15) & ~(size_t)15;
+        fc->core->native_blocks++;
+    }
+    jit_protect(jc, PROT_READ | PROT_EXEC);
+}
+
+// Run the block at fc->pc if it is translated (or just became hot).
+// Returns the instructions executed, 0 if the interpreter has to step.
+int jit_run(JitCache* jc, FuncCore* fc) {
+    JitBlock* b = &jc->block[fc->pc];
+
+    if (jc->disabled) return 0;
+    if (!b->code) {
+        if (++jc->heat[fc->pc] < JIT_HOT_THRESHOLD) return 0;
+        jit_translate(jc, fc, fc->pc);
+        if (jc->disabled) return 0;
+    }
+    if (b->code == JIT_UNTRANSLATABLE) return 0;
+
+    uint32_t next = ((JitBlockFn)(void*)b->code)(fc);
+    fc->pc = next;
+    fc->npc = (next + 1) & PC_MASK;
+    return b->count;
+}
+
+#else   // No translator on this host: functional mode interprets
+
+JitCache* jit_create(void) {
+    return NULL;
+}
+
+void jit_destroy(JitCache* jc) {
+}
+
+int jit_run(JitCache* jc, FuncCore* fc) {
+    return 0;
+}
+
+#endif
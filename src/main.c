@@ -7,57 +7,113 @@
  */
 
 #include "sim.h"
-
-// Global simulator
-static Simulator g_sim;
+#include "platform.h"
 
 /* =============================================================================
  * INITIALIZATION
  * =============================================================================
  */
 
-void sim_init(Simulator* sim) {
+void config_init(SimConfig* config) {
+    memset(config, 0, sizeof(SimConfig));
+    
+    // Cache-to-cache transfer of clean lines disabled (spec behaviour)
+    config->c2c_clean = false;
+    config->c2c_latency = C2C_DEFAULT_LATENCY;
+    config->mem_delay = MEM_RESPONSE_DELAY;
+    config->c2c_responder = C2C_RESPONDER_LOWEST_ID;
+    
+    // Dirty victims written back instantly (spec behaviour)
+    config->wb_buffer = false;
+    config->wb_depth = WB_DEFAULT_DEPTH;
+    config->wb_drain = WB_DRAIN_EAGER;
+    config->wb_drain_threshold = WB_DEFAULT_DEPTH;
+    
+    // No forwarding: every RAW stalls in decode (spec behaviour)
+    config->forwarding = false;
+    config->stall_causes = false;
+    
+    // Single-issue pipeline (spec behaviour)
+    config->issue_width = 1;
+    
+    // One hardware thread per core (spec behaviour)
+    config->hw_threads = 1;
+    config->mt_policy = MT_SWITCH_ON_STALL;
+    
+    // --functional translates hot blocks where the host supports it
+    config->functional = false;
+    config->jit = true;
+    
+    config->interval_format = INTERVAL_CSV;
+    config->max_cycles = DEFAULT_MAX_CYCLES;
+}
+
+// Returns false if memory cannot be allocated (sim_cleanup still safe)
+bool sim_init(Simulator* sim) {
     memset(sim, 0, sizeof(Simulator));
+    config_init(&sim->config);
     
     // Allocate main memory (2^21 words)
     sim->main_memory = (int32_t*)calloc(MAIN_MEM_SIZE, sizeof(int32_t));
     if (!sim->main_memory) {
         fprintf(stderr, "Error: Failed to allocate main memory\n");
-        exit(1);
+        return false;
+    }
+    
+    // Hot core state in one aligned block, IMEM and DSRAM in another
+    sim->cores = (Core*)platform_aligned_calloc(NUM_CORES * sizeof(Core), HOST_CACHE_LINE);
+    sim->core_mem = (CoreMemory*)platform_aligned_calloc(NUM_CORES * sizeof(CoreMemory), HOST_CACHE_LINE);
+    sim->tsram = (TSRAMEntry*)platform_aligned_calloc(CACHE_NUM_BLOCKS * TSRAM_ROW * sizeof(TSRAMEntry),
+                                                      HOST_CACHE_LINE);
+    if (!sim->cores || !sim->core_mem || !sim->tsram) {
+        fprintf(stderr, "Error: Failed to allocate core state\n");
+        return false;
     }
     
     // Init cores
     for (int i = 0; i < NUM_CORES; i++) {
-        core_init(&sim->cores[i], i);
+        core_init(&sim->cores[i], i, &sim->core_mem[i], &sim->tsram[i]);
     }
     
     // Init bus
     bus_init(&sim->bus);
     
     sim->cycle = 0;
+    return true;
 }
 
-void core_init(Core* core, int id) {
+void core_init(Core* core, int id, CoreMemory* mem, TSRAMEntry* tsram) {
     memset(core, 0, sizeof(Core));
+    memset(mem, 0, sizeof(CoreMemory));
     core->core_id = id;
-    core->pc = 0;
     
-    // All registers start at 0
-    for (int i = 0; i < NUM_REGISTERS; i++) {
-        core->regs[i] = 0;
+    // All threads: PC 0, registers 0, IMEM zeroed. Only thread 0 runs
+    // unless an image is loaded for another one.
+    for (int t = 0; t < MAX_HW_THREADS; t++) {
+        HwThread* th = &core->thread[t];
+        th->pc = 0;
+        for (int i = 0; i < NUM_REGISTERS; i++) {
+            th->regs[i] = 0;
+        }
+        th->imem = mem->imem[t];
+        th->halted = (t != 0);
     }
+    core->fetch_thread = 0;
+    core->miss_thread = -1;
     
-    // IMEM zeroed
-    memset(core->imem, 0, sizeof(core->imem));
-    
-    // Pipeline latches invalid
-    core->IF_ID.valid = false;
-    core->ID_EX.valid = false;
-    core->EX_MEM.valid = false;
-    core->MEM_WB.valid = false;
-    core->WB_completed.valid = false;
+    // Pipeline latches invalid, both buffers
+    for (int s = 0; s < LATCH_SLOTS; s++) {
+        for (int b = 0; b < 2; b++) {
+            core->latch[s][b].valid = false;
+            core->latch2[s][b].valid = false;
+        }
+    }
+    core->latch_live = 0;
+    core->latch_live2 = 0;
     
     // Cache init
+    core->cache.dsram = mem->dsram;
+    core->cache.tsram = tsram;
     cache_init(&core->cache);
     
     // Control flags
@@ -77,23 +133,46 @@ void core_init(Core* core, int id) {
     core->write_misses = 0;
     core->decode_stall_cycles = 0;
     core->mem_stall_cycles = 0;
+    core->c2c_fills = 0;
+    core->c2c_supplies = 0;
+    core->wb_queued = 0;
+    core->wb_drained = 0;
+    core->wb_snoop_hits = 0;
+    core->wb_full_stalls = 0;
+    core->stall_raw_cycles = 0;
+    core->stall_load_use_cycles = 0;
+    core->stall_branch_cycles = 0;
+    core->issue_dual_cycles = 0;
+    core->issue_single_cycles = 0;
+    core->pair_break_dep = 0;
+    core->pair_break_struct = 0;
+    core->atomic_ops = 0;
+    core->cas_fail = 0;
+    core->sleeping = false;
+    core->bar_waiting = false;
+    core->monitor = MONITOR_IDLE;
+    core->barrier_waits = 0;
+    core->mwait_sleeps = 0;
+    core->sleep_cycles = 0;
 }
 
 void cache_init(Cache* cache) {
     // DSRAM and TSRAM both zero at init
-    memset(cache->dsram, 0, sizeof(cache->dsram));
+    memset(cache->dsram, 0, CACHE_SIZE * sizeof(int32_t));
     for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
-        cache->tsram[i].tag = 0;
-        cache->tsram[i].mesi = MESI_INVALID;
+        CACHE_TSRAM(cache, i) = 0;      // Tag 0, Invalid
     }
 }
 
 void bus_init(Bus* bus) {
     memset(bus, 0, sizeof(Bus));
     bus->arbiter.last_granted = NUM_CORES - 1;  // Core 0 has highest priority first
+    bus->arbiter.last_drained = NUM_CORES - 1;
     bus->arbiter.transaction_in_progress = false;
     bus->mem_response.valid = false;
     bus->snoop_modified_core = -1;
+    bus->snoop_clean_core = -1;
+    bus->snoop_buffer_core = -1;
 }
 
 void sim_cleanup(Simulator* sim) {
@@ -102,9 +181,23 @@ void sim_cleanup(Simulator* sim) {
         sim->main_memory = NULL;
     }
     for (int i = 0; i < NUM_CORES; i++) {
-        if (sim->core_trace[i]) fclose(sim->core_trace[i]);
+        output_close(&sim->core_trace[i]);
     }
-    if (sim->bus_trace) fclose(sim->bus_trace);
+    output_close(&sim->bus_trace);
+    verify_free(sim);
+    profile_free(sim);
+    sharing_free(sim);
+    bus_stats_free(sim);
+    miss_class_free(sim);
+    stack_dist_free(sim);
+    interval_finish(sim);
+    mem_trace_finish(sim);
+    platform_aligned_free(sim->cores);
+    platform_aligned_free(sim->core_mem);
+    platform_aligned_free(sim->tsram);
+    sim->cores = NULL;
+    sim->core_mem = NULL;
+    sim->tsram = NULL;
 }
 
 /* =============================================================================
@@ -135,7 +228,9 @@ Instruction decode_instruction(uint32_t raw) {
  * =============================================================================
  */
 
-bool load_imem(Core* core, const char* filename) {
+// Load the IMEM image of hardware thread tid (a loaded thread > 0 becomes runnable)
+bool load_imem(Core* core, int tid, const char* filename) {
+    HwThread* th = &core->thread[tid];
     FILE* fp = fopen(filename, "r");
     if (!fp) {
         fprintf(stderr, "Warning: Cannot open IMEM file %s\n", filename);
@@ -152,10 +247,11 @@ bool load_imem(Core* core, const char* filename) {
         
         uint32_t inst;
         if (sscanf(p, "%x", &inst) == 1) {
-            core->imem[addr++] = inst;
+            th->imem[addr++] = inst;
         }
     }
     fclose(fp);
+    th->halted = false;
     return true;
 }
 
@@ -184,11 +280,8 @@ bool load_memin(Simulator* sim, const char* filename) {
 }
 
 void write_memout(Simulator* sim, const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot create %s\n", filename);
-        return;
-    }
+    OutputFile out;
+    if (!output_open(sim, &out, filename, OUT_MEMOUT, 0)) return;
     
     // Find last non-zero address
     int last_addr = 0;
@@ -198,74 +291,119 @@ void write_memout(Simulator* sim, const char* filename) {
     
     // Write from 0 to last non-zero (inclusive)
     for (int i = 0; i <= last_addr; i++) {
-        fprintf(fp, "%08X\n", (uint32_t)sim->main_memory[i]);
+        output_printf(&out, "%08X\n", (uint32_t)sim->main_memory[i]);
     }
-    fclose(fp);
+    output_close(&out);
 }
 
-void write_regout(Core* core, const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot create %s\n", filename);
-        return;
-    }
+void write_regout(Simulator* sim, Core* core, int tid, const char* filename) {
+    OutputFile out;
+    if (!output_open(sim, &out, filename, OUT_REGOUT, core->core_id)) return;
     
     // Print R2..R15 only (NOT R0 or R1!)
     for (int i = 2; i < NUM_REGISTERS; i++) {
-        fprintf(fp, "%08X\n", (uint32_t)core->regs[i]);
+        output_printf(&out, "%08X\n", (uint32_t)core->thread[tid].regs[i]);
     }
-    fclose(fp);
+    output_close(&out);
 }
 
-void write_dsram(Core* core, const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot create %s\n", filename);
-        return;
-    }
+void write_dsram(Simulator* sim, Core* core, const char* filename) {
+    OutputFile out;
+    if (!output_open(sim, &out, filename, OUT_DSRAM, core->core_id)) return;
     
     // 512 words, 8 hex digits each
     for (int i = 0; i < CACHE_SIZE; i++) {
-        fprintf(fp, "%08X\n", (uint32_t)core->cache.dsram[i]);
+        output_printf(&out, "%08X\n", (uint32_t)core->cache.dsram[i]);
     }
-    fclose(fp);
+    output_close(&out);
 }
 
-void write_tsram(Core* core, const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot create %s\n", filename);
-        return;
-    }
+void write_tsram(Simulator* sim, Core* core, const char* filename) {
+    OutputFile out;
+    if (!output_open(sim, &out, filename, OUT_TSRAM, core->core_id)) return;
     
     // 64 entries
     // TSRAM entry format: tag(12 bits) in upper bits, MESI(2 bits) in lower bits
     // Per spec, output as 8 hex digits for consistency
     for (int i = 0; i < CACHE_NUM_BLOCKS; i++) {
-        uint32_t entry = ((core->cache.tsram[i].tag & 0xFFF) << 2) | 
-                         (core->cache.tsram[i].mesi & 0x3);
-        fprintf(fp, "%08X\n", entry);
+        uint32_t entry = CACHE_TSRAM(&core->cache, i) & TSRAM_DUMP_MASK;
+        output_printf(&out, "%08X\n", entry);
     }
-    fclose(fp);
+    output_close(&out);
 }
 
-void write_stats(Core* core, const char* filename) {
-    FILE* fp = fopen(filename, "w");
-    if (!fp) {
-        fprintf(stderr, "Error: Cannot create %s\n", filename);
-        return;
-    }
+// One "name value" line; counters are 64-bit
+static void stat_line(OutputFile* out, const char* name, uint64_t value) {
+    output_printf(out, "%s %llu\n", name, (unsigned long long)value);
+}
+
+void write_stats(Simulator* sim, Core* core, const char* filename) {
+    OutputFile out;
+    if (!output_open(sim, &out, filename, OUT_STATS, core->core_id)) return;
     
     // Exact format from spec (decimal values)
-    fprintf(fp, "cycles %u\n", core->cycle_count);
-    fprintf(fp, "instructions %u\n", core->instruction_count);
-    fprintf(fp, "read_hit %u\n", core->read_hits);
-    fprintf(fp, "write_hit %u\n", core->write_hits);
-    fprintf(fp, "read_miss %u\n", core->read_misses);
-    fprintf(fp, "write_miss %u\n", core->write_misses);
-    fprintf(fp, "decode_stall %u\n", core->decode_stall_cycles);
-    fprintf(fp, "mem_stall %u\n", core->mem_stall_cycles);
-    fclose(fp);
+    stat_line(&out, "cycles", core->cycle_count);
+    stat_line(&out, "instructions", core->instruction_count);
+    stat_line(&out, "read_hit", core->read_hits);
+    stat_line(&out, "write_hit", core->write_hits);
+    stat_line(&out, "read_miss", core->read_misses);
+    stat_line(&out, "write_miss", core->write_misses);
+    stat_line(&out, "decode_stall", core->decode_stall_cycles);
+    stat_line(&out, "mem_stall", core->mem_stall_cycles);
+    
+    // Extension counters follow the spec lines, only when enabled
+    if (sim->config.c2c_clean) {
+        stat_line(&out, "c2c_fill", core->c2c_fills);
+        stat_line(&out, "c2c_supply", core->c2c_supplies);
+    }
+    if (sim->config.wb_buffer) {
+        stat_line(&out, "wb_queued", core->wb_queued);
+        stat_line(&out, "wb_drained", core->wb_drained);
+        stat_line(&out, "wb_snoop_hit", core->wb_snoop_hits);
+        stat_line(&out, "wb_full_stall", core->wb_full_stalls);
+    }
+    if (sim->config.forwarding || sim->config.stall_causes) {
+        stat_line(&out, "stall_raw", core->stall_raw_cycles);
+        stat_line(&out, "stall_load_use", core->stall_load_use_cycles);
+        stat_line(&out, "stall_branch", core->stall_branch_cycles);
+    }
+    if (sim->config.issue_width == 2) {
+        stat_line(&out, "issue_dual", core->issue_dual_cycles);
+        stat_line(&out, "issue_single", core->issue_single_cycles);
+        stat_line(&out, "pair_break_dep", core->pair_break_dep);
+        stat_line(&out, "pair_break_struct", core->pair_break_struct);
+        output_printf(&out, "ipc %.4f\n", core->cycle_count ? 
+                (double)core->instruction_count / core->cycle_count : 0.0);
+    }
+    if (core->atomic_ops > 0) {
+        stat_line(&out, "atomic", core->atomic_ops);
+        stat_line(&out, "cas_fail", core->cas_fail);
+    }
+    if (core->barrier_waits + core->mwait_sleeps > 0) {
+        stat_line(&out, "barrier", core->barrier_waits);
+        stat_line(&out, "mwait_sleep", core->mwait_sleeps);
+        stat_line(&out, "sleep_cycles", core->sleep_cycles);
+    }
+    if (sim->config.hw_threads > 1) {
+        for (int t = 0; t < sim->config.hw_threads; t++) {
+            HwThread* th = &core->thread[t];
+            char name[32];
+            snprintf(name, sizeof(name), "t%d_instructions", t);
+            stat_line(&out, name, th->instruction_count);
+            snprintf(name, sizeof(name), "t%d_decode_stall", t);
+            stat_line(&out, name, th->decode_stall_cycles);
+            snprintf(name, sizeof(name), "t%d_park", t);
+            stat_line(&out, name, th->parks);
+            snprintf(name, sizeof(name), "t%d_park_cycles", t);
+            stat_line(&out, name, th->park_cycles);
+        }
+    }
+    if (sim->config.functional) {
+        stat_line(&out, "native_instructions", core->native_instructions);
+        stat_line(&out, "native_blocks", core->native_blocks);
+    }
+    if (sim->miss_class) miss_class_write_stats(sim, core, &out);
+    output_close(&out);
 }
 
 /* =============================================================================
@@ -281,62 +419,76 @@ void write_stats(Core* core, const char* filename) {
  * - EXEC:   PC of instruction in EX_MEM latch
  * - MEM:    PC of instruction in MEM_WB latch
  * - WB:     PC of instruction that completed WB in PREVIOUS cycle
+ *           (the spare MEM_WB buffer, WB_DONE_LATCH)
  */
 
+// One stage column: "PPP" / "---", or "PPP/PPP" for both lanes in dual-issue.
+// Returns the characters added to buf.
+static int trace_stage(char* buf, PipelineLatch* lane0, PipelineLatch* lane1, bool dual) {
+    int n;
+    if (lane0->valid)
+        n = sprintf(buf, "%03X", lane0->pc & PC_MASK);
+    else
+        n = sprintf(buf, "---");
+    
+    if (dual) {
+        if (lane1->valid)
+            n += sprintf(buf + n, "/%03X", lane1->pc & PC_MASK);
+        else
+            n += sprintf(buf + n, "/---");
+    }
+    buf[n++] = ' ';
+    return n;
+}
+
 void trace_core(Simulator* sim, int core_id) {
     Core* core = &sim->cores[core_id];
-    FILE* fp = sim->core_trace[core_id];
-    if (!fp) return;
+    OutputFile* out = &sim->core_trace[core_id];
+    if (!out->fp && !out->check) return;
+    
+    bool dual = (sim->config.issue_width == 2);
+    PipelineLatch* wb_done = WB_DONE_LATCH(core);
+    PipelineLatch* wb_done2 = WB_DONE_LATCH2(core);
     
     // Only print if at least one stage is active
-    bool any_active = core->IF_ID.valid || core->ID_EX.valid || 
-                      core->EX_MEM.valid || core->MEM_WB.valid ||
-                      core->WB_completed.valid;
+    bool any_active = CUR_LATCH(core, IF_ID)->valid || CUR_LATCH(core, ID_EX)->valid ||
+                      CUR_LATCH(core, EX_MEM)->valid || CUR_LATCH(core, MEM_WB)->valid ||
+                      wb_done->valid ||
+                      CUR_LATCH2(core, IF_ID)->valid || CUR_LATCH2(core, ID_EX)->valid ||
+                      CUR_LATCH2(core, EX_MEM)->valid || CUR_LATCH2(core, MEM_WB)->valid ||
+                      wb_done2->valid;
     if (!any_active) return;
     
-    fprintf(fp, "%llu ", (unsigned long long)sim->cycle);
+    // The whole line is built first, then written or verified at once
+    char line[256];
+    int n = sprintf(line, "%llu ", (unsigned long long)sim->cycle);
     
     // FETCH: instruction in IF_ID
-    if (core->IF_ID.valid)
-        fprintf(fp, "%03X ", core->IF_ID.pc & PC_MASK);
-    else
-        fprintf(fp, "--- ");
+    n += trace_stage(line + n, CUR_LATCH(core, IF_ID), CUR_LATCH2(core, IF_ID), dual);
     
     // DECODE: instruction in ID_EX
-    if (core->ID_EX.valid)
-        fprintf(fp, "%03X ", core->ID_EX.pc & PC_MASK);
-    else
-        fprintf(fp, "--- ");
+    n += trace_stage(line + n, CUR_LATCH(core, ID_EX), CUR_LATCH2(core, ID_EX), dual);
     
     // EXEC: instruction in EX_MEM
-    if (core->EX_MEM.valid)
-        fprintf(fp, "%03X ", core->EX_MEM.pc & PC_MASK);
-    else
-        fprintf(fp, "--- ");
+    n += trace_stage(line + n, CUR_LATCH(core, EX_MEM), CUR_LATCH2(core, EX_MEM), dual);
     
     // MEM: instruction in MEM_WB
-    if (core->MEM_WB.valid)
-        fprintf(fp, "%03X ", core->MEM_WB.pc & PC_MASK);
-    else
-        fprintf(fp, "--- ");
+    n += trace_stage(line + n, CUR_LATCH(core, MEM_WB), CUR_LATCH2(core, MEM_WB), dual);
     
-    // WB: instruction that completed WB (tracked from previous cycle)
-    if (core->WB_completed.valid)
-        fprintf(fp, "%03X ", core->WB_completed.pc & PC_MASK);
-    else
-        fprintf(fp, "--- ");
+    // WB: instruction that completed WB in the previous cycle
+    n += trace_stage(line + n, wb_done, wb_done2, dual);
     
-    // Print R2..R15 (8 hex digits each)
+    // Print R2..R15 (8 hex digits each), thread 0
     for (int i = 2; i < NUM_REGISTERS; i++) {
-        fprintf(fp, "%08X", (uint32_t)core->regs[i]);
-        if (i < NUM_REGISTERS - 1) fprintf(fp, " ");
+        n += sprintf(line + n, (i < NUM_REGISTERS - 1) ? "%08X " : "%08X\n",
+                     (uint32_t)core->thread[0].regs[i]);
     }
-    fprintf(fp, "\n");
+    output_line(out, line);
 }
 
 void trace_bus(Simulator* sim) {
-    FILE* fp = sim->bus_trace;
-    if (!fp) return;
+    OutputFile* out = &sim->bus_trace;
+    if (!out->fp && !out->check) return;
     
     Bus* bus = &sim->bus;
     
@@ -344,13 +496,13 @@ void trace_bus(Simulator* sim) {
     if (bus->state.cmd == BUS_CMD_NONE) return;
     
     // Format: CYCLE bus_origid bus_cmd bus_addr bus_data bus_shared
-    fprintf(fp, "%llu %X %X %06X %08X %X\n",
-            (unsigned long long)sim->cycle,
-            bus->state.origid,
-            bus->state.cmd,
-            bus->state.addr & 0x1FFFFF,  // 21 bits
-            (uint32_t)bus->state.data,
-            bus->state.shared ? 1 : 0);
+    output_printf(out, "%llu %X %X %06X %08X %X\n",
+                  (unsigned long long)sim->cycle,
+                  bus->state.origid,
+                  bus->state.cmd,
+                  bus->state.addr & 0x1FFFFF,  // 21 bits
+                  (uint32_t)bus->state.data,
+                  bus->state.shared ? 1 : 0);
 }
 
 /* =============================================================================
@@ -359,8 +511,10 @@ void trace_bus(Simulator* sim) {
  */
 
 bool pipeline_active(Core* core) {
-    return core->IF_ID.valid || core->ID_EX.valid || 
-           core->EX_MEM.valid || core->MEM_WB.valid ||
+    return CUR_LATCH(core, IF_ID)->valid || CUR_LATCH(core, ID_EX)->valid ||
+           CUR_LATCH(core, EX_MEM)->valid || CUR_LATCH(core, MEM_WB)->valid ||
+           CUR_LATCH2(core, IF_ID)->valid || CUR_LATCH2(core, ID_EX)->valid ||
+           CUR_LATCH2(core, EX_MEM)->valid || CUR_LATCH2(core, MEM_WB)->valid ||
            core->waiting_for_bus;  // Also active if waiting for bus
 }
 
@@ -379,151 +533,757 @@ bool all_cores_done(Simulator* sim) {
     return true;
 }
 
-void run_simulation(Simulator* sim) {
-    printf("Starting simulation...\n");
-    
-    // Bootstrap: Pre-fetch first instruction for each core
-    // This ensures cycle 1 has the first instruction in IF_ID
+// Every unfinished core sleeps and nothing on the bus can still wake one
+static bool all_cores_asleep(Simulator* sim) {
+    bool any_sleeping = false;
     for (int i = 0; i < NUM_CORES; i++) {
         Core* core = &sim->cores[i];
-        if (core->pc < IMEM_DEPTH) {
-            core->IF_ID.valid = true;
-            core->IF_ID.pc = core->pc;
-            core->IF_ID.inst = decode_instruction(core->imem[core->pc]);
-            core->pc = (core->pc + 1) & PC_MASK;
+        if (core->sleeping) {
+            any_sleeping = true;
+        } else if (!core->halted || pipeline_active(core)) {
+            return false;
+        }
+        if (core->bus_request_pending) return false;
+    }
+    return any_sleeping && !sim->bus.arbiter.transaction_in_progress;
+}
+
+// Add the host time since `since` to *acc; returns now
+static double lap(double* acc, double since) {
+    double now = platform_now();
+    *acc += now - since;
+    return now;
+}
+
+// Bootstrap: pre-fetch the first instruction of each core (thread 0), so
+// cycle 1 has it in IF_ID
+void sim_start(Simulator* sim) {
+    for (int i = 0; i < NUM_CORES; i++) {
+        Core* core = &sim->cores[i];
+        HwThread* th = &core->thread[0];
+        PipelineLatch* if_id = CUR_LATCH(core, IF_ID);
+        if (th->pc < IMEM_DEPTH) {
+            if_id->valid = true;
+            if_id->pc = th->pc;
+            if_id->tid = 0;
+            if_id->inst = decode_instruction(th->imem[th->pc]);
+            th->pc = (th->pc + 1) & PC_MASK;
+            if_id->next_pc = th->pc;
         }
     }
     
     sim->cycle = 1;  // Start at cycle 1 per trace format
+}
+
+// One clock cycle. Returns false, without simulating, once the run is over:
+// every core done, or stopped (deadlock, cycle limit, --verify mismatch).
+bool sim_step(Simulator* sim) {
+    RunTiming* timing = sim->timing;    // Host time split, NULL if not measured
+    double t = 0;
     
-    while (!all_cores_done(sim)) {
-        // 1. Update per-core cycle counts FIRST (before trace and execution)
-        //    Count this cycle for any core that is active (will be traced)
-        for (int i = 0; i < NUM_CORES; i++) {
-            Core* core = &sim->cores[i];
-            if (!core->halted || pipeline_active(core)) {
-                core->cycle_count++;
-            }
-        }
-        
-        // 2. Trace at beginning of cycle (shows pre-state)
-        for (int i = 0; i < NUM_CORES; i++) {
-            trace_core(sim, i);
-        }
-        
-        // 3. Bus cycle (arbitration, snoop, memory response)
-        bus_cycle(sim);
-        
-        // 4. Trace bus
-        trace_bus(sim);
-        
-        // 5. Execute all cores
-        for (int i = 0; i < NUM_CORES; i++) {
-            core_cycle(&sim->cores[i], sim);
+    if (sim->stopped || all_cores_done(sim)) return false;
+    if (timing) t = platform_now();
+    
+    // 1. Update per-core cycle counts FIRST (before trace and execution)
+    //    Count this cycle for any core that is active (will be traced)
+    for (int i = 0; i < NUM_CORES; i++) {
+        Core* core = &sim->cores[i];
+        if (core->sleeping) {
+            core->sleep_cycles++;       // Out of the active set
+        } else if (!core->halted || pipeline_active(core)) {
+            core->cycle_count++;
         }
-        
-        // 6. Increment global cycle
+    }
+    
+    // 2. Trace at beginning of cycle (shows pre-state)
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (!sim->cores[i].sleeping) trace_core(sim, i);
+    }
+    if (timing) t = lap(&timing->trace_s, t);
+    
+    // 3. Bus cycle (arbitration, snoop, memory response)
+    bus_cycle(sim);
+    if (sim->bus_stats) bus_stats_cycle(sim);
+    if (timing) t = lap(&timing->bus_s, t);
+    
+    // 4. Trace bus
+    trace_bus(sim);
+    if (timing) t = lap(&timing->trace_s, t);
+    
+    // 5. Execute all cores (sleeping ones wait for BAR/MWAIT wake-up)
+    for (int i = 0; i < NUM_CORES; i++) {
+        if (!sim->cores[i].sleeping) core_cycle(&sim->cores[i], sim);
+    }
+    barrier_update(sim);    // Cores that halted no longer count
+    if (sim->intervals) interval_cycle(sim);
+    if (timing) lap(&timing->core_s, t);
+    
+    if (all_cores_asleep(sim)) {
+        fprintf(stderr, "Error: All cores asleep at cycle %llu (BAR/MWAIT never released)\n",
+                (unsigned long long)sim->cycle);
         sim->cycle++;
-        
-        // Safety limit
-        if (sim->cycle > 1000000) {
-            fprintf(stderr, "Error: Exceeded 1M cycles\n");
-            break;
-        }
+        sim->stopped = STOP_DEADLOCK;
+        return false;
     }
     
-    printf("Simulation complete. Total cycles: %llu\n", (unsigned long long)(sim->cycle - 1));
+    // 6. Increment global cycle
+    sim->cycle++;
+    
+    // Verification stops at the first divergent line
+    if (sim->verify && sim->verify->failed) {
+        sim->stopped = STOP_VERIFY;
+        return false;
+    }
+    
+    // Safety limit
+    if (sim->config.max_cycles && sim->cycle > sim->config.max_cycles) {
+        fprintf(stderr, "Error: Exceeded %llu cycles\n",
+                (unsigned long long)sim->config.max_cycles);
+        sim->stopped = STOP_CYCLE_LIMIT;
+        return false;
+    }
+    return true;
+}
+
+void run_simulation(Simulator* sim) {
+    if (!sim->config.quiet) printf("Starting simulation...\n");
+    
+    sim_start(sim);
+    while (sim_step(sim)) {
+    }
+    
+    if (!sim->config.quiet) {
+        printf("Simulation complete. Total cycles: %llu\n", (unsigned long long)(sim->cycle - 1));
+    }
 }
 
 /* =============================================================================
  * COMMAND LINE PARSING AND MAIN
  * =============================================================================
+ * 
+ * sim.exe [options] [27 file arguments]
+ * Options start with "--" and may appear anywhere; everything else is a
+ * positional file name.
  */
 
-int main(int argc, char* argv[]) {
-    printf("Multi-Core MESI Simulator\n");
-    printf("=========================\n\n");
+// Returns the text after "prefix" if arg starts with it, NULL otherwise
+const char* option_value(const char* arg, const char* prefix) {
+    size_t len = strlen(prefix);
+    return (strncmp(arg, prefix, len) == 0) ? arg + len : NULL;
+}
+
+// Whole decimal value ("12"; not "", "abc" or "12x"), clamped to [min, max]
+bool option_int(const char* val, long min, long max, int* out) {
+    char* end;
+    long n = strtol(val, &end, 10);
+    if (end == val || *end != '\0') return false;
+    *out = (int)(n < min ? min : (n > max ? max : n));
+    return true;
+}
+
+// Whole unsigned decimal value, for cycle counts
+static bool option_count(const char* val, uint64_t* out) {
+    char* end;
+    if (*val == '-') return false;
+    unsigned long long n = strtoull(val, &end, 10);
+    if (end == val || *end != '\0') return false;
+    *out = n;
+    return true;
+}
+
+// Apply one "--option[=value]" argument. Returns false if not recognised
+// or if its number does not parse.
+bool parse_option(SimConfig* config, const char* arg) {
+    const char* val;
     
-    // Default filenames
-    char* imem_files[NUM_CORES] = {"imem0.txt", "imem1.txt", "imem2.txt", "imem3.txt"};
-    char* memin_file = "memin.txt";
-    char* memout_file = "memout.txt";
-    char* regout_files[NUM_CORES] = {"regout0.txt", "regout1.txt", "regout2.txt", "regout3.txt"};
-    char* core_trace_files[NUM_CORES] = {"core0trace.txt", "core1trace.txt", "core2trace.txt", "core3trace.txt"};
-    char* bus_trace_file = "bustrace.txt";
-    char* dsram_files[NUM_CORES] = {"dsram0.txt", "dsram1.txt", "dsram2.txt", "dsram3.txt"};
-    char* tsram_files[NUM_CORES] = {"tsram0.txt", "tsram1.txt", "tsram2.txt", "tsram3.txt"};
-    char* stats_files[NUM_CORES] = {"stats0.txt", "stats1.txt", "stats2.txt", "stats3.txt"};
+    if (strcmp(arg, "--c2c") == 0) {
+        config->c2c_clean = true;
+    } else if ((val = option_value(arg, "--c2c-latency=")) != NULL) {
+        if (!option_int(val, 0, INT_MAX, &config->c2c_latency)) return false;
+        config->c2c_clean = true;
+    } else if ((val = option_value(arg, "--c2c-responder=")) != NULL) {
+        config->c2c_clean = true;
+        if (strcmp(val, "lowest") == 0) {
+            config->c2c_responder = C2C_RESPONDER_LOWEST_ID;
+        } else if (strcmp(val, "forward") == 0) {
+            config->c2c_responder = C2C_RESPONDER_FORWARD;
+        } else {
+            return false;
+        }
+    } else if (strcmp(arg, "--wb-buffer") == 0) {
+        config->wb_buffer = true;
+    } else if ((val = option_value(arg, "--wb-depth=")) != NULL) {
+        if (!option_int(val, 1, WB_BUFFER_MAX_DEPTH, &config->wb_depth)) return false;
+        config->wb_buffer = true;
+    } else if ((val = option_value(arg, "--wb-drain=")) != NULL) {
+        config->wb_buffer = true;
+        if (strcmp(val, "eager") == 0) {
+            config->wb_drain = WB_DRAIN_EAGER;
+        } else if (strncmp(val, "threshold:", 10) == 0) {
+            if (!option_int(val + 10, 1, INT_MAX, &config->wb_drain_threshold)) return false;
+            config->wb_drain = WB_DRAIN_THRESHOLD;
+        } else {
+            return false;
+        }
+    } else if (strcmp(arg, "--forward") == 0) {
+        config->forwarding = true;
+    } else if (strcmp(arg, "--stall-causes") == 0) {
+        config->stall_causes = true;
+    } else if (strcmp(arg, "--dual-issue") == 0) {
+        config->issue_width = 2;
+    } else if (strcmp(arg, "--functional") == 0) {
+        config->functional = true;
+    } else if (strcmp(arg, "--no-jit") == 0) {
+        config->jit = false;
+    } else if ((val = option_value(arg, "--threads=")) != NULL) {
+        if (!option_int(val, 1, MAX_HW_THREADS, &config->hw_threads)) return false;
+    } else if (strcmp(arg, "--profile") == 0) {
+        config->profile = true;
+    } else if (strcmp(arg, "--sharing-profile") == 0) {
+        config->sharing_profile = true;
+    } else if (strcmp(arg, "--bus-stats") == 0) {
+        config->bus_stats = true;
+    } else if (strcmp(arg, "--miss-classes") == 0) {
+        config->miss_classes = true;
+    } else if (strcmp(arg, "--stack-distance") == 0) {
+        config->stack_distance = true;
+    } else if (strcmp(arg, "--mem-trace") == 0) {
+        config->mem_trace = true;
+    } else if ((val = option_value(arg, "--interval=")) != NULL) {
+        if (!option_count(val, &config->interval)) return false;
+    } else if ((val = option_value(arg, "--interval-format=")) != NULL) {
+        if (strcmp(val, "csv") == 0) {
+            config->interval_format = INTERVAL_CSV;
+        } else if (strcmp(val, "jsonl") == 0) {
+            config->interval_format = INTERVAL_JSONL;
+        } else {
+            return false;
+        }
+    } else if ((val = option_value(arg, "--verify=")) != NULL) {
+        config->verify_dir = val;
+    } else if ((val = option_value(arg, "--max-cycles=")) != NULL) {
+        if (!option_count(val, &config->max_cycles)) return false;
+    } else if ((val = option_value(arg, "--mem-delay=")) != NULL) {
+        if (!option_int(val, 0, INT_MAX, &config->mem_delay)) return false;
+    } else if ((val = option_value(arg, "--mt-policy=")) != NULL) {
+        if (strcmp(val, "switch") == 0) {
+            config->mt_policy = MT_SWITCH_ON_STALL;
+        } else if (strcmp(val, "rr") == 0) {
+            config->mt_policy = MT_ROUND_ROBIN;
+        } else {
+            return false;
+        }
+    } else {
+        return false;
+    }
+    return true;
+}
+
+// Output file in the directory of base: ("out/stats0.txt", "profile0.txt")
+// -> "out/profile0.txt"
+static void sibling_file_name(char* out, size_t size, const char* base, const char* name) {
+    const char* slash = strrchr(base, '/');
+    const char* bslash = strrchr(base, '\\');
+    if (bslash > slash) slash = bslash;
+    int dir = slash ? (int)(slash - base + 1) : 0;
+    snprintf(out, size, "%.*s%s", dir, base, name);
+}
+
+// Output file for thread tid: "regout0.txt" -> "regout0_t1.txt"
+static void thread_file_name(char* out, size_t size, const char* base, int tid) {
+    const char* dot = strrchr(base, '.');
+    int stem = dot ? (int)(dot - base) : (int)strlen(base);
+    snprintf(out, size, "%.*s_t%d%s", stem, base, tid, dot ? dot : "");
+}
+
+// "imem0.txt" ... "imem63.txt": names for every core a build can have
+#define CORE_FILE_NAME(p, s, i)     p #i s,
+#define CORE_FILE_NAMES_10(p, s, t) \
+    CORE_FILE_NAME(p, s, t##0) CORE_FILE_NAME(p, s, t##1) CORE_FILE_NAME(p, s, t##2) \
+    CORE_FILE_NAME(p, s, t##3) CORE_FILE_NAME(p, s, t##4) CORE_FILE_NAME(p, s, t##5) \
+    CORE_FILE_NAME(p, s, t##6) CORE_FILE_NAME(p, s, t##7) CORE_FILE_NAME(p, s, t##8) \
+    CORE_FILE_NAME(p, s, t##9)
+#define CORE_FILE_NAMES(p, s) \
+    CORE_FILE_NAME(p, s, 0) CORE_FILE_NAME(p, s, 1) CORE_FILE_NAME(p, s, 2) \
+    CORE_FILE_NAME(p, s, 3) CORE_FILE_NAME(p, s, 4) CORE_FILE_NAME(p, s, 5) \
+    CORE_FILE_NAME(p, s, 6) CORE_FILE_NAME(p, s, 7) CORE_FILE_NAME(p, s, 8) \
+    CORE_FILE_NAME(p, s, 9) CORE_FILE_NAMES_10(p, s, 1) CORE_FILE_NAMES_10(p, s, 2) \
+    CORE_FILE_NAMES_10(p, s, 3) CORE_FILE_NAMES_10(p, s, 4) CORE_FILE_NAMES_10(p, s, 5) \
+    CORE_FILE_NAME(p, s, 60) CORE_FILE_NAME(p, s, 61) CORE_FILE_NAME(p, s, 62) \
+    CORE_FILE_NAME(p, s, 63)
+
+// Default file names, in the current directory
+void sim_files_default(SimFiles* files) {
+    static const char* const imem[] = { CORE_FILE_NAMES("imem", ".txt") };
+    static const char* const regout[] = { CORE_FILE_NAMES("regout", ".txt") };
+    static const char* const trace[] = { CORE_FILE_NAMES("core", "trace.txt") };
+    static const char* const dsram[] = { CORE_FILE_NAMES("dsram", ".txt") };
+    static const char* const tsram[] = { CORE_FILE_NAMES("tsram", ".txt") };
+    static const char* const stats[] = { CORE_FILE_NAMES("stats", ".txt") };
     
-    // Parse 27 command line arguments if provided
-    if (argc == 28) {
-        // Order: imem0-3 memin memout regout0-3 core0trace-3trace bustrace dsram0-3 tsram0-3 stats0-3
-        int idx = 1;
-        for (int i = 0; i < 4; i++) imem_files[i] = argv[idx++];
-        memin_file = argv[idx++];
-        memout_file = argv[idx++];
-        for (int i = 0; i < 4; i++) regout_files[i] = argv[idx++];
-        for (int i = 0; i < 4; i++) core_trace_files[i] = argv[idx++];
-        bus_trace_file = argv[idx++];
-        for (int i = 0; i < 4; i++) dsram_files[i] = argv[idx++];
-        for (int i = 0; i < 4; i++) tsram_files[i] = argv[idx++];
-        for (int i = 0; i < 4; i++) stats_files[i] = argv[idx++];
-    } else if (argc != 1) {
-        printf("Usage: %s [imem0 imem1 imem2 imem3 memin memout regout0-3 core0trace-3 bustrace dsram0-3 tsram0-3 stats0-3]\n", argv[0]);
-        printf("       (27 arguments total, or no arguments for defaults)\n");
-        return 1;
+    memset(files, 0, sizeof(SimFiles));
+    for (int i = 0; i < NUM_CORES; i++) {
+        files->imem[i] = imem[i];
+        files->regout[i] = regout[i];
+        files->core_trace[i] = trace[i];
+        files->dsram[i] = dsram[i];
+        files->tsram[i] = tsram[i];
+        files->stats[i] = stats[i];
+    }
+    files->memin = "memin.txt";
+    files->memout = "memout.txt";
+    files->bus_trace = "bustrace.txt";
+}
+
+// Input loading and output writing, timed as I/O by simulate_files
+static void load_inputs(Simulator* sim, const SimFiles* files) {
+    for (int i = 0; i < NUM_CORES; i++) {
+        load_imem(&sim->cores[i], 0, files->imem[i]);
+        for (int t = 1; t < sim->config.hw_threads; t++) {
+            if (files->thread_imem[i][t]) {
+                load_imem(&sim->cores[i], t, files->thread_imem[i][t]);
+            }
+        }
+    }
+    load_memin(sim, files->memin);
+}
+
+void write_outputs(Simulator* sim, const SimFiles* files) {
+    // Flush queued victims and all dirty cache lines to main memory before
+    // writing memout
+    for (int c = 0; c < NUM_CORES; c++) {
+        wb_buffer_flush(&sim->cores[c], sim);
+        for (int line = 0; line < CACHE_NUM_BLOCKS; line++) {
+            cache_writeback_block(&sim->cores[c], sim, line);
+        }
     }
     
-    // Initialize
-    sim_init(&g_sim);
+    // Write output files
+    write_memout(sim, files->memout);
+    if (sim->sharing) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->memout, "sharing.txt");
+        sharing_write(sim, path);
+    }
+    for (int i = 0; i < NUM_CORES; i++) {
+        write_regout(sim, &sim->cores[i], 0, files->regout[i]);
+        for (int t = 1; t < sim->config.hw_threads; t++) {
+            if (!files->thread_imem[i][t]) continue;
+            char name[512];
+            thread_file_name(name, sizeof(name), files->regout[i], t);
+            write_regout(sim, &sim->cores[i], t, name);
+        }
+        write_dsram(sim, &sim->cores[i], files->dsram[i]);
+        write_tsram(sim, &sim->cores[i], files->tsram[i]);
+        write_stats(sim, &sim->cores[i], files->stats[i]);
+        if (sim->profile) {
+            char name[32], path[512];
+            snprintf(name, sizeof(name), "profile%d.txt", i);
+            sibling_file_name(path, sizeof(path), files->stats[i], name);
+            profile_write(sim, &sim->cores[i], path);
+        }
+    }
+    
+    if (sim->bus_stats) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->stats[0], "busstats.json");
+        bus_stats_write(sim, path);
+    }
+    if (sim->miss_class) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->stats[0], "conflicts.txt");
+        miss_class_write_heatmap(sim, path);
+    }
+    if (sim->stack_dist) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->stats[0], "missratio.txt");
+        stack_dist_write(sim, path);
+    }
+}
+
+// One complete run: load, simulate, write every output file (or compare
+// them, config->verify_dir). timing, if not NULL, receives the host time
+// split and the run's totals; verify, if not NULL, the comparison.
+// Returns the process exit code.
+int simulate_files(const SimConfig* config, const SimFiles* files, RunTiming* timing,
+                   VerifyResult* verify) {
+    double start = platform_now();
+    
+    // Initialize; a run owns its simulator, so runs can proceed in parallel
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    if (!sim) {
+        fprintf(stderr, "Error: Failed to allocate simulator\n");
+        return 1;
+    }
+    if (!sim_init(sim)) {
+        sim_cleanup(sim);
+        free(sim);
+        return 1;
+    }
+    sim->config = *config;
+    if ((config->profile && !profile_init(sim)) ||
+        (config->sharing_profile && !sharing_init(sim)) ||
+        (config->bus_stats && !bus_stats_init(sim)) ||
+        (config->miss_classes && !miss_class_init(sim)) ||
+        (config->stack_distance && !stack_dist_init(sim)) ||
+        (config->verify_dir && !verify_init(sim, config->verify_dir))) {
+        sim_cleanup(sim);
+        free(sim);
+        return 1;
+    }
+    if (timing) {
+        memset(timing, 0, sizeof(RunTiming));
+        sim->timing = timing;
+    }
     
     // Load input files
-    for (int i = 0; i < NUM_CORES; i++) {
-        load_imem(&g_sim.cores[i], imem_files[i]);
+    double t = platform_now();
+    load_inputs(sim, files);
+    
+    // Open trace files (functional runs have no cycles to trace)
+    for (int i = 0; i < NUM_CORES && !config->functional; i++) {
+        output_open(sim, &sim->core_trace[i], files->core_trace[i], OUT_CORE_TRACE, i);
     }
-    load_memin(&g_sim, memin_file);
+    if (!config->functional) output_open(sim, &sim->bus_trace, files->bus_trace, OUT_BUS_TRACE, 0);
     
-    // Open trace files
-    for (int i = 0; i < NUM_CORES; i++) {
-        g_sim.core_trace[i] = fopen(core_trace_files[i], "w");
+    if (config->interval > 0) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->stats[0],
+                          config->interval_format == INTERVAL_CSV ? "intervals.csv" :
+                                                                    "intervals.jsonl");
+        if (!interval_init(sim, path)) {
+            sim_cleanup(sim);
+            free(sim);
+            return 1;
+        }
     }
-    g_sim.bus_trace = fopen(bus_trace_file, "w");
+    if (config->mem_trace) {
+        char path[512];
+        sibling_file_name(path, sizeof(path), files->stats[0], MEM_TRACE_FILE);
+        if (!mem_trace_init(sim, path)) {
+            sim_cleanup(sim);
+            free(sim);
+            return 1;
+        }
+    }
+    if (timing) timing->io_s += platform_now() - t;
     
     // Run simulation
-    run_simulation(&g_sim);
+    if (config->functional) {
+        functional_run(sim);
+    } else {
+        run_simulation(sim);
+    }
+    
+    t = platform_now();
+    interval_finish(sim);
+    mem_trace_finish(sim);
     
     // Close trace files
     for (int i = 0; i < NUM_CORES; i++) {
-        if (g_sim.core_trace[i]) {
-            fclose(g_sim.core_trace[i]);
-            g_sim.core_trace[i] = NULL;
+        output_close(&sim->core_trace[i]);
+    }
+    output_close(&sim->bus_trace);
+    
+    write_outputs(sim, files);
+    if (!config->quiet) printf("All output files %s.\n", sim->verify ? "checked" : "written");
+    
+    if (timing) {
+        timing->io_s += platform_now() - t;
+        timing->cycles = sim->cycle ? sim->cycle - 1 : 0;
+        for (int i = 0; i < NUM_CORES; i++) {
+            timing->instructions += sim->cores[i].instruction_count;
         }
+        timing->total_s = platform_now() - start;
+        timing->finished = (sim->stopped == STOP_NONE);
     }
-    if (g_sim.bus_trace) {
-        fclose(g_sim.bus_trace);
-        g_sim.bus_trace = NULL;
+    
+    int code = 0;
+    if (sim->verify) {
+        VerifyResult result;
+        verify_finish(sim, &result);
+        if (verify) *verify = result;
+        if (!result.passed) code = 1;
     }
     
-    // Flush all dirty cache lines to main memory before writing memout
+    // Cleanup
+    sim_cleanup(sim);
+    free(sim);
+    
+    return code;
+}
+
+// Drop option combinations the model does not support. Returns a note for
+// the user, or NULL if config was already consistent.
+const char* config_resolve(SimConfig* config) {
+    const char* note = NULL;
+    
+    // The dual-issue pipeline has no bypass network
+    if (config->issue_width == 2 && config->forwarding) {
+        note = "--forward is ignored with --dual-issue";
+        config->forwarding = false;
+        config->stall_causes = true;
+    }
+    
+    // Threads share one pipeline; the dual-issue lanes are not thread-aware
+    if (config->issue_width == 2 && config->hw_threads > 1) {
+        note = note ? "--forward and --threads are ignored with --dual-issue" :
+                      "--threads is ignored with --dual-issue";
+        config->hw_threads = 1;
+    }
+    
+    // The reference stream is recorded per core, one access in flight
+    if (config->mem_trace && (config->issue_width == 2 || config->hw_threads > 1)) {
+        note = "--mem-trace is ignored with --dual-issue and --threads";
+        config->mem_trace = false;
+    }
+    
+    // Functional runs have no pipeline or bus; only the caches are modelled
+    if (config->functional && (config->issue_width == 2 || config->hw_threads > 1 ||
+                               config->profile || config->sharing_profile ||
+                               config->bus_stats || config->miss_classes ||
+                               config->interval > 0 || config->mem_trace)) {
+        note = "--functional ignores timing and report options other than --stack-distance";
+        config->issue_width = 1;
+        config->hw_threads = 1;
+        config->profile = false;
+        config->sharing_profile = false;
+        config->bus_stats = false;
+        config->miss_classes = false;
+        config->interval = 0;
+        config->mem_trace = false;
+    }
+    return note;
+}
+
+#ifndef MESISIM_NO_MAIN     // Library builds (mesisim.h) bring their own main
+
+static void print_usage(const char* prog) {
+    printf("Usage: %s [options] [imem0 imem1 imem2 imem3 memin memout regout0-3 core0trace-3 bustrace dsram0-3 tsram0-3 stats0-3]\n", prog);
+    printf("       (27 arguments total, or no arguments for defaults)\n");
+    printf("       %s --schedule [--forward] imem_in [imem_out]\n", prog);
+    printf("Options:\n");
+    printf("  --c2c                     Clean (E/S) peers supply blocks cache-to-cache\n");
+    printf("  --c2c-latency=N           Cycles before a peer's first Flush word (default %d)\n", C2C_DEFAULT_LATENCY);
+    printf("  --c2c-responder=lowest|forward\n");
+    printf("                            Responder: lowest core id, or MESIF Forward holder\n");
+    printf("  --wb-buffer               Queue dirty victims, drain them in idle bus slots\n");
+    printf("  --wb-depth=N              Writeback buffer entries per core (default %d)\n", WB_DEFAULT_DEPTH);
+    printf("  --wb-drain=eager|threshold:N\n");
+    printf("                            Drain in any idle slot, or once N victims are queued\n");
+    printf("  --forward                 EX->EX, MEM->EX, WB->ID bypass with load-use interlock\n");
+    printf("  --stall-causes            Split decode_stall into raw/load-use/branch counters\n");
+    printf("  --dual-issue              2-wide in-order pipeline (trace shows lane0/lane1)\n");
+    printf("  --threads=N               Hardware threads per core, 1-%d (default 1)\n", MAX_HW_THREADS);
+    printf("  --mt-policy=switch|rr     Switch threads on a miss, or rotate every cycle\n");
+    printf("  --thread-imem=C:T:FILE    IMEM image of thread T (1..N-1) on core C\n");
+    printf("  --profile                 Per-PC hot spots and annotated disassembly\n");
+    printf("                            (profileN.txt next to statsN.txt)\n");
+    printf("  --sharing-profile         Per-block invalidations and false sharing\n");
+    printf("                            (sharing.txt next to memout)\n");
+    printf("  --bus-stats               Bus latency histograms and occupancy\n");
+    printf("                            (busstats.json next to stats0.txt)\n");
+    printf("  --miss-classes            Compulsory/capacity/conflict/coherence misses\n");
+    printf("                            in statsN.txt, per-set conflicts.txt\n");
+    printf("  --stack-distance          LRU miss ratio of every power-of-two cache size and\n");
+    printf("                            associativity in one run (missratio.txt)\n");
+    printf("  --interval=N              Per-core counters every N cycles\n");
+    printf("  --interval-format=csv|jsonl\n");
+    printf("                            (intervals.csv/.jsonl next to stats0.txt)\n");
+    printf("  --mem-trace               Record every load/store/atomic for --replay\n");
+    printf("                            (%s next to stats0.txt)\n", MEM_TRACE_FILE);
+    printf("  --functional              Run the programs without pipeline timing: caches and\n");
+    printf("                            memory only, hot blocks translated to x86-64 code\n");
+    printf("                            (no traces; --max-cycles limits instructions per core)\n");
+    printf("  --no-jit                  Interpret every instruction in --functional runs\n");
+    printf("  --max-cycles=N            Stop after N cycles, 0 = no limit (default %d)\n",
+           DEFAULT_MAX_CYCLES);
+    printf("  --mem-delay=N             Cycles before memory's first Flush word (default %d)\n",
+           MEM_RESPONSE_DELAY);
+    printf("Verification (see docs/BUILDING.md):\n");
+    printf("  --verify=DIR              Compare outputs with DIR as they are produced\n");
+    printf("                            instead of writing them; stop at the first mismatch\n");
+    printf("  --test-suite[=DIR]        Verify every DIR/<test> against DIR/<test>/expected,\n");
+    printf("                            in parallel (default %s)\n", SUITE_DEFAULT_DIR);
+    printf("  --jobs=N                  Suite worker threads (default: one per CPU)\n");
+    printf("  --make-hashes=DIR         Write DIR/%s for the expected files in DIR\n", VERIFY_HASH_FILE);
+    printf("Trace-driven replay (see docs/ARCHITECTURE.md):\n");
+    printf("  --replay=FILE             Replay a --mem-trace recording through the caches\n");
+    printf("                            and bus only; timing options (--mem-delay, --c2c,\n");
+    printf("                            --wb-buffer, ...) may differ from the recording\n");
+    printf("Static scheduling (see docs/ARCHITECTURE.md):\n");
+    printf("  --schedule                Reorder imem_in to cover decode hazards and fill\n");
+    printf("                            delay slots; report the predicted stalls and write\n");
+    printf("                            imem_out if given (--forward selects the cost model)\n");
+    printf("Parameter sweep (see docs/BUILDING.md):\n");
+    printf("  --sweep=NAME=V1,V2,...    Sweep axis: any valued option, e.g. mem-delay=8,16,32,\n");
+    printf("                            or protocol=mesi,c2c,mesif; repeat for a grid\n");
+    printf("  --sweep=FLAG              Sweep a flag off and on, e.g. --sweep=forward\n");
+    printf("  --sweep-dir=DIR           Inputs imem0-3/memin (default: current directory)\n");
+    printf("  --sweep-out=FILE          Also write the results as CSV\n");
+    printf("  --jobs=N                  Worker threads (default: one per CPU)\n");
+    printf("Lockstep batch (see docs/ARCHITECTURE.md):\n");
+    printf("  --batch=DIR               Run DIR/imem0-3 on every DIR/<name>/memin.txt in\n");
+    printf("                            functional mode, %d instances in lockstep; outputs\n", BATCH_LANES);
+    printf("                            go to DIR/<name>/\n");
+    printf("  --batch-compare           Also run each instance alone and compare throughput\n");
+    printf("  --jobs=N                  Worker threads (default: one per CPU)\n");
+    printf("Benchmark mode (host speed of the simulator, see docs/BUILDING.md):\n");
+    printf("  --bench                   Run the benchmark workloads instead of one run\n");
+    printf("  --bench-tests=DIR         Test workloads directory (default %s)\n", BENCH_DEFAULT_TESTS);
+    printf("  --bench-out=DIR           Scratch output directory (default %s)\n", BENCH_DEFAULT_OUT);
+    printf("  --bench-reps=N            Runs per workload, fastest counts (default %d)\n", BENCH_DEFAULT_REPS);
+    printf("  --bench-only=NAME         Only workloads whose name contains NAME\n");
+    printf("  --bench-save=FILE         Write the results as a JSON baseline\n");
+    printf("  --bench-baseline=FILE     Compare with a saved baseline\n");
+    printf("  --bench-threshold=PCT     Slowdown reported as a regression (default %d)\n",
+           BENCH_DEFAULT_THRESHOLD);
+}
+
+// "--thread-imem=C:T:FILE" -> core C, thread T and FILE. Returns false if malformed.
+bool parse_thread_imem(const char* arg, int* core, int* thread, const char** file) {
+    const char* val = option_value(arg, "--thread-imem=");
+    int len;
+    
+    if (!val || sscanf(val, "%d:%d:%n", core, thread, &len) != 2) return false;
+    if (*core < 0 || *core >= NUM_CORES || *thread < 1 || *thread >= MAX_HW_THREADS) return false;
+    *file = val + len;
+    return true;
+}
+
+// Every --thread-imem names a thread that runs (T < --threads); otherwise
+// its image would be silently ignored
+static bool check_thread_imem(const SimConfig* config, const SimFiles* files) {
+    bool ok = true;
     for (int c = 0; c < NUM_CORES; c++) {
-        for (int line = 0; line < CACHE_NUM_BLOCKS; line++) {
-            cache_writeback_block(&g_sim.cores[c], &g_sim, line);
+        for (int t = config->hw_threads; t < MAX_HW_THREADS; t++) {
+            if (!files->thread_imem[c][t]) continue;
+            fprintf(stderr, "Error: --thread-imem=%d:%d:%s needs --threads=%d or more%s\n",
+                    c, t, files->thread_imem[c][t], t + 1,
+                    (config->issue_width == 2) ? " (and no --dual-issue)" : "");
+            ok = false;
         }
     }
+    return ok;
+}
+
+int main(int argc, char* argv[]) {
+    printf("Multi-Core MESI Simulator\n");
+    printf("=========================\n\n");
     
-    // Write output files
-    write_memout(&g_sim, memout_file);
-    for (int i = 0; i < NUM_CORES; i++) {
-        write_regout(&g_sim.cores[i], regout_files[i]);
-        write_dsram(&g_sim.cores[i], dsram_files[i]);
-        write_tsram(&g_sim.cores[i], tsram_files[i]);
-        write_stats(&g_sim.cores[i], stats_files[i]);
+    SimFiles files;
+    sim_files_default(&files);
+    
+    // Split options from positional file arguments
+    SimConfig config;
+    config_init(&config);
+    BenchOptions bench;
+    bench_options_init(&bench);
+    SweepOptions sweep;
+    sweep_options_init(&sweep);
+    bool sweeping = false;              // --sweep...
+    const char* suite_dir = NULL;       // --test-suite
+    const char* hash_dir = NULL;        // --make-hashes
+    int jobs = 0;                       // Suite workers, 0 = one per CPU
+    bool schedule = false;              // --schedule imem_in [imem_out]
+    const char* replay_file = NULL;     // --replay
+    const char* batch_dir = NULL;       // --batch
+    bool batch_compare = false;         // --batch-compare
+    char* args[27];
+    int nargs = 0;
+    for (int i = 1; i < argc; i++) {
+        if (strncmp(argv[i], "--thread-imem=", 14) == 0) {
+            int c, t;
+            const char* file;
+            if (!parse_thread_imem(argv[i], &c, &t, &file)) {
+                printf("Bad option: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            files.thread_imem[c][t] = file;
+        } else if (strncmp(argv[i], "--bench", 7) == 0) {
+            if (!bench_parse_option(&bench, argv[i])) {
+                printf("Bad option: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strcmp(argv[i], "--test-suite") == 0) {
+            suite_dir = SUITE_DEFAULT_DIR;
+        } else if (strncmp(argv[i], "--sweep", 7) == 0) {
+            if (!sweep_parse_option(&sweep, argv[i])) {
+                printf("Bad option: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+            sweeping = true;
+        } else if (strncmp(argv[i], "--test-suite=", 13) == 0) {
+            suite_dir = argv[i] + 13;
+        } else if (strncmp(argv[i], "--jobs=", 7) == 0) {
+            if (!option_int(argv[i] + 7, 0, INT_MAX, &jobs)) {
+                printf("Bad option: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (strncmp(argv[i], "--make-hashes=", 14) == 0) {
+            hash_dir = argv[i] + 14;
+        } else if (strcmp(argv[i], "--schedule") == 0) {
+            schedule = true;
+        } else if (strncmp(argv[i], "--replay=", 9) == 0) {
+            replay_file = argv[i] + 9;
+        } else if (strncmp(argv[i], "--batch=", 8) == 0) {
+            batch_dir = argv[i] + 8;
+        } else if (strcmp(argv[i], "--batch-compare") == 0) {
+            batch_compare = true;
+        } else if (strncmp(argv[i], "--", 2) == 0) {
+            if (!parse_option(&config, argv[i])) {
+                printf("Bad option: %s\n", argv[i]);
+                print_usage(argv[0]);
+                return 1;
+            }
+        } else if (nargs < 27) {
+            args[nargs++] = argv[i];
+        } else {
+            nargs++;
+        }
+    }
+    
+    if (schedule) {
+        if (nargs < 1 || nargs > 2) {
+            print_usage(argv[0]);
+            return 1;
+        }
+        return schedule_imem(&config, args[0], nargs == 2 ? args[1] : NULL);
     }
     
-    printf("All output files written.\n");
+    // Parse 27 command line arguments if provided
+    if (nargs == 27) {
+        // Order: imem0-3 memin memout regout0-3 core0trace-3trace bustrace dsram0-3 tsram0-3 stats0-3
+        int idx = 0;
+        for (int i = 0; i < 4; i++) files.imem[i] = args[idx++];
+        files.memin = args[idx++];
+        files.memout = args[idx++];
+        for (int i = 0; i < 4; i++) files.regout[i] = args[idx++];
+        for (int i = 0; i < 4; i++) files.core_trace[i] = args[idx++];
+        files.bus_trace = args[idx++];
+        for (int i = 0; i < 4; i++) files.dsram[i] = args[idx++];
+        for (int i = 0; i < 4; i++) files.tsram[i] = args[idx++];
+        for (int i = 0; i < 4; i++) files.stats[i] = args[idx++];
+    } else if (nargs != 0) {
+        print_usage(argv[0]);
+        return 1;
+    }
     
-    // Cleanup
-    sim_cleanup(&g_sim);
+    const char* note = config_resolve(&config);
+    if (note) printf("Note: %s\n", note);
+    if (!check_thread_imem(&config, &files)) return 1;
     
-    return 0;
+    if (hash_dir) return verify_make_hashes(hash_dir) ? 0 : 1;
+    if (suite_dir) return run_test_suite(&config, suite_dir, jobs);
+    if (replay_file) return mem_replay_run(&config, replay_file);
+    if (sweeping) return sweep_run(&config, &sweep, jobs);
+    if (batch_dir) return batch_run(&config, batch_dir, batch_compare, jobs);
+    if (bench.enabled) return bench_run(&config, &bench);
+    return simulate_files(&config, &files, NULL, NULL);
 }
+
+#endif // MESISIM_NO_MAIN
@@ -0,0 +1,313 @@
+/*
+ * =============================================================================
+ * Memory-Reference Trace and Trace-Driven Replay
+ * =============================================================================
+ * Recording (config.mem_trace, --mem-trace) writes memtrace.bin next to
+ * stats0.txt: the "MESITRC1" magic, the core count, then one 8-byte record
+ * per load, store or atomic in the order they reach MEM (see MemTrace in
+ * sim.h). A reference is recorded once, when it first enters MEM; miss
+ * retries are not. Each core ends with a MEM_REF_END record for its last
+ * active cycle.
+ *
+ * Replay (sim --replay=FILE) runs only the caches and the bus. Every cycle
+ * it runs bus_cycle, then lets each core issue its next reference through
+ * cache_read/cache_write/cache_atomic once the recorded gap has passed,
+ * retrying every cycle until the access completes, as MEM does. Timing
+ * options (--mem-delay, --c2c, --c2c-latency, --wb-buffer, ...) may differ
+ * from the recording; with the recording's options the replay reproduces
+ * its cycle counts, hits and misses. The stream itself is fixed: time a
+ * core spent asleep in BAR/MWAIT is replayed as compute time, and a spin
+ * loop replays the iterations it took in the recording. Replay is exact
+ * for code whose references do not depend on timing and an estimate for
+ * lock- or flag-synchronized code.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+
+#define MEM_REF_ADDR_MASK   0x1FFFFF
+#define MEM_REF_KIND_SHIFT  21
+#define MEM_REF_CORE_SHIFT  24
+
+/* =============================================================================
+ * RECORDING
+ * =============================================================================
+ */
+
+static void trace_flush(MemTrace* t) {
+    if (t->len > 0) fwrite(t->buf, sizeof(uint32_t), (size_t)t->len, t->fp);
+    t->len = 0;
+}
+
+static void trace_record(MemTrace* t, uint32_t gap, uint32_t word) {
+    if (t->len + 2 > MEM_TRACE_BUF_WORDS) trace_flush(t);
+    t->buf[t->len++] = gap;
+    t->buf[t->len++] = word;
+    t->records++;
+}
+
+// One record for cycle `now`; longer gaps than a word holds become IDLE records
+static void trace_event(MemTrace* t, int core_id, MemRefKind kind, uint32_t addr,
+                        uint64_t now) {
+    uint64_t gap = now > t->last_done[core_id] ? now - t->last_done[core_id] : 0;
+    uint32_t core_bits = (uint32_t)core_id << MEM_REF_CORE_SHIFT;
+
+    while (gap > UINT32_MAX) {
+        trace_record(t, UINT32_MAX, (uint32_t)MEM_REF_IDLE << MEM_REF_KIND_SHIFT | core_bits);
+        gap -= UINT32_MAX;
+    }
+    trace_record(t, (uint32_t)gap, (addr & MEM_REF_ADDR_MASK) |
+                 (uint32_t)kind << MEM_REF_KIND_SHIFT | core_bits);
+}
+
+bool mem_trace_init(Simulator* sim, const char* filename) {
+    MemTrace* t = (MemTrace*)calloc(1, sizeof(MemTrace));
+    if (!t) {
+        fprintf(stderr, "Error: Failed to allocate memory trace\n");
+        return false;
+    }
+    t->fp = fopen(filename, "wb");
+    if (!t->fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        free(t);
+        return false;
+    }
+    uint32_t cores = NUM_CORES;
+    fwrite(MEM_TRACE_MAGIC, 1, 8, t->fp);
+    fwrite(&cores, sizeof(cores), 1, t->fp);
+    sim->mem_trace = t;
+    return true;
+}
+
+// After every cache access from MEM; done = the access completed this cycle
+void mem_trace_access(Simulator* sim, Core* core, MemRefKind kind, uint32_t addr, bool done) {
+    MemTrace* t = sim->mem_trace;
+    int c = core->core_id;
+
+    if (!t->issued[c]) {
+        trace_event(t, c, kind, addr, sim->cycle);
+        t->issued[c] = true;
+    }
+    if (done) {
+        t->last_done[c] = sim->cycle;
+        t->issued[c] = false;
+    }
+}
+
+// End record per core, then close the file
+void mem_trace_finish(Simulator* sim) {
+    MemTrace* t = sim->mem_trace;
+    if (!t) return;
+
+    for (int i = 0; i < NUM_CORES; i++) {
+        Core* core = &sim->cores[i];
+        trace_event(t, i, MEM_REF_END, 0, core->cycle_count + core->sleep_cycles);
+    }
+    trace_flush(t);
+    fclose(t->fp);
+    if (!sim->config.quiet) {
+        printf("Memory trace: %llu references\n",
+               (unsigned long long)(t->records - NUM_CORES));
+    }
+    free(t);
+    sim->mem_trace = NULL;
+}
+
+/* =============================================================================
+ * REPLAY
+ * =============================================================================
+ */
+
+typedef struct {
+    uint32_t*   rec;            // This core's records, gap and word each
+    uint64_t    count;
+    uint64_t    pos;
+    uint64_t    next;           // Cycle the current record issues
+    uint64_t    refs;           // Loads, stores and atomics
+    bool        finished;
+} ReplayCore;
+
+// Whole file after the header; returns the word count, or -1 on error
+static long long read_trace(const char* filename, uint32_t** words) {
+    FILE* fp = fopen(filename, "rb");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open %s\n", filename);
+        return -1;
+    }
+
+    char magic[8];
+    uint32_t cores = 0;
+    if (fread(magic, 1, 8, fp) != 8 || memcmp(magic, MEM_TRACE_MAGIC, 8) != 0 ||
+        fread(&cores, sizeof(cores), 1, fp) != 1) {
+        fprintf(stderr, "Error: %s is not a memory trace (--mem-trace)\n", filename);
+        fclose(fp);
+        return -1;
+    }
+    if (cores != NUM_CORES) {
+        fprintf(stderr, "Error: %s was recorded with %u cores, this build has %d\n",
+                filename, cores, NUM_CORES);
+        fclose(fp);
+        return -1;
+    }
+
+    size_t cap = MEM_TRACE_BUF_WORDS, n = 0;
+    uint32_t* buf = (uint32_t*)malloc(cap * sizeof(uint32_t));
+    while (buf) {
+        n += fread(buf + n, sizeof(uint32_t), cap - n, fp);
+        if (n < cap) break;
+        uint32_t* grown = (uint32_t*)realloc(buf, 2 * cap * sizeof(uint32_t));
+        if (!grown) {
+            free(buf);
+            buf = NULL;
+        } else {
+            buf = grown;
+            cap *= 2;
+        }
+    }
+    fclose(fp);
+    if (!buf) {
+        fprintf(stderr, "Error: Failed to allocate memory for %s\n", filename);
+        return -1;
+    }
+    *words = buf;
+    return (long long)(n & ~(size_t)1);     // Whole records only
+}
+
+// Split the interleaved stream into one array per core
+static bool split_trace(const uint32_t* words, long long nwords, ReplayCore* rc) {
+    for (long long i = 0; i < nwords; i += 2) {
+        uint32_t c = words[i + 1] >> MEM_REF_CORE_SHIFT;
+        if (c >= NUM_CORES) {
+            fprintf(stderr, "Error: Memory trace record for core %u\n", c);
+            return false;
+        }
+        rc[c].count++;
+    }
+    for (int c = 0; c < NUM_CORES; c++) {
+        rc[c].rec = (uint32_t*)malloc((size_t)(rc[c].count ? rc[c].count : 1) * 2 * sizeof(uint32_t));
+        if (!rc[c].rec) {
+            fprintf(stderr, "Error: Failed to allocate replay records\n");
+            return false;
+        }
+        rc[c].pos = 0;
+    }
+    for (long long i = 0; i < nwords; i += 2) {
+        ReplayCore* r = &rc[words[i + 1] >> MEM_REF_CORE_SHIFT];
+        r->rec[2 * r->pos] = words[i];
+        r->rec[2 * r->pos + 1] = words[i + 1];
+        r->pos++;
+    }
+    for (int c = 0; c < NUM_CORES; c++) {
+        rc[c].pos = 0;
+        rc[c].next = rc[c].count ? rc[c].rec[0] : 0;
+        rc[c].finished = (rc[c].count == 0);
+    }
+    return true;
+}
+
+// The core's next reference, if its gap has passed; retried until it completes
+static void replay_core(Simulator* sim, Core* core, ReplayCore* rc) {
+    if (rc->finished || sim->cycle < rc->next) return;
+
+    uint32_t word = rc->rec[2 * rc->pos + 1];
+    uint32_t addr = word & MEM_REF_ADDR_MASK;
+    int32_t data;
+    bool done = true;
+
+    switch ((MemRefKind)((word >> MEM_REF_KIND_SHIFT) & 7)) {
+        case MEM_REF_READ:
+            done = cache_read(core, sim, addr, &data);
+            break;
+        case MEM_REF_WRITE:
+            done = cache_write(core, sim, addr, 0);
+            break;
+        case MEM_REF_ATOMIC: {
+            Instruction faa = decode_instruction((uint32_t)OP_FAA << 24);
+            done = cache_atomic(core, sim, &faa, addr, 0, 0, &data);     // Adds 0
+            break;
+        }
+        case MEM_REF_IDLE:
+            break;
+        case MEM_REF_END:
+        default:
+            core->cycle_count = sim->cycle;
+            rc->finished = true;
+            return;
+    }
+    if (!done) {
+        core->mem_stall_cycles++;
+        return;
+    }
+
+    if ((word >> MEM_REF_KIND_SHIFT & 7) != MEM_REF_IDLE) rc->refs++;
+    rc->pos++;
+    if (rc->pos == rc->count) {
+        // Truncated trace: no END record
+        core->cycle_count = sim->cycle;
+        rc->finished = true;
+    } else {
+        rc->next = sim->cycle + rc->rec[2 * rc->pos];
+    }
+}
+
+static void print_replay(const Simulator* sim, const ReplayCore* rc, double seconds) {
+    printf("Core  %10s %10s %10s %10s %10s %10s %10s\n", "refs", "cycles", "read_hit",
+           "write_hit", "read_miss", "write_miss", "mem_stall");
+    for (int i = 0; i < NUM_CORES; i++) {
+        const Core* c = &sim->cores[i];
+        printf("%4d  %10llu %10llu %10llu %10llu %10llu %10llu %10llu\n", i,
+               (unsigned long long)rc[i].refs, (unsigned long long)c->cycle_count,
+               (unsigned long long)c->read_hits, (unsigned long long)c->write_hits,
+               (unsigned long long)c->read_misses, (unsigned long long)c->write_misses,
+               (unsigned long long)c->mem_stall_cycles);
+    }
+    uint64_t cycles = sim->cycle - 1;
+    printf("Total cycles: %llu, host time %.3f s (%.1f M cycles/s)\n",
+           (unsigned long long)cycles, seconds,
+           seconds > 0 ? (double)cycles / seconds / 1e6 : 0.0);
+}
+
+// sim --replay=FILE: returns the process exit code
+int mem_replay_run(const SimConfig* config, const char* filename) {
+    uint32_t* words = NULL;
+    long long nwords = read_trace(filename, &words);
+    if (nwords < 0) return 1;
+
+    ReplayCore rc[NUM_CORES];
+    memset(rc, 0, sizeof(rc));
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    int code = 1;
+    if (!sim) {
+        fprintf(stderr, "Error: Failed to allocate simulator\n");
+    } else if (sim_init(sim) && split_trace(words, nwords, rc)) {
+        // Only the cache and bus timing options take effect
+        sim->config = *config;
+        printf("Replaying %s: %lld records\n", filename, nwords / 2);
+
+        double start = platform_now();
+        for (sim->cycle = 1; ; sim->cycle++) {
+            bool active = sim->bus.arbiter.transaction_in_progress;
+            for (int i = 0; i < NUM_CORES; i++) active = active || !rc[i].finished;
+            if (!active) break;
+            if (config->max_cycles && sim->cycle > config->max_cycles) {
+                fprintf(stderr, "Error: Exceeded %llu cycles\n",
+                        (unsigned long long)config->max_cycles);
+                break;
+            }
+
+            bus_cycle(sim);
+            for (int i = 0; i < NUM_CORES; i++) replay_core(sim, &sim->cores[i], &rc[i]);
+        }
+        print_replay(sim, rc, platform_now() - start);
+        code = 0;
+    }
+
+    for (int i = 0; i < NUM_CORES; i++) free(rc[i].rec);
+    free(words);
+    if (sim) {
+        sim_cleanup(sim);
+        free(sim);
+    }
+    return code;
+}
@@ -0,0 +1,214 @@
+/*
+ * =============================================================================
+ * libmesisim - Embeddable Simulator API
+ * =============================================================================
+ * Thin layer over the same Simulator the CLI runs (see mesisim.h). A handle
+ * owns one Simulator; mesisim_step/run call sim_start once and then
+ * sim_step per cycle, exactly like run_simulation. Traces and report files
+ * stay closed, so a handle costs no I/O. Main memory is a lazily zeroed
+ * calloc, so only the pages a program touches become resident.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "mesisim.h"
+#include "platform.h"
+
+struct MesiSim {
+    Simulator   sim;
+    bool        started;        // sim_start done; configuration and loads closed
+};
+
+int mesisim_num_cores(void) {
+    return NUM_CORES;
+}
+
+MesiSim* mesisim_create(void) {
+    MesiSim* ms = (MesiSim*)malloc(sizeof(MesiSim));
+    if (!ms) return NULL;
+    if (!sim_init(&ms->sim)) {
+        sim_cleanup(&ms->sim);
+        free(ms);
+        return NULL;
+    }
+    ms->sim.config.quiet = true;
+    ms->started = false;
+    return ms;
+}
+
+void mesisim_destroy(MesiSim* ms) {
+    if (!ms) return;
+    sim_cleanup(&ms->sim);
+    free(ms);
+}
+
+/* =============================================================================
+ * CONFIGURATION AND INPUTS
+ * =============================================================================
+ */
+
+bool mesisim_configure(MesiSim* ms, const char* option) {
+    if (ms->started) return false;
+
+    SimConfig config = ms->sim.config;
+    if (!parse_option(&config, option)) return false;
+
+    // Reports and verification need files opened by simulate_files;
+    // functional runs cannot be stepped by cycles
+    if (config.profile || config.sharing_profile || config.bus_stats ||
+        config.miss_classes || config.interval > 0 || config.mem_trace ||
+        config.stack_distance || config.functional ||
+        config.verify_dir) {
+        return false;
+    }
+    config.quiet = true;
+    ms->sim.config = config;
+    return true;
+}
+
+bool mesisim_load_imem(MesiSim* ms, int core, const uint32_t* words, int count) {
+    if (ms->started || core < 0 || core >= NUM_CORES || count < 0 || count > IMEM_DEPTH) {
+        return false;
+    }
+    HwThread* th = &ms->sim.cores[core].thread[0];
+    memset(th->imem, 0, IMEM_DEPTH * sizeof(uint32_t));
+    memcpy(th->imem, words, (size_t)count * sizeof(uint32_t));
+    return true;
+}
+
+bool mesisim_load_memory(MesiSim* ms, uint32_t addr, const int32_t* words, int count) {
+    if (ms->started || count < 0 || addr > MAIN_MEM_SIZE ||
+        (uint32_t)count > MAIN_MEM_SIZE - addr) {
+        return false;
+    }
+    memcpy(&ms->sim.main_memory[addr], words, (size_t)count * sizeof(int32_t));
+    return true;
+}
+
+// Same rules as load_imem/load_memin: blank lines skipped, one hex word a line
+int mesisim_parse_hex(const char* text, uint32_t* words, int max) {
+    int n = 0;
+    const char* p = text;
+    while (*p && n < max) {
+        while (*p == ' ' || *p == '\t') p++;
+        char* end;
+        unsigned long value = strtoul(p, &end, 16);
+        if (end != p) words[n++] = (uint32_t)value;
+
+        // Next line
+        while (*p && *p != '\n') p++;
+        if (*p == '\n') p++;
+    }
+    return n;
+}
+
+/* =============================================================================
+ * RUNNING
+ * =============================================================================
+ */
+
+uint64_t mesisim_step(MesiSim* ms, uint64_t cycles) {
+    Simulator* sim = &ms->sim;
+    if (!ms->started) {
+        config_resolve(&sim->config);
+        sim_start(sim);
+        ms->started = true;
+    }
+
+    uint64_t done = 0;
+    while (done < cycles && sim_step(sim)) done++;
+    return done;
+}
+
+MesiSimStatus mesisim_run(MesiSim* ms) {
+    while (mesisim_step(ms, UINT64_MAX) > 0) {
+    }
+    return mesisim_status(ms);
+}
+
+MesiSimStatus mesisim_status(const MesiSim* ms) {
+    switch (ms->sim.stopped) {
+        case STOP_DEADLOCK:    return MESISIM_DEADLOCK;
+        case STOP_CYCLE_LIMIT: return MESISIM_CYCLE_LIMIT;
+        default: break;
+    }
+    if (ms->started && all_cores_done((Simulator*)&ms->sim)) return MESISIM_DONE;
+    return MESISIM_RUNNING;
+}
+
+uint64_t mesisim_cycles(const MesiSim* ms) {
+    return ms->started ? ms->sim.cycle - 1 : 0;
+}
+
+/* =============================================================================
+ * RESULTS
+ * =============================================================================
+ */
+
+bool mesisim_get_stats(const MesiSim* ms, int core, MesiSimStats* stats) {
+    if (core < 0 || core >= NUM_CORES) return false;
+    const Core* c = &ms->sim.cores[core];
+    stats->cycles = c->cycle_count;
+    stats->instructions = c->instruction_count;
+    stats->read_hits = c->read_hits;
+    stats->write_hits = c->write_hits;
+    stats->read_misses = c->read_misses;
+    stats->write_misses = c->write_misses;
+    stats->decode_stalls = c->decode_stall_cycles;
+    stats->mem_stalls = c->mem_stall_cycles;
+    return true;
+}
+
+int32_t mesisim_read_register(const MesiSim* ms, int core, int reg) {
+    if (core < 0 || core >= NUM_CORES || reg < 0 || reg >= NUM_REGISTERS) return 0;
+    return ms->sim.cores[core].thread[0].regs[reg];
+}
+
+int32_t mesisim_read_memory(const MesiSim* ms, uint32_t addr) {
+    const Simulator* sim = &ms->sim;
+    addr &= MAIN_MEM_SIZE - 1;
+    uint32_t block_addr = cache_get_block_addr(addr);
+    int index = cache_get_index(addr);
+    int offset = cache_get_offset(addr);
+
+    for (int c = 0; c < NUM_CORES; c++) {
+        const Core* core = &sim->cores[c];
+        TSRAMEntry entry = CACHE_TSRAM(&core->cache, index);
+        if (TSRAM_MESI(entry) == MESI_MODIFIED && TSRAM_TAG(entry) == cache_get_tag(addr)) {
+            return core->cache.dsram[(index << BLOCK_OFFSET_BITS) | offset];
+        }
+        const WritebackBuffer* wb = &core->wb_buffer;
+        for (int i = 0; i < wb->count; i++) {
+            const WBEntry* e = &wb->entries[(wb->head + i) % WB_BUFFER_MAX_DEPTH];
+            if (e->block_addr == block_addr) return e->data[offset];
+        }
+    }
+    return sim->main_memory[addr];
+}
+
+bool mesisim_write_outputs(MesiSim* ms, const char* dir) {
+    if (!platform_mkdir(dir)) {
+        fprintf(stderr, "Error: Cannot create directory %s\n", dir);
+        return false;
+    }
+
+    SimFiles names, files;
+    char paths[5 * NUM_CORES + 1][512];
+    int n = 0;
+    sim_files_default(&names);
+    files = names;
+    files.memout = paths[n];
+    snprintf(paths[n++], sizeof(paths[0]), "%s/%s", dir, names.memout);
+    for (int i = 0; i < NUM_CORES; i++) {
+        files.regout[i] = paths[n];
+        snprintf(paths[n++], sizeof(paths[0]), "%s/%s", dir, names.regout[i]);
+        files.dsram[i] = paths[n];
+        snprintf(paths[n++], sizeof(paths[0]), "%s/%s", dir, names.dsram[i]);
+        files.tsram[i] = paths[n];
+        snprintf(paths[n++], sizeof(paths[0]), "%s/%s", dir, names.tsram[i]);
+        files.stats[i] = paths[n];
+        snprintf(paths[n++], sizeof(paths[0]), "%s/%s", dir, names.stats[i]);
+    }
+    write_outputs(&ms->sim, &files);
+    return true;
+}
@@ -0,0 +1,103 @@
+/*
+ * =============================================================================
+ * libmesisim - Embeddable Simulator API
+ * =============================================================================
+ * The whole model behind an opaque handle, for host programs that drive
+ * many simulations themselves (parameter sweeps, fuzzers, thread pools).
+ * - No global state: instances are independent, and different instances
+ *   may be used from different threads at the same time. One instance
+ *   must not be used by two threads at once.
+ * - No exit() and no stdout output; errors are return values (a deadlock
+ *   or cycle limit is also reported on stderr, as in the CLI).
+ * - Inputs come from memory buffers; files are only written on request.
+ *
+ * Build: compile every .c file in src with MESISIM_NO_MAIN defined, e.g.
+ *   cl /c /DMESISIM_NO_MAIN src\*.c && lib /OUT:mesisim.lib *.obj
+ * and include this header (it does not pull in sim.h).
+ * =============================================================================
+ */
+
+#ifndef MESISIM_H
+#define MESISIM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef struct MesiSim MesiSim;
+
+typedef enum {
+    MESISIM_RUNNING = 0,        // More cycles to simulate
+    MESISIM_DONE,               // Every core halted and drained
+    MESISIM_DEADLOCK,           // Every core asleep in BAR/MWAIT
+    MESISIM_CYCLE_LIMIT         // --max-cycles reached
+} MesiSimStatus;
+
+// The spec statistics of one core (stats<N>.txt)
+typedef struct {
+    uint64_t    cycles;
+    uint64_t    instructions;
+    uint64_t    read_hits;
+    uint64_t    write_hits;
+    uint64_t    read_misses;
+    uint64_t    write_misses;
+    uint64_t    decode_stalls;
+    uint64_t    mem_stalls;
+} MesiSimStats;
+
+// Cores per instance (compile-time, like the cache geometry)
+int mesisim_num_cores(void);
+
+// New instance with the spec configuration and empty memories, or NULL
+MesiSim* mesisim_create(void);
+void mesisim_destroy(MesiSim* sim);
+
+// Apply one command line model option, e.g. "--c2c", "--forward",
+// "--wb-buffer", "--max-cycles=0". Only before the first cycle; report
+// and verification options (--profile, --interval, --verify, ...) are
+// not available. Returns false if the option is rejected.
+bool mesisim_configure(MesiSim* sim, const char* option);
+
+// Load instruction words into a core's IMEM (hardware thread 0) or data
+// words into main memory at addr. Only before the first cycle.
+bool mesisim_load_imem(MesiSim* sim, int core, const uint32_t* words, int count);
+bool mesisim_load_memory(MesiSim* sim, uint32_t addr, const int32_t* words, int count);
+
+// Parse imem/memin text (one hex word per line) into words; returns the
+// word count, at most max
+int mesisim_parse_hex(const char* text, uint32_t* words, int max);
+
+// Simulate up to cycles clock cycles; returns how many were simulated
+// (fewer once the run is over)
+uint64_t mesisim_step(MesiSim* sim, uint64_t cycles);
+
+// Simulate until the run is over
+MesiSimStatus mesisim_run(MesiSim* sim);
+
+MesiSimStatus mesisim_status(const MesiSim* sim);
+
+// Clock cycles simulated so far
+uint64_t mesisim_cycles(const MesiSim* sim);
+
+// Statistics of one core; false if core is out of range
+bool mesisim_get_stats(const MesiSim* sim, int core, MesiSimStats* stats);
+
+// Register of a core's thread 0 (R0..R15), 0 if out of range
+int32_t mesisim_read_register(const MesiSim* sim, int core, int reg);
+
+// Memory word as the program sees it: a Modified cache line or queued
+// victim takes precedence over main memory
+int32_t mesisim_read_memory(const MesiSim* sim, uint32_t addr);
+
+// Write memout, regout, dsram, tsram and stats files into dir, named as
+// in the CLI. Dirty lines are copied to main memory first.
+bool mesisim_write_outputs(MesiSim* sim, const char* dir);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // MESISIM_H
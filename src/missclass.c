@@ -0,0 +1,174 @@
+/*
+ * =============================================================================
+ * Miss Classification (3C + Coherence)
+ * =============================================================================
+ * Optional (config.miss_classes, --miss-classes). Each counted miss is put
+ * in exactly one class, checked in this order:
+ * - upgrade:    write to a Shared line (BusRdX of a block already held)
+ * - coherence:  the block was last lost to a BusRdX snoop (invalidation tag)
+ * - compulsory: first reference to the block by this core (first-touch set)
+ * - capacity:   would also miss in a fully associative LRU cache of the
+ *               same capacity (shadow of CACHE_NUM_BLOCKS blocks)
+ * - conflict:   hits in the shadow, so only the direct mapping lost it;
+ *               also counted per set for the heatmap (conflicts.txt)
+ * The shadow sees every access, hits included. Bitmaps are one bit per
+ * 8-word block of main memory per core.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+#define MC_NUM_BLOCKS   (MAIN_MEM_SIZE / CACHE_BLOCK_SIZE)
+
+static const char* const miss_class_names[MISS_CLASS_COUNT] = {
+    "compulsory", "capacity", "conflict", "coherence", "upgrade"
+};
+
+static bool bit_test(uint8_t* map, uint32_t n) {
+    return (map[n >> 3] >> (n & 7)) & 1;
+}
+
+static void bit_set(uint8_t* map, uint32_t n, bool value) {
+    if (value) {
+        map[n >> 3] |= (uint8_t)(1 << (n & 7));
+    } else {
+        map[n >> 3] &= (uint8_t)~(1 << (n & 7));
+    }
+}
+
+// Move block to the MRU end of the shadow. Returns whether it was present.
+static bool shadow_touch(MissClassCore* mc, uint32_t block) {
+    int pos = -1;
+    for (int i = 0; i < mc->shadow_count; i++) {
+        if (mc->shadow[i] == block) {
+            pos = i;
+            break;
+        }
+    }
+    bool present = (pos >= 0);
+    if (!present) {
+        // Insert, dropping the LRU entry when full
+        pos = (mc->shadow_count < CACHE_NUM_BLOCKS) ? mc->shadow_count++ :
+                                                       CACHE_NUM_BLOCKS - 1;
+    }
+    memmove(&mc->shadow[1], &mc->shadow[0], sizeof(uint32_t) * pos);
+    mc->shadow[0] = block;
+    return present;
+}
+
+/* =============================================================================
+ * SETUP
+ * =============================================================================
+ */
+
+bool miss_class_init(Simulator* sim) {
+    bool ok = true;
+    sim->miss_class = (MissClassCore*)calloc(NUM_CORES, sizeof(MissClassCore));
+    for (int i = 0; i < NUM_CORES && sim->miss_class; i++) {
+        sim->miss_class[i].touched = (uint8_t*)calloc(MC_NUM_BLOCKS / 8, 1);
+        sim->miss_class[i].invalidated = (uint8_t*)calloc(MC_NUM_BLOCKS / 8, 1);
+        if (!sim->miss_class[i].touched || !sim->miss_class[i].invalidated) ok = false;
+    }
+    if (!sim->miss_class || !ok) {
+        fprintf(stderr, "Error: Failed to allocate miss classification\n");
+        miss_class_free(sim);
+        return false;
+    }
+    return true;
+}
+
+void miss_class_free(Simulator* sim) {
+    if (!sim->miss_class) return;
+    for (int i = 0; i < NUM_CORES; i++) {
+        free(sim->miss_class[i].touched);
+        free(sim->miss_class[i].invalidated);
+    }
+    free(sim->miss_class);
+    sim->miss_class = NULL;
+}
+
+/* =============================================================================
+ * COLLECTION HOOKS
+ * =============================================================================
+ */
+
+void miss_class_hit(Simulator* sim, Core* core, uint32_t addr) {
+    MissClassCore* mc = &sim->miss_class[core->core_id];
+    shadow_touch(mc, (addr & 0x1FFFFF) / CACHE_BLOCK_SIZE);
+}
+
+// A counted read/write miss; upgrade = the line is held Shared
+void miss_class_miss(Simulator* sim, Core* core, uint32_t addr, bool upgrade) {
+    MissClassCore* mc = &sim->miss_class[core->core_id];
+    uint32_t block = (addr & 0x1FFFFF) / CACHE_BLOCK_SIZE;
+    bool in_shadow = shadow_touch(mc, block);
+    MissClass kind;
+
+    if (upgrade) {
+        kind = MISS_UPGRADE;
+    } else if (bit_test(mc->invalidated, block)) {
+        kind = MISS_COHERENCE;
+    } else if (!bit_test(mc->touched, block)) {
+        kind = MISS_COMPULSORY;
+    } else if (!in_shadow) {
+        kind = MISS_CAPACITY;
+    } else {
+        kind = MISS_CONFLICT;
+        mc->set_conflicts[cache_get_index(addr)]++;
+    }
+    mc->misses[kind]++;
+    bit_set(mc->touched, block, true);
+    bit_set(mc->invalidated, block, false);
+}
+
+// core lost its copy of the block to another core's BusRdX
+void miss_class_invalidate(Simulator* sim, Core* core, uint32_t block_addr) {
+    MissClassCore* mc = &sim->miss_class[core->core_id];
+    bit_set(mc->invalidated, (block_addr & 0x1FFFFF) / CACHE_BLOCK_SIZE, true);
+}
+
+/* =============================================================================
+ * REPORT
+ * =============================================================================
+ */
+
+// Appended to statsN.txt
+void miss_class_write_stats(Simulator* sim, Core* core, OutputFile* out) {
+    MissClassCore* mc = &sim->miss_class[core->core_id];
+    for (int k = 0; k < MISS_CLASS_COUNT; k++) {
+        output_printf(out, "miss_%s %llu\n", miss_class_names[k], (unsigned long long)mc->misses[k]);
+    }
+}
+
+// Conflict misses per set and core, with a bar scaled to the worst set
+void miss_class_write_heatmap(Simulator* sim, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return;
+    }
+
+    uint64_t peak = 0;
+    for (int s = 0; s < CACHE_NUM_BLOCKS; s++) {
+        uint64_t total = 0;
+        for (int c = 0; c < NUM_CORES; c++) total += sim->miss_class[c].set_conflicts[s];
+        if (total > peak) peak = total;
+    }
+
+    fprintf(fp, "Conflict misses per cache set\n");
+    fprintf(fp, "%-4s", "set");
+    for (int c = 0; c < NUM_CORES; c++) fprintf(fp, " %7s%d", "core", c);
+    fprintf(fp, " %8s\n", "total");
+    for (int s = 0; s < CACHE_NUM_BLOCKS; s++) {
+        uint64_t total = 0;
+        fprintf(fp, "%-4d", s);
+        for (int c = 0; c < NUM_CORES; c++) {
+            uint64_t n = sim->miss_class[c].set_conflicts[s];
+            fprintf(fp, " %8llu", (unsigned long long)n);
+            total += n;
+        }
+        int bar = peak ? (int)((total * 40 + peak - 1) / peak) : 0;
+        fprintf(fp, " %8llu%s%.*s\n", (unsigned long long)total, bar ? " " : "", bar, "########################################");
+    }
+    fclose(fp);
+}
@@ -8,11 +8,17 @@
  * - Branch resolution in DECODE stage
  * - Delay slot: instruction after branch ALWAYS executes
  * - NO forwarding: register reads do NOT see same-cycle writes
+ *   (optional config.forwarding adds EX->EX, MEM->EX and WB->ID bypass
+ *   with a load-use interlock; branches still compare in decode)
  * - Register write in cycle N visible in cycle N+1
  * - R0 is hardwired to 0 (writes ignored)
  * - R1 = sign-extended immediate of currently decoded instruction
  * - Data hazards: stall in DECODE
  * - Cache miss: stall in MEM
+ * - FAA/CAS: read-modify-write in MEM while the line is held in M/E
+ * - BAR/MWAIT: wait in MEM with the core asleep (pipeline frozen)
+ *   (optional config.hw_threads > 1 parks the missing thread instead and
+ *   keeps fetching from the others, see MULTITHREADING below)
  * =============================================================================
  */
 
@@ -35,8 +41,8 @@ int get_dest_reg(PipelineLatch* latch) {
         return latch->inst.rd;
     }
     
-    // LW writes to rd
-    if (op == OP_LW) {
+    // LW, FAA and CAS (old memory value) write to rd
+    if (is_load_op(op)) {
         return latch->inst.rd;
     }
     
@@ -49,56 +55,114 @@ int get_dest_reg(PipelineLatch* latch) {
     return -1;
 }
 
-// Check if a register is being written by an instruction still in pipeline
-// (and the write hasn't completed yet)
-static bool is_reg_in_flight(Core* core, int reg) {
+bool is_atomic_op(uint8_t op) {
+    return op == OP_FAA || op == OP_CAS;
+}
+
+bool is_wait_op(uint8_t op) {
+    return op == OP_BAR || op == OP_MWAIT;
+}
+
+// Instructions whose result is produced in MEM (not ready after EX)
+bool is_load_op(uint8_t op) {
+    return op == OP_LW || is_atomic_op(op);
+}
+
+// Does latch write reg of thread tid?
+static bool writes_reg(PipelineLatch* latch, int reg, int tid) {
+    return get_dest_reg(latch) == reg && latch->tid == tid;
+}
+
+// Youngest instruction of thread tid still in the pipeline that writes reg,
+// or NULL (the write hasn't completed yet)
+static PipelineLatch* reg_producer(Core* core, int reg, int tid) {
     // R0 is never a hazard (hardwired to 0)
     // R1 is special (immediate) - not a hazard from normal writes
-    if (reg <= 1) return false;
+    if (reg <= 1) return NULL;
     
     // Check ID_EX (will write in future)
-    if (get_dest_reg(&core->ID_EX) == reg) return true;
+    PipelineLatch* id_ex = CUR_LATCH(core, ID_EX);
+    if (writes_reg(id_ex, reg, tid)) return id_ex;
     
     // Check EX_MEM (will write in future)
-    if (get_dest_reg(&core->EX_MEM) == reg) return true;
+    PipelineLatch* ex_mem = CUR_LATCH(core, EX_MEM);
+    if (writes_reg(ex_mem, reg, tid)) return ex_mem;
     
-    // Check MEM_WB (will write this cycle, but not visible until next cycle)
-    if (get_dest_reg(&core->MEM_WB) == reg) return true;
+    // Check MEM_WB (writes this cycle, but not visible until next cycle)
+    PipelineLatch* mem_wb = CUR_LATCH(core, MEM_WB);
+    if (writes_reg(mem_wb, reg, tid)) return mem_wb;
     
-    return false;
+    return NULL;
 }
 
-// Check for data hazards requiring decode stall
-bool check_data_hazard(Core* core) {
-    if (!core->IF_ID.valid) return false;
+// Hazard on one source operand. in_decode: operand is consumed in ID
+// (branch compare/target), otherwise in EX (ALU, address, store data).
+static HazardKind operand_hazard(Core* core, bool forwarding, int reg, int tid,
+                                 bool in_decode) {
+    PipelineLatch* producer = reg_producer(core, reg, tid);
+    if (!producer) return HAZARD_NONE;
     
-    Instruction* inst = &core->IF_ID.inst;
+    bool is_load = is_load_op(producer->inst.opcode);
     
-    // Check rs dependency (used by most instructions)
-    if (inst->rs != 0 && inst->rs != 1) {
-        if (is_reg_in_flight(core, inst->rs)) return true;
-    }
+    // WB->ID bypass: this cycle's register write reaches decode
+    if (forwarding && producer == CUR_LATCH(core, MEM_WB)) return HAZARD_NONE;
     
-    // Check rt dependency (used by most instructions)
-    if (inst->rt != 0 && inst->rt != 1) {
-        if (is_reg_in_flight(core, inst->rt)) return true;
-    }
+    // Only WB->ID reaches decode, so branches wait for the register file
+    if (in_decode) return HAZARD_BRANCH;
+    
+    if (!forwarding) return is_load ? HAZARD_LOAD_USE : HAZARD_RAW;
+    
+    // Bypass covers everything except an LW directly ahead (data not
+    // ready until the end of its MEM cycle)
+    if (is_load && producer == CUR_LATCH(core, ID_EX)) return HAZARD_LOAD_USE;
+    return HAZARD_NONE;
+}
+
+// Source registers read by an instruction, in the order hazards are checked
+// (branch operands, then rs, rt, store data). in_decode[i] is true when the
+// operand is consumed in ID rather than EX. Returns the operand count.
+int get_source_regs(Instruction* inst, int regs[3], bool in_decode[3]) {
+    bool is_branch = (inst->opcode >= OP_BEQ && inst->opcode <= OP_JAL);
+    int n = 0;
     
     // For branches and JAL, also check rd (branch target is in rd)
-    if (inst->opcode >= OP_BEQ && inst->opcode <= OP_JAL) {
-        if (inst->rd != 0 && inst->rd != 1) {
-            if (is_reg_in_flight(core, inst->rd)) return true;
-        }
+    if (is_branch) {
+        regs[n] = inst->rd; in_decode[n++] = true;
+    }
+    
+    // rs and rt (used by most instructions)
+    regs[n] = inst->rs; in_decode[n++] = is_branch;
+    regs[n] = inst->rt; in_decode[n++] = is_branch;
+    
+    // For SW and atomics, check rd (data to store / add)
+    if (inst->opcode == OP_SW || is_atomic_op(inst->opcode)) {
+        regs[n] = inst->rd; in_decode[n++] = false;
     }
     
-    // For SW, check rd (data to store)
-    if (inst->opcode == OP_SW) {
-        if (inst->rd != 0 && inst->rd != 1) {
-            if (is_reg_in_flight(core, inst->rd)) return true;
+    return n;
+}
+
+// Check for data hazards requiring decode stall
+// Returns the first cause found, its register in stall_reg
+HazardKind check_data_hazard(Core* core, bool forwarding, int* stall_reg) {
+    PipelineLatch* if_id = CUR_LATCH(core, IF_ID);
+    *stall_reg = -1;
+    if (!if_id->valid) return HAZARD_NONE;
+    
+    int regs[3];
+    bool in_decode[3];
+    int n = get_source_regs(&if_id->inst, regs, in_decode);
+    
+    for (int i = 0; i < n; i++) {
+        HazardKind h = operand_hazard(core, forwarding, regs[i], if_id->tid,
+                                      in_decode[i]);
+        if (h != HAZARD_NONE) {
+            *stall_reg = regs[i];
+            return h;
         }
     }
     
-    return false;
+    return HAZARD_NONE;
 }
 
 /* =============================================================================
@@ -106,16 +170,22 @@ bool check_data_hazard(Core* core) {
  * =============================================================================
  */
 
-// Writeback stage - commits to register file
+// Writeback stage - commits latch to register file
 // Returns true if instruction completed (for instruction count)
-static bool do_writeback(Core* core) {
-    if (!core->MEM_WB.valid) return false;
+bool do_writeback(Core* core, PipelineLatch* latch) {
+    if (!latch->valid) return false;
     
-    Instruction* inst = &core->MEM_WB.inst;
+    Instruction* inst = &latch->inst;
+    HwThread* th = &core->thread[latch->tid];
+    th->instruction_count++;
     
-    // Check for HALT
+    // Check for HALT (the core halts with its last thread)
     if (inst->opcode == OP_HALT) {
+        th->halted = true;
         core->halted = true;
+        for (int t = 0; t < MAX_HW_THREADS; t++) {
+            if (!core->thread[t].halted) core->halted = false;
+        }
         return true;
     }
     
@@ -127,15 +197,17 @@ static bool do_writeback(Core* core) {
     switch (inst->opcode) {
         case OP_ADD: case OP_SUB: case OP_AND: case OP_OR:
         case OP_XOR: case OP_MUL: case OP_SLL: case OP_SRA: case OP_SRL:
-            value = core->MEM_WB.alu_result;
+            value = latch->alu_result;
             do_write = true;
             break;
         case OP_LW:
-            value = core->MEM_WB.mem_data;
+        case OP_FAA:
+        case OP_CAS:
+            value = latch->mem_data;
             do_write = true;
             break;
         case OP_JAL:
-            value = core->MEM_WB.alu_result;  // Return address
+            value = latch->alu_result;  // Return address
             dest = 15;  // JAL always writes to R15
             do_write = true;
             break;
@@ -145,30 +217,42 @@ static bool do_writeback(Core* core) {
     
     // Write to register (R0 and R1 writes ignored)
     if (do_write && dest >= 2) {
-        core->regs[dest] = value;
+        th->regs[dest] = value;
     }
     
     return true;  // Instruction completed
 }
 
-// Memory stage
+// Memory stage (ex_mem -> next_MEM_WB)
 // Returns true if completed without stall
-static bool do_mem(Core* core, Simulator* sim, PipelineLatch* next_MEM_WB) {
-    if (!core->EX_MEM.valid) {
+bool do_mem(Core* core, Simulator* sim, PipelineLatch* ex_mem, PipelineLatch* next_MEM_WB) {
+    if (!ex_mem->valid) {
         next_MEM_WB->valid = false;
         return true;
     }
     
     // Copy from EX_MEM
-    *next_MEM_WB = core->EX_MEM;
+    *next_MEM_WB = *ex_mem;
+    
+    // Multithreading: replay of a parked access, already performed
+    HwThread* th = &core->thread[ex_mem->tid];
+    if (th->replay_ready && ex_mem->pc == th->parked_op.pc) {
+        th->replay_ready = false;
+        next_MEM_WB->mem_data = th->replay_data;
+        return true;
+    }
     
     Instruction* inst = &next_MEM_WB->inst;
     uint32_t addr = (uint32_t)next_MEM_WB->alu_result & 0x1FFFFF;  // 21-bit address
     
     if (inst->opcode == OP_LW) {
         int32_t data;
-        if (cache_read(core, sim, addr, &data)) {
+        bool done = cache_read(core, sim, addr, &data);
+        if (sim->mem_trace) mem_trace_access(sim, core, MEM_REF_READ, addr, done);
+        if (done) {
             next_MEM_WB->mem_data = data;
+            if (sim->sharing) sharing_access(sim, core->core_id, addr, false);
+            if (sim->stack_dist) stack_dist_access(sim, core->core_id, addr);
             return true;
         } else {
             // Cache miss - stall
@@ -177,28 +261,87 @@ static bool do_mem(Core* core, Simulator* sim, PipelineLatch* next_MEM_WB) {
         }
     } else if (inst->opcode == OP_SW) {
         int32_t data = next_MEM_WB->rd_val;
-        if (cache_write(core, sim, addr, data)) {
+        bool done = cache_write(core, sim, addr, data);
+        if (sim->mem_trace) mem_trace_access(sim, core, MEM_REF_WRITE, addr, done);
+        if (done) {
+            if (sim->sharing) sharing_access(sim, core->core_id, addr, true);
+            if (sim->stack_dist) stack_dist_access(sim, core->core_id, addr);
             return true;
         } else {
             // Cache miss - stall
             next_MEM_WB->valid = false;
             return false;
         }
+    } else if (is_atomic_op(inst->opcode)) {
+        int32_t old;
+        bool done = cache_atomic(core, sim, inst, addr, next_MEM_WB->rd_val,
+                                 next_MEM_WB->rt_val, &old);
+        if (sim->mem_trace) mem_trace_access(sim, core, MEM_REF_ATOMIC, addr, done);
+        if (done) {
+            next_MEM_WB->mem_data = old;
+            if (sim->sharing) sharing_access(sim, core->core_id, addr, true);
+            if (sim->stack_dist) stack_dist_access(sim, core->core_id, addr);
+            return true;
+        } else {
+            // Waiting for exclusive ownership - stall
+            next_MEM_WB->valid = false;
+            return false;
+        }
+    } else if (inst->opcode == OP_BAR) {
+        if (!barrier_wait(core, sim)) {
+            next_MEM_WB->valid = false;
+            return false;
+        }
+    } else if (inst->opcode == OP_MWAIT) {
+        if (!monitor_wait(core, addr)) {
+            next_MEM_WB->valid = false;
+            return false;
+        }
     }
     
     return true;
 }
 
-// Execute stage
-static void do_execute(Core* core, PipelineLatch* next_EX_MEM) {
-    if (!core->ID_EX.valid) {
+// Bypass network: value of reg as seen by the instruction entering EX.
+// EX->EX from the instruction now in MEM, MEM->EX from the one completing
+// WB this cycle, otherwise the register file (already holds WB's write).
+static int32_t forward_operand(Core* core, PipelineLatch* completing, 
+                               int reg, int tid, int32_t decoded) {
+    if (reg <= 1) return decoded;   // R0 = 0, R1 = this instruction's immediate
+    
+    PipelineLatch* ex_mem = CUR_LATCH(core, EX_MEM);
+    if (writes_reg(ex_mem, reg, tid) && !is_load_op(ex_mem->inst.opcode)) {
+        return ex_mem->alu_result;
+    }
+    if (writes_reg(completing, reg, tid)) {
+        return is_load_op(completing->inst.opcode) ? completing->mem_data : 
+                                                     completing->alu_result;
+    }
+    return core->thread[tid].regs[reg];
+}
+
+// Execute stage (id_ex -> next_EX_MEM)
+// completing: latch committing in WB this cycle, for the bypass network
+void do_execute(Core* core, Simulator* sim, PipelineLatch* completing,
+                PipelineLatch* id_ex, PipelineLatch* next_EX_MEM) {
+    if (!id_ex->valid) {
         next_EX_MEM->valid = false;
         return;
     }
     
-    *next_EX_MEM = core->ID_EX;
+    *next_EX_MEM = *id_ex;
     
     Instruction* inst = &next_EX_MEM->inst;
+    int tid = next_EX_MEM->tid;
+    
+    if (sim->config.forwarding) {
+        next_EX_MEM->rs_val = forward_operand(core, completing, inst->rs, tid, next_EX_MEM->rs_val);
+        next_EX_MEM->rt_val = forward_operand(core, completing, inst->rt, tid, next_EX_MEM->rt_val);
+        if (inst->opcode == OP_SW || is_atomic_op(inst->opcode)) {
+            next_EX_MEM->rd_val = forward_operand(core, completing, inst->rd, tid, next_EX_MEM->rd_val);
+        }
+    }
+    
     int32_t rs = next_EX_MEM->rs_val;
     int32_t rt = next_EX_MEM->rt_val;
     int32_t result = 0;
@@ -215,9 +358,18 @@ static void do_execute(Core* core, PipelineLatch* next_EX_MEM) {
         case OP_SRL: result = (int32_t)((uint32_t)rs >> (rt & 0x1F)); break;
         case OP_LW:
         case OP_SW:
+        case OP_FAA:
             // Effective address = rs + rt (word address)
             result = rs + rt;
             break;
+        case OP_CAS:
+            // Address = rs, rt is the expected value
+            result = rs;
+            break;
+        case OP_MWAIT:
+            // Monitored address = rs + rt
+            result = rs + rt;
+            break;
         case OP_JAL:
             // Return address already computed in decode
             result = next_EX_MEM->alu_result;
@@ -229,42 +381,38 @@ static void do_execute(Core* core, PipelineLatch* next_EX_MEM) {
     next_EX_MEM->alu_result = result;
 }
 
-// Decode stage - also resolves branches
-// Returns true if branch taken, target in branch_target
-static bool do_decode(Core* core, Simulator* sim, PipelineLatch* next_ID_EX, 
-                      uint32_t* branch_target) {
+// Count one decode stall cycle against its cause
+void count_decode_stall(Core* core, HazardKind hazard) {
+    core->decode_stall_cycles++;
+    switch (hazard) {
+        case HAZARD_RAW:      core->stall_raw_cycles++; break;
+        case HAZARD_LOAD_USE: core->stall_load_use_cycles++; break;
+        case HAZARD_BRANCH:   core->stall_branch_cycles++; break;
+        default: break;
+    }
+}
+
+// Read operands of if_id into next_ID_EX and resolve branches (hazards
+// already checked). Returns true if branch taken, target in branch_target.
+bool decode_issue(Core* core, PipelineLatch* if_id, PipelineLatch* next_ID_EX,
+                  uint32_t* branch_target) {
     bool branch_taken = false;
     *branch_target = 0;
     
-    if (!core->IF_ID.valid) {
-        next_ID_EX->valid = false;
-        return false;
-    }
-    
-    // Check data hazard
-    if (check_data_hazard(core)) {
-        core->decode_stall = true;
-        core->decode_stall_cycles++;
-        // Insert bubble (NOP) into ID_EX
-        next_ID_EX->valid = false;
-        return false;
-    }
-    
-    core->decode_stall = false;
-    
     // Move IF_ID to ID_EX
-    *next_ID_EX = core->IF_ID;
+    *next_ID_EX = *if_id;
     
     Instruction* inst = &next_ID_EX->inst;
+    int32_t* regs = core->thread[if_id->tid].regs;
     
     // Update R1 with sign-extended immediate (per spec, for EVERY instruction decoded)
-    core->regs[1] = inst->immediate;
+    regs[1] = inst->immediate;
     
     // Read register values (using current register values)
     // R0 always reads as 0, R1 reads as immediate (just updated above)
-    next_ID_EX->rs_val = (inst->rs == 0) ? 0 : core->regs[inst->rs];
-    next_ID_EX->rt_val = (inst->rt == 0) ? 0 : core->regs[inst->rt];
-    next_ID_EX->rd_val = (inst->rd == 0) ? 0 : core->regs[inst->rd];
+    next_ID_EX->rs_val = (inst->rs == 0) ? 0 : regs[inst->rs];
+    next_ID_EX->rt_val = (inst->rt == 0) ? 0 : regs[inst->rt];
+    next_ID_EX->rd_val = (inst->rd == 0) ? 0 : regs[inst->rd];
     
     // Branch resolution in decode
     int32_t rs = next_ID_EX->rs_val;
@@ -287,7 +435,7 @@ static bool do_decode(Core* core, Simulator* sim, PipelineLatch* next_ID_EX,
             // Since IF_ID.pc is JAL's PC, return address = IF_ID.pc + 1
             // But delay slot executes, so it's actually IF_ID.pc + 2? No...
             // Per spec: JAL stores PC+1 in R15, where PC is JAL's address
-            next_ID_EX->alu_result = (core->IF_ID.pc + 1) & PC_MASK;
+            next_ID_EX->alu_result = (if_id->pc + 1) & PC_MASK;
             break;
         default:
             break;
@@ -300,119 +448,288 @@ static bool do_decode(Core* core, Simulator* sim, PipelineLatch* next_ID_EX,
     return branch_taken;
 }
 
-// Fetch stage
-static void do_fetch(Core* core, PipelineLatch* next_IF_ID) {
-    if (core->halted || !core->fetch_enabled) {
+// Decode stage - also resolves branches
+// Returns true if branch taken, target in branch_target
+static bool do_decode(Core* core, Simulator* sim, PipelineLatch* next_ID_EX, 
+                      uint32_t* branch_target) {
+    PipelineLatch* if_id = CUR_LATCH(core, IF_ID);
+    *branch_target = 0;
+    
+    if (!if_id->valid) {
+        next_ID_EX->valid = false;
+        return false;
+    }
+    
+    // Check data hazard
+    int stall_reg;
+    HazardKind hazard = check_data_hazard(core, sim->config.forwarding, &stall_reg);
+    if (hazard != HAZARD_NONE) {
+        core->decode_stall = true;
+        count_decode_stall(core, hazard);
+        if (sim->profile) profile_decode_stall(sim, core, if_id, stall_reg);
+        core->thread[if_id->tid].decode_stall_cycles++;
+        // Insert bubble (NOP) into ID_EX
+        next_ID_EX->valid = false;
+        return false;
+    }
+    
+    core->decode_stall = false;
+    
+    return decode_issue(core, if_id, next_ID_EX, branch_target);
+}
+
+// Fetch stage (from core->fetch_thread)
+void do_fetch(Core* core, PipelineLatch* next_IF_ID) {
+    HwThread* th = &core->thread[core->fetch_thread];
+    
+    if (th->halted || th->parked || !core->fetch_enabled) {
         next_IF_ID->valid = false;
         return;
     }
     
     // Fetch from IMEM
-    if (core->pc < IMEM_DEPTH) {
+    if (th->pc < IMEM_DEPTH) {
         next_IF_ID->valid = true;
-        next_IF_ID->pc = core->pc;
-        next_IF_ID->inst = decode_instruction(core->imem[core->pc]);
+        next_IF_ID->pc = th->pc;
+        next_IF_ID->tid = (uint8_t)core->fetch_thread;
+        next_IF_ID->inst = decode_instruction(th->imem[th->pc]);
     } else {
         next_IF_ID->valid = false;
     }
 }
 
+// Advance the fetching thread's PC past the instruction just fetched
+// (will be overwritten if a branch is taken this cycle)
+static void advance_pc(Core* core, PipelineLatch* fetched) {
+    HwThread* th = &core->thread[fetched->tid];
+    
+    if (th->resume_pending) {
+        th->pc = th->resume_next_pc;
+        th->resume_pending = false;
+    } else if (th->branch_pending) {
+        // Delay slot just fetched, now take the branch
+        th->pc = th->branch_target;
+        th->branch_pending = false;
+    } else {
+        th->pc = (th->pc + 1) & PC_MASK;
+    }
+    fetched->next_pc = th->pc;
+}
+
+/* =============================================================================
+ * MULTITHREADING (config.hw_threads > 1)
+ * =============================================================================
+ * Fine-grained multithreading: threads share the pipeline and cache, and
+ * every latch carries the tid of the thread that fetched it. A memory op
+ * that misses is dropped from MEM and its thread parked; younger
+ * instructions of that thread are squashed, the others keep flowing.
+ * The access itself is performed in the cycle the line arrives (a later
+ * snoop could take the line again before a refetched copy reached MEM);
+ * the thread then refetches the instruction, which picks up the result.
+ */
+
+// Start-of-cycle bookkeeping: complete the filled miss, wake its thread
+void mt_begin_cycle(Core* core, Simulator* sim) {
+    bool any_parked = false;
+    bool any_ready = false;
+    
+    int m = core->miss_thread;
+    if (m >= 0 && core->thread[m].parked && !core->waiting_for_bus) {
+        HwThread* th = &core->thread[m];
+        PipelineLatch done;
+        if (do_mem(core, sim, &th->parked_op, &done)) {
+            th->replay_ready = true;
+            th->replay_data = done.mem_data;
+        }
+        // Otherwise a new request was issued and the thread stays parked
+    }
+    
+    for (int t = 0; t < sim->config.hw_threads; t++) {
+        HwThread* th = &core->thread[t];
+        if (th->parked && !core->waiting_for_bus) th->parked = false;
+        if (th->parked) {
+            th->park_cycles++;
+            if (sim->profile) {
+                profile_mem_stall(sim, core, &th->parked_op,
+                                  t == core->miss_thread && core->bus_request_pending);
+            }
+            any_parked = true;
+        } else if (!th->halted) {
+            any_ready = true;
+        }
+    }
+    
+    // Memory latency the other threads could not hide
+    if (any_parked && !any_ready) core->mem_stall_cycles++;
+}
+
+// Pick the thread to fetch from this cycle
+void mt_select_thread(Core* core, Simulator* sim) {
+    int n = sim->config.hw_threads;
+    
+    // The thread whose miss just filled replays first
+    if (core->miss_thread >= 0 && !core->waiting_for_bus) {
+        int t = core->miss_thread;
+        core->miss_thread = -1;
+        if (!core->thread[t].halted) {
+            core->fetch_thread = t;
+            return;
+        }
+    }
+    
+    int start = core->fetch_thread;
+    if (sim->config.mt_policy == MT_ROUND_ROBIN) start++;
+    
+    for (int i = 0; i < n; i++) {
+        int t = (start + i) % n;
+        if (!core->thread[t].halted && !core->thread[t].parked) {
+            core->fetch_thread = t;
+            return;
+        }
+    }
+    // Nothing ready: do_fetch finds the current thread halted or parked
+}
+
+// Take a missing memory op out of MEM and park its thread
+void mt_park_thread(Core* core, PipelineLatch* miss) {
+    int tid = miss->tid;
+    HwThread* th = &core->thread[tid];
+    
+    th->parked = true;
+    th->parks++;
+    th->parked_op = *miss;
+    
+    // Refetch the miss, then continue with its program-order successor
+    th->pc = miss->pc;
+    th->resume_pending = true;
+    th->resume_next_pc = miss->next_pc;
+    th->branch_pending = false;     // next_pc already accounts for it
+    
+    // Squash younger instructions of the same thread
+    PipelineLatch* id_ex = CUR_LATCH(core, ID_EX);
+    PipelineLatch* if_id = CUR_LATCH(core, IF_ID);
+    if (id_ex->valid && id_ex->tid == tid) id_ex->valid = false;
+    if (if_id->valid && if_id->tid == tid) {
+        if_id->valid = false;
+        core->decode_stall = false;     // Nothing left to stall on
+    }
+    
+    // The store is performed by mt_begin_cycle once the block is in
+    core->pending_is_write = false;
+}
+
 /* =============================================================================
  * CORE CYCLE
  * =============================================================================
  * 
  * Pipeline timing (5 stages, in-order):
  * - All stages conceptually operate in parallel
- * - We compute next state, then update at end of cycle
+ * - Each stage reads the live latch and writes the spare buffer of the
+ *   next one in place; the slots that advanced flip at end of cycle
+ *   (a decode stall keeps IF_ID, a MEM stall keeps everything but MEM_WB)
  * - Register writes in WB visible next cycle
  * - Branch resolved in Decode, delay slot always executes
  */
 
 void core_cycle(Core* core, Simulator* sim) {
-    // Next state latches
-    PipelineLatch next_IF_ID = {0};
-    PipelineLatch next_ID_EX = {0};
-    PipelineLatch next_EX_MEM = {0};
-    PipelineLatch next_MEM_WB = {0};
+    if (sim->config.issue_width == 2) {
+        core_cycle_dual(core, sim);
+        return;
+    }
+    
+    PipelineLatch* if_id = CUR_LATCH(core, IF_ID);
+    PipelineLatch* id_ex = CUR_LATCH(core, ID_EX);
+    PipelineLatch* ex_mem = CUR_LATCH(core, EX_MEM);
+    PipelineLatch* mem_wb = CUR_LATCH(core, MEM_WB);    // Completes WB this cycle
+    PipelineLatch* next_IF_ID = NEXT_LATCH(core, IF_ID);
+    PipelineLatch* next_ID_EX = NEXT_LATCH(core, ID_EX);
+    PipelineLatch* next_EX_MEM = NEXT_LATCH(core, EX_MEM);
+    PipelineLatch* next_MEM_WB = NEXT_LATCH(core, MEM_WB);
     
     bool branch_taken = false;
     uint32_t branch_target = 0;
     bool mem_completed = true;
     bool inst_completed = false;
     
-    // Track what will complete WB this cycle (current MEM_WB before execution)
-    // This becomes WB_completed for the NEXT cycle's trace
-    PipelineLatch completing_this_cycle = core->MEM_WB;
-    
     // --- Execute stages (in reverse order for dependencies) ---
     
-    // WB: commits this cycle (updates registers)
-    inst_completed = do_writeback(core);
+    // WB: commits this cycle (updates registers). mem_wb is left valid:
+    // after the flip it is the trace's WB column.
+    inst_completed = do_writeback(core, mem_wb);
     if (inst_completed) {
         core->instruction_count++;
-        // Prevent re-committing the same instruction if MEM stage stalls.
-        core->MEM_WB.valid = false;
+        if (sim->profile) profile_commit(sim, core, mem_wb);
     }
     
     // MEM: may stall on cache miss
-    if (!core->mem_stall) {
-        mem_completed = do_mem(core, sim, &next_MEM_WB);
+    if (sim->config.hw_threads > 1) mt_begin_cycle(core, sim);
+    
+    // Threads park on misses; BAR/MWAIT put the whole core to sleep
+    if (sim->config.hw_threads > 1 && !core->mem_stall &&
+        !is_wait_op(ex_mem->inst.opcode)) {
+        bool issued = core->waiting_for_bus;
+        mem_completed = do_mem(core, sim, ex_mem, next_MEM_WB);
+        if (!mem_completed) {
+            if (!issued && core->waiting_for_bus) core->miss_thread = ex_mem->tid;
+            mt_park_thread(core, ex_mem);
+        }
+    } else if (!core->mem_stall) {
+        mem_completed = do_mem(core, sim, ex_mem, next_MEM_WB);
         if (!mem_completed) {
             core->mem_stall = true;
-            core->mem_stall_cycles++;
+            if (!core->sleeping) core->mem_stall_cycles++;
         }
     } else {
         // Already stalled - try again
-        mem_completed = do_mem(core, sim, &next_MEM_WB);
+        mem_completed = do_mem(core, sim, ex_mem, next_MEM_WB);
         if (mem_completed) {
             core->mem_stall = false;
-        } else {
+        } else if (!core->sleeping) {
             core->mem_stall_cycles++;
         }
     }
+    if (sim->profile && core->mem_stall && !core->sleeping) {
+        profile_mem_stall(sim, core, ex_mem, core->bus_request_pending);
+    }
     
-    // If MEM is stalled, freeze pipeline (EX, ID, IF don't advance)
+    // If MEM is stalled, freeze pipeline (EX, ID, IF don't advance).
+    // WB still completed, and do_mem left a bubble in next_MEM_WB.
     if (core->mem_stall) {
-        // WB still completed with the old MEM_WB, track it
-        core->WB_completed = completing_this_cycle;
+        core->latch_live ^= LATCH_BIT(MEM_WB);
         return;  // Pipeline frozen
     }
     
     // EX: compute result
-    do_execute(core, &next_EX_MEM);
+    do_execute(core, sim, mem_wb, id_ex, next_EX_MEM);
     
     // ID: decode and resolve branches
-    branch_taken = do_decode(core, sim, &next_ID_EX, &branch_target);
+    branch_taken = do_decode(core, sim, next_ID_EX, &branch_target);
     
-    // IF: fetch next instruction
+    // IF: fetch next instruction (IF_ID is kept when decode stalled)
     core->fetch_enabled = !core->decode_stall;
     
     if (core->fetch_enabled) {
-        do_fetch(core, &next_IF_ID);
-        // Advance PC (will be overwritten if branch taken)
-        if (!core->halted && core->pc < IMEM_DEPTH) {
-            core->pc = (core->pc + 1) & PC_MASK;
-        }
-    } else {
-        // Keep IF_ID when decode stalled
-        next_IF_ID = core->IF_ID;
+        if (sim->config.hw_threads > 1) mt_select_thread(core, sim);
+        do_fetch(core, next_IF_ID);
+        if (next_IF_ID->valid) advance_pc(core, next_IF_ID);
     }
     
     // Handle branch taken (with delay slot)
     if (branch_taken && !core->decode_stall) {
-        core->pc = branch_target;
+        HwThread* th = &core->thread[if_id->tid];
+        if (next_IF_ID->valid && next_IF_ID->tid == if_id->tid) {
+            // Delay slot fetched this cycle
+            th->pc = branch_target;
+            next_IF_ID->next_pc = branch_target;
+        } else {
+            // Another thread fetched: redirect after the delay slot
+            th->branch_pending = true;
+            th->branch_target = branch_target;
+        }
     }
     
-    // --- Update pipeline latches ---
-    core->WB_completed = completing_this_cycle;  // Track what completed WB
-    core->MEM_WB = next_MEM_WB;
-    core->EX_MEM = next_EX_MEM;
-    
-    if (!core->decode_stall) {
-        core->ID_EX = next_ID_EX;
-        core->IF_ID = next_IF_ID;
-    } else {
-        // Decode stall: bubble in ID_EX, keep IF_ID unchanged
-        core->ID_EX.valid = false;
-    }
+    // --- Advance pipeline latches ---
+    // Decode stall: do_decode put the bubble in next_ID_EX, IF_ID stays
+    core->latch_live ^= core->decode_stall ?
+        LATCH_BIT(MEM_WB) | LATCH_BIT(EX_MEM) | LATCH_BIT(ID_EX) : LATCH_ALL;
 }
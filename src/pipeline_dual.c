@@ -0,0 +1,232 @@
+/*
+ * =============================================================================
+ * Dual-Issue Pipeline Implementation
+ * =============================================================================
+ * 2-wide in-order variant of the 5-stage pipeline (config.issue_width = 2).
+ * Each stage holds up to two instructions: lane 0 (core->latch) is the
+ * older one, lane 1 (core->latch2) the younger.
+ *
+ * RULES:
+ * - IF_ID/IF_ID2 act as a 2-entry fetch buffer, refilled in program order
+ * - Decode issues slot 0, then slot 1 in the same cycle if:
+ *     - slot 1 does not read slot 0's destination
+ *     - slot 1 has no hazard against instructions already in flight
+ *     - at most one memory op (LW/SW/FAA/CAS/BAR/MWAIT) and one
+ *       branch/JAL per pair
+ *     - slot 0 is not HALT, and no HALT is in flight
+ * - Same hazard rules as the single-issue pipeline, without forwarding
+ * - Behind a HALT, issue one at a time until it commits, then drop the
+ *   fetch buffer, so the same instructions commit as with single issue
+ * - Branch resolution in DECODE; the delay slot (next instruction in
+ *   program order) always executes, everything fetched past it is dropped
+ * - WB commits lane 0 then lane 1, so the younger write wins
+ * - A cache miss in MEM freezes both lanes
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+/* =============================================================================
+ * HAZARD DETECTION
+ * =============================================================================
+ */
+
+// Youngest in-flight writer of reg in either lane, or NULL. MEM_WB
+// commits this cycle, but the write is not visible until the next.
+static PipelineLatch* dual_reg_producer(Core* core, int reg) {
+    if (reg <= 1) return NULL;
+
+    PipelineLatch* in_flight[6] = {
+        CUR_LATCH2(core, ID_EX), CUR_LATCH(core, ID_EX),
+        CUR_LATCH2(core, EX_MEM), CUR_LATCH(core, EX_MEM),
+        CUR_LATCH2(core, MEM_WB), CUR_LATCH(core, MEM_WB)
+    };
+    for (int i = 0; i < 6; i++) {
+        if (get_dest_reg(in_flight[i]) == reg) return in_flight[i];
+    }
+    return NULL;
+}
+
+// Hazard of a fetch-buffer entry against instructions already issued,
+// its register in stall_reg
+static HazardKind dual_data_hazard(Core* core, PipelineLatch* slot, int* stall_reg) {
+    int regs[3];
+    bool in_decode[3];
+    int n = get_source_regs(&slot->inst, regs, in_decode);
+
+    for (int i = 0; i < n; i++) {
+        PipelineLatch* producer = dual_reg_producer(core, regs[i]);
+        if (!producer) continue;
+        *stall_reg = regs[i];
+        if (in_decode[i]) return HAZARD_BRANCH;
+        return is_load_op(producer->inst.opcode) ? HAZARD_LOAD_USE : HAZARD_RAW;
+    }
+    return HAZARD_NONE;
+}
+
+// Does slot read register reg?
+static bool reads_reg(PipelineLatch* slot, int reg) {
+    int regs[3];
+    bool in_decode[3];
+    int n = get_source_regs(&slot->inst, regs, in_decode);
+
+    if (reg <= 1) return false;
+    for (int i = 0; i < n; i++) {
+        if (regs[i] == reg) return true;
+    }
+    return false;
+}
+
+static bool is_mem_op(uint8_t op) {
+    return op == OP_LW || op == OP_SW || is_atomic_op(op) || is_wait_op(op);
+}
+
+static bool is_branch_op(uint8_t op) {
+    return op >= OP_BEQ && op <= OP_JAL;
+}
+
+// Is a HALT issued but not yet committed? (MEM_WB commits this cycle)
+static bool halt_in_flight(Core* core) {
+    PipelineLatch* in_flight[6] = {
+        CUR_LATCH(core, ID_EX), CUR_LATCH2(core, ID_EX),
+        CUR_LATCH(core, EX_MEM), CUR_LATCH2(core, EX_MEM),
+        CUR_LATCH(core, MEM_WB), CUR_LATCH2(core, MEM_WB)
+    };
+    for (int i = 0; i < 6; i++) {
+        if (in_flight[i]->valid && in_flight[i]->inst.opcode == OP_HALT) return true;
+    }
+    return false;
+}
+
+/* =============================================================================
+ * DUAL-ISSUE CORE CYCLE
+ * =============================================================================
+ */
+
+void core_cycle_dual(Core* core, Simulator* sim) {
+    // Live latches and the spare buffers written this cycle, [0] = lane 0
+    PipelineLatch* slot[2] = { CUR_LATCH(core, IF_ID), CUR_LATCH2(core, IF_ID) };
+    PipelineLatch* id_ex[2] = { CUR_LATCH(core, ID_EX), CUR_LATCH2(core, ID_EX) };
+    PipelineLatch* ex_mem[2] = { CUR_LATCH(core, EX_MEM), CUR_LATCH2(core, EX_MEM) };
+    PipelineLatch* completing[2] = { CUR_LATCH(core, MEM_WB), CUR_LATCH2(core, MEM_WB) };
+    PipelineLatch* queue[2] = { NEXT_LATCH(core, IF_ID), NEXT_LATCH2(core, IF_ID) };
+    PipelineLatch* next_ID_EX[2] = { NEXT_LATCH(core, ID_EX), NEXT_LATCH2(core, ID_EX) };
+    PipelineLatch* next_EX_MEM[2] = { NEXT_LATCH(core, EX_MEM), NEXT_LATCH2(core, EX_MEM) };
+    PipelineLatch* next_MEM_WB[2] = { NEXT_LATCH(core, MEM_WB), NEXT_LATCH2(core, MEM_WB) };
+
+    // WB: lane 0 first, so lane 1 (younger) wins on the same register
+    for (int lane = 0; lane < 2; lane++) {
+        if (do_writeback(core, completing[lane])) {
+            core->instruction_count++;
+            if (sim->profile) profile_commit(sim, core, completing[lane]);
+        }
+    }
+
+    // MEM: at most one lane holds a memory op; a miss freezes both lanes.
+    // The non-memory lane is simply re-copied on retry.
+    bool mem_completed = do_mem(core, sim, ex_mem[0], next_MEM_WB[0]) &&
+                         do_mem(core, sim, ex_mem[1], next_MEM_WB[1]);
+    if (!mem_completed) {
+        core->mem_stall = true;
+        if (!core->sleeping) core->mem_stall_cycles++;
+        if (sim->profile && !core->sleeping) {
+            PipelineLatch* lane = is_mem_op(ex_mem[0]->inst.opcode) ? ex_mem[0] : ex_mem[1];
+            profile_mem_stall(sim, core, lane, core->bus_request_pending);
+        }
+        // Bubbles into MEM_WB; WB still completed
+        next_MEM_WB[0]->valid = false;
+        next_MEM_WB[1]->valid = false;
+        core->latch_live ^= LATCH_BIT(MEM_WB);
+        core->latch_live2 ^= LATCH_BIT(MEM_WB);
+        return;  // Pipeline frozen
+    }
+    core->mem_stall = false;
+
+    // EX: both lanes
+    do_execute(core, sim, completing[0], id_ex[0], next_EX_MEM[0]);
+    do_execute(core, sim, completing[1], id_ex[1], next_EX_MEM[1]);
+
+    // ID: issue up to two instructions from the fetch buffer
+    int issued = 0;
+    bool branch_taken = false;
+    bool delay_slot_issued = false;
+    uint32_t branch_target = 0;
+    bool halting = halt_in_flight(core);
+
+    // The HALT has committed: nothing behind it issues
+    if (core->thread[0].halted && !halting) {
+        slot[0]->valid = false;
+        slot[1]->valid = false;
+    }
+
+    next_ID_EX[0]->valid = false;
+    next_ID_EX[1]->valid = false;
+    if (slot[0]->valid) {
+        int stall_reg = -1;
+        HazardKind hazard = dual_data_hazard(core, slot[0], &stall_reg);
+        if (hazard != HAZARD_NONE) {
+            core->decode_stall = true;
+            count_decode_stall(core, hazard);
+            if (sim->profile) profile_decode_stall(sim, core, slot[0], stall_reg);
+        } else {
+            core->decode_stall = false;
+            branch_taken = decode_issue(core, slot[0], next_ID_EX[0], &branch_target);
+            issued = 1;
+
+            if (slot[1]->valid) {
+                uint8_t op0 = slot[0]->inst.opcode;
+                uint8_t op1 = slot[1]->inst.opcode;
+
+                if (op0 == OP_HALT || halting ||
+                    (is_mem_op(op0) && is_mem_op(op1)) ||
+                    (is_branch_op(op0) && is_branch_op(op1))) {
+                    core->pair_break_struct++;
+                } else if (reads_reg(slot[1], get_dest_reg(slot[0])) ||
+                           dual_data_hazard(core, slot[1], &stall_reg) != HAZARD_NONE) {
+                    core->pair_break_dep++;
+                } else {
+                    uint32_t target1;
+                    bool taken1 = decode_issue(core, slot[1], next_ID_EX[1], &target1);
+                    issued = 2;
+                    if (branch_taken) {
+                        delay_slot_issued = true;
+                    } else if (taken1) {
+                        branch_taken = true;
+                        branch_target = target1;
+                    }
+                }
+            }
+        }
+    }
+
+    if (issued == 2) {
+        core->issue_dual_cycles++;
+    } else if (issued == 1) {
+        core->issue_single_cycles++;
+    }
+
+    // Fetch buffer (the spare IF_ID buffers): unissued entries, then
+    // refill in program order
+    int queued = 0;
+    for (int i = issued; i < 2; i++) {
+        if (slot[i]->valid) *queue[queued++] = *slot[i];
+    }
+    while (queued < 2) {
+        do_fetch(core, queue[queued]);
+        if (!queue[queued]->valid) break;
+        core->thread[0].pc = (core->thread[0].pc + 1) & PC_MASK;
+        queued++;
+    }
+    for (int i = queued; i < 2; i++) queue[i]->valid = false;
+
+    // Taken branch: keep only the delay slot, then redirect
+    if (branch_taken) {
+        int keep = delay_slot_issued ? 0 : 1;
+        for (int i = keep; i < 2; i++) queue[i]->valid = false;
+        core->thread[0].pc = branch_target;
+    }
+
+    // --- Advance pipeline latches ---
+    core->latch_live ^= LATCH_ALL;
+    core->latch_live2 ^= LATCH_ALL;
+}
@@ -0,0 +1,231 @@
+/*
+ * =============================================================================
+ * Host Platform Services - Windows and POSIX implementations
+ * =============================================================================
+ */
+
+// clock_gettime and posix_memalign under strict C (-std=c11); must come
+// before the first system header
+#ifndef _WIN32
+#define _POSIX_C_SOURCE 200809L
+#endif
+
+#include "platform.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifdef _WIN32
+
+#include <windows.h>
+#include <psapi.h>
+#include <malloc.h>
+#include <direct.h>
+#include <errno.h>
+#include <process.h>
+
+#pragma comment(lib, "psapi.lib")
+
+double platform_now(void) {
+    static LARGE_INTEGER freq;
+    LARGE_INTEGER now;
+    
+    if (freq.QuadPart == 0) QueryPerformanceFrequency(&freq);
+    QueryPerformanceCounter(&now);
+    return (double)now.QuadPart / (double)freq.QuadPart;
+}
+
+uint64_t platform_peak_rss(void) {
+    PROCESS_MEMORY_COUNTERS pmc;
+    if (!GetProcessMemoryInfo(GetCurrentProcess(), &pmc, sizeof(pmc))) return 0;
+    return (uint64_t)pmc.PeakWorkingSetSize;
+}
+
+void* platform_aligned_calloc(size_t size, size_t align) {
+    void* p = _aligned_malloc(size, align);
+    if (p) memset(p, 0, size);
+    return p;
+}
+
+void platform_aligned_free(void* p) {
+    _aligned_free(p);
+}
+
+bool platform_mkdir(const char* path) {
+    return _mkdir(path) == 0 || errno == EEXIST;
+}
+
+int platform_cpu_count(void) {
+    SYSTEM_INFO info;
+    GetSystemInfo(&info);
+    return info.dwNumberOfProcessors > 0 ? (int)info.dwNumberOfProcessors : 1;
+}
+
+int platform_list_dirs(const char* dir, char (*names)[PLATFORM_NAME_MAX], int max) {
+    WIN32_FIND_DATAA data;
+    char pattern[MAX_PATH];
+    int count = 0;
+    
+    snprintf(pattern, sizeof(pattern), "%s\\*", dir);
+    HANDLE find = FindFirstFileA(pattern, &data);
+    if (find == INVALID_HANDLE_VALUE) return -1;
+    do {
+        if (!(data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY)) continue;
+        if (strcmp(data.cFileName, ".") == 0 || strcmp(data.cFileName, "..") == 0) continue;
+        size_t len = strlen(data.cFileName);
+        if (len >= PLATFORM_NAME_MAX || count >= max) continue;
+        memcpy(names[count++], data.cFileName, len + 1);
+    } while (FindNextFileA(find, &data));
+    FindClose(find);
+    return count;
+}
+
+typedef struct {
+    PlatformWorkerFn fn;
+    void*           arg;
+    int             worker;
+} WorkerStart;
+
+static unsigned __stdcall worker_main(void* p) {
+    WorkerStart* start = (WorkerStart*)p;
+    start->fn(start->arg, start->worker);
+    return 0;
+}
+
+long platform_fetch_add(volatile long* value, long add) {
+    return InterlockedExchangeAdd(value, add);
+}
+
+void platform_run_parallel(int workers, PlatformWorkerFn fn, void* arg) {
+    HANDLE* threads = (HANDLE*)calloc(workers, sizeof(HANDLE));
+    WorkerStart* starts = (WorkerStart*)calloc(workers, sizeof(WorkerStart));
+    
+    for (int w = 0; w < workers; w++) {
+        if (!threads || !starts) {
+            fn(arg, w);
+            continue;
+        }
+        starts[w].fn = fn;
+        starts[w].arg = arg;
+        starts[w].worker = w;
+        threads[w] = (HANDLE)_beginthreadex(NULL, 0, worker_main, &starts[w], 0, NULL);
+        if (!threads[w]) fn(arg, w);
+    }
+    for (int w = 0; w < workers && threads; w++) {
+        if (!threads[w]) continue;
+        WaitForSingleObject(threads[w], INFINITE);
+        CloseHandle(threads[w]);
+    }
+    free(threads);
+    free(starts);
+}
+
+#else
+
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <dirent.h>
+#include <pthread.h>
+
+double platform_now(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+uint64_t platform_peak_rss(void) {
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return (uint64_t)usage.ru_maxrss;           // bytes
+#else
+    return (uint64_t)usage.ru_maxrss * 1024;    // kilobytes
+#endif
+}
+
+void* platform_aligned_calloc(size_t size, size_t align) {
+    void* p = NULL;
+    if (posix_memalign(&p, align < sizeof(void*) ? sizeof(void*) : align, size) != 0) return NULL;
+    memset(p, 0, size);
+    return p;
+}
+
+void platform_aligned_free(void* p) {
+    free(p);
+}
+
+bool platform_mkdir(const char* path) {
+    return mkdir(path, 0755) == 0 || errno == EEXIST;
+}
+
+int platform_cpu_count(void) {
+    long n = sysconf(_SC_NPROCESSORS_ONLN);
+    return n > 0 ? (int)n : 1;
+}
+
+
+int platform_list_dirs(const char* dir, char (*names)[PLATFORM_NAME_MAX], int max) {
+    DIR* d = opendir(dir);
+    struct dirent* entry;
+    int count = 0;
+    
+    if (!d) return -1;
+    while ((entry = readdir(d)) != NULL) {
+        char path[1024];
+        struct stat st;
+        if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0) continue;
+        snprintf(path, sizeof(path), "%s/%s", dir, entry->d_name);
+        if (stat(path, &st) != 0 || !S_ISDIR(st.st_mode)) continue;
+        size_t len = strlen(entry->d_name);
+        if (len >= PLATFORM_NAME_MAX || count >= max) continue;
+        memcpy(names[count++], entry->d_name, len + 1);
+    }
+    closedir(d);
+    return count;
+}
+
+typedef struct {
+    PlatformWorkerFn fn;
+    void*           arg;
+    int             worker;
+} WorkerStart;
+
+static void* worker_main(void* p) {
+    WorkerStart* start = (WorkerStart*)p;
+    start->fn(start->arg, start->worker);
+    return NULL;
+}
+
+long platform_fetch_add(volatile long* value, long add) {
+    return __atomic_fetch_add(value, add, __ATOMIC_SEQ_CST);
+}
+
+void platform_run_parallel(int workers, PlatformWorkerFn fn, void* arg) {
+    pthread_t* threads = (pthread_t*)calloc(workers, sizeof(pthread_t));
+    bool* started = (bool*)calloc(workers, sizeof(bool));
+    WorkerStart* starts = (WorkerStart*)calloc(workers, sizeof(WorkerStart));
+    
+    for (int w = 0; w < workers; w++) {
+        if (!threads || !started || !starts) {
+            fn(arg, w);
+            continue;
+        }
+        starts[w].fn = fn;
+        starts[w].arg = arg;
+        starts[w].worker = w;
+        started[w] = (pthread_create(&threads[w], NULL, worker_main, &starts[w]) == 0);
+        if (!started[w]) fn(arg, w);
+    }
+    for (int w = 0; w < workers && started; w++) {
+        if (started[w]) pthread_join(threads[w], NULL);
+    }
+    free(threads);
+    free(started);
+    free(starts);
+}
+
+#endif
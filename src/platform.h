@@ -0,0 +1,50 @@
+/*
+ * =============================================================================
+ * Host Platform Services
+ * =============================================================================
+ * The few OS-specific calls the simulator needs outside plain C: a
+ * monotonic clock, peak memory use, aligned allocation, directories, the
+ * CPU count and a simple worker pool.
+ * Windows (cl) and POSIX implementations live in platform.c.
+ * =============================================================================
+ */
+
+#ifndef PLATFORM_H
+#define PLATFORM_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Monotonic wall clock in seconds (arbitrary origin)
+double platform_now(void);
+
+// Peak resident set size of this process in bytes, 0 if unknown
+uint64_t platform_peak_rss(void);
+
+// Zero-filled block starting on an align-byte boundary (a power of two),
+// NULL on failure. Release with platform_aligned_free.
+void* platform_aligned_calloc(size_t size, size_t align);
+void platform_aligned_free(void* p);
+
+// Create a directory; true if it exists afterwards
+bool platform_mkdir(const char* path);
+
+// Logical CPUs available to this process (at least 1)
+int platform_cpu_count(void);
+
+#define PLATFORM_NAME_MAX   64
+
+// Names of the subdirectories of dir (not "." or ".."), unsorted.
+// Returns how many were stored, at most max; -1 if dir cannot be read.
+int platform_list_dirs(const char* dir, char (*names)[PLATFORM_NAME_MAX], int max);
+
+// Atomically add to *value; returns the previous value
+long platform_fetch_add(volatile long* value, long add);
+
+// Run fn(arg, 0) .. fn(arg, workers - 1) on separate threads and wait for
+// all of them. A worker whose thread cannot be started runs inline.
+typedef void (*PlatformWorkerFn)(void* arg, int worker);
+void platform_run_parallel(int workers, PlatformWorkerFn fn, void* arg);
+
+#endif // PLATFORM_H
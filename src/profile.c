@@ -0,0 +1,217 @@
+/*
+ * =============================================================================
+ * Per-PC Profiler
+ * =============================================================================
+ * Optional (config.profile, --profile). Every commit and stall cycle is
+ * charged to the IMEM address of the instruction responsible:
+ * - exec:         instructions committed in WB
+ * - decode_stall: cycles held in decode, split by the producer register
+ * - mem stalls:   cycles in MEM waiting for a LW miss (read), a SW/atomic
+ *                 miss (write) or a SW/atomic on a Shared line (upgrade);
+ *                 for a multithreaded core, cycles the thread was parked
+ * - bus_wait:     part of the mem stall spent before the bus grant
+ * Counters live in one flat array indexed [core][thread][pc], so a hook is
+ * a few increments; callers skip the call when sim->profile is NULL.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+static PcProfile* profile_at(Simulator* sim, int core_id, int tid, uint32_t pc) {
+    size_t idx = ((size_t)core_id * MAX_HW_THREADS + tid) * IMEM_DEPTH + (pc & PC_MASK);
+    return &sim->profile[idx];
+}
+
+/* =============================================================================
+ * SETUP
+ * =============================================================================
+ */
+
+bool profile_init(Simulator* sim) {
+    size_t n = (size_t)NUM_CORES * MAX_HW_THREADS * IMEM_DEPTH;
+    sim->profile = (PcProfile*)calloc(n, sizeof(PcProfile));
+    if (!sim->profile) {
+        fprintf(stderr, "Error: Failed to allocate profile counters\n");
+        return false;
+    }
+    return true;
+}
+
+void profile_free(Simulator* sim) {
+    free(sim->profile);
+    sim->profile = NULL;
+}
+
+/* =============================================================================
+ * COLLECTION HOOKS
+ * =============================================================================
+ */
+
+void profile_commit(Simulator* sim, Core* core, PipelineLatch* latch) {
+    profile_at(sim, core->core_id, latch->tid, latch->pc)->exec++;
+}
+
+void profile_decode_stall(Simulator* sim, Core* core, PipelineLatch* latch, int reg) {
+    PcProfile* p = profile_at(sim, core->core_id, latch->tid, latch->pc);
+    p->decode_stall++;
+    if (reg >= 0 && reg < NUM_REGISTERS) p->stall_reg[reg]++;
+}
+
+// One cycle of latch waiting on the cache. bus_wait: its request is still
+// waiting for the grant.
+void profile_mem_stall(Simulator* sim, Core* core, PipelineLatch* latch, bool bus_wait) {
+    PcProfile* p = profile_at(sim, core->core_id, latch->tid, latch->pc);
+    uint8_t op = latch->inst.opcode;
+
+    if (is_wait_op(op)) return;     // BAR/MWAIT sleep, not a cache stall
+    if (op == OP_LW) {
+        p->mem_read++;
+    } else {
+        // SW/FAA/CAS: an upgrade if the line is here but only Shared
+        uint32_t addr = (uint32_t)latch->alu_result & 0x1FFFFF;
+        TSRAMEntry entry = CACHE_TSRAM(&core->cache, cache_get_index(addr));
+        if (TSRAM_MESI(entry) == MESI_SHARED && TSRAM_TAG(entry) == cache_get_tag(addr)) {
+            p->mem_upgrade++;
+        } else {
+            p->mem_write++;
+        }
+    }
+    if (bus_wait) p->bus_wait++;
+}
+
+/* =============================================================================
+ * DISASSEMBLER
+ * =============================================================================
+ * Same syntax as the .asm sources: "MNEMONIC Rd, Rs, Rt, imm"
+ */
+
+static const char* const op_names[] = {
+    "ADD", "SUB", "AND", "OR", "XOR", "MUL", "SLL", "SRA", "SRL",
+    "BEQ", "BNE", "BLT", "BGT", "BLE", "BGE", "JAL",
+    "LW", "SW", "FAA", "CAS", "HALT", NULL, "BAR", "MWAIT"
+};
+
+void disassemble(uint32_t raw, char* buf, size_t size) {
+    Instruction inst = decode_instruction(raw);
+    const char* name = (inst.opcode < sizeof(op_names) / sizeof(op_names[0])) ?
+                       op_names[inst.opcode] : NULL;
+
+    if (!name) {
+        snprintf(buf, size, ".word 0x%08X", raw);
+    } else if (inst.opcode == OP_HALT || inst.opcode == OP_BAR) {
+        snprintf(buf, size, "%s", name);
+    } else {
+        snprintf(buf, size, "%s R%d, R%d, R%d, %d", name, inst.rd, inst.rs,
+                 inst.rt, inst.immediate);
+    }
+}
+
+/* =============================================================================
+ * REPORT
+ * =============================================================================
+ */
+
+typedef struct {
+    int         tid;
+    uint32_t    pc;
+    uint64_t    cost;       // exec + stall cycles charged to the PC
+} HotSpot;
+
+static uint64_t mem_stall_total(PcProfile* p) {
+    return p->mem_read + p->mem_write + p->mem_upgrade;
+}
+
+static int compare_hotspots(const void* a, const void* b) {
+    const HotSpot* x = (const HotSpot*)a;
+    const HotSpot* y = (const HotSpot*)b;
+    if (x->cost != y->cost) return (x->cost < y->cost) ? 1 : -1;
+    if (x->tid != y->tid) return x->tid - y->tid;
+    return (int)x->pc - (int)y->pc;
+}
+
+// "R5:120", the producer register behind most decode stalls, or "-"
+static void format_stall_reg(PcProfile* p, char* buf, size_t size) {
+    int best = -1;
+    for (int r = 0; r < NUM_REGISTERS; r++) {
+        if (p->stall_reg[r] > 0 && (best < 0 || p->stall_reg[r] > p->stall_reg[best])) {
+            best = r;
+        }
+    }
+    if (best < 0) {
+        snprintf(buf, size, "-");
+    } else {
+        snprintf(buf, size, "R%d:%llu", best, (unsigned long long)p->stall_reg[best]);
+    }
+}
+
+void profile_write(Simulator* sim, Core* core, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return;
+    }
+
+    int threads = sim->config.hw_threads;
+    HotSpot* spots = (HotSpot*)malloc(sizeof(HotSpot) * MAX_HW_THREADS * IMEM_DEPTH);
+    int nspots = 0;
+
+    for (int t = 0; t < threads && spots; t++) {
+        for (uint32_t pc = 0; pc < IMEM_DEPTH; pc++) {
+            PcProfile* p = profile_at(sim, core->core_id, t, pc);
+            uint64_t cost = p->exec + p->decode_stall + mem_stall_total(p);
+            if (cost == 0) continue;
+            spots[nspots].tid = t;
+            spots[nspots].pc = pc;
+            spots[nspots].cost = cost;
+            nspots++;
+        }
+    }
+    if (spots) qsort(spots, nspots, sizeof(HotSpot), compare_hotspots);
+
+    fprintf(fp, "Profile: core %d (cycles %llu, instructions %llu)\n\n", core->core_id,
+            (unsigned long long)core->cycle_count, (unsigned long long)core->instruction_count);
+
+    // Hot spots, most expensive first
+    fprintf(fp, "Hot spots (exec + stall cycles)\n");
+    fprintf(fp, "%-4s %-2s %8s %8s %8s %8s %8s %8s  %-10s %s\n",
+            "PC", "T", "exec", "dstall", "rd_miss", "wr_miss", "upgrade",
+            "bus_wait", "stall_reg", "instruction");
+    for (int i = 0; i < nspots && i < PROFILE_HOTSPOTS; i++) {
+        PcProfile* p = profile_at(sim, core->core_id, spots[i].tid, spots[i].pc);
+        char reg[16], text[48];
+        format_stall_reg(p, reg, sizeof(reg));
+        disassemble(core->thread[spots[i].tid].imem[spots[i].pc], text, sizeof(text));
+        fprintf(fp, "%03X  %-2d %8llu %8llu %8llu %8llu %8llu %8llu  %-10s %s\n",
+                spots[i].pc, spots[i].tid, (unsigned long long)p->exec,
+                (unsigned long long)p->decode_stall, (unsigned long long)p->mem_read,
+                (unsigned long long)p->mem_write, (unsigned long long)p->mem_upgrade,
+                (unsigned long long)p->bus_wait, reg, text);
+    }
+    free(spots);
+
+    // Annotated disassembly up to the last non-zero word or profiled PC
+    for (int t = 0; t < threads; t++) {
+        HwThread* th = &core->thread[t];
+        int last = -1;
+        for (int pc = 0; pc < IMEM_DEPTH; pc++) {
+            PcProfile* p = profile_at(sim, core->core_id, t, pc);
+            if (th->imem[pc] != 0 || p->exec || p->decode_stall || mem_stall_total(p)) {
+                last = pc;
+            }
+        }
+        if (last < 0) continue;
+
+        fprintf(fp, "\nAnnotated disassembly, thread %d\n", t);
+        fprintf(fp, "%-4s %-8s  %-26s %8s %8s %8s %8s\n",
+                "PC", "raw", "instruction", "exec", "dstall", "mem", "bus_wait");
+        for (int pc = 0; pc <= last; pc++) {
+            PcProfile* p = profile_at(sim, core->core_id, t, pc);
+            char text[48];
+            disassemble(th->imem[pc], text, sizeof(text));
+            fprintf(fp, "%03X  %08X  %-26s %8llu %8llu %8llu %8llu\n", pc, th->imem[pc], text,
+                    (unsigned long long)p->exec, (unsigned long long)p->decode_stall,
+                    (unsigned long long)mem_stall_total(p), (unsigned long long)p->bus_wait);
+        }
+    }
+    fclose(fp);
+}
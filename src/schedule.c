@@ -0,0 +1,522 @@
+/*
+ * =============================================================================
+ * Static Instruction Scheduler
+ * =============================================================================
+ * Offline pass over one IMEM image (sim --schedule IN [OUT]). Decode stalls
+ * come from a consumer sitting too close to its producer: without
+ * forwarding a register is readable 4 decode cycles after its producer
+ * decoded (3 instructions in between), with --forward 1 cycle (2 after a
+ * load), and branch operands always need 4. The pass reorders independent
+ * instructions inside each basic block to cover that window and moves a
+ * useful instruction into a NOP branch delay slot, so the NOP can absorb
+ * a stall instead.
+ *
+ * Branch targets are register values, so instructions never change
+ * address across blocks: a block is permuted in place and keeps its
+ * branch (and delay slot) at the end. Each instruction carries its own
+ * immediate, so moving it keeps what it reads through R1.
+ * - Leaders: address 0, the instruction after each delay slot, JAL
+ *   return addresses, and every branch target that is a constant loaded
+ *   from R1 in the branch's block (or R1 itself). If any target cannot be
+ *   resolved, every immediate that is a valid address is also a leader.
+ * - Instructions after a HALT (still fetched and partly executed before
+ *   the core stops) and unknown opcodes are never moved.
+ * - Memory and synchronisation ops keep their relative order; register
+ *   RAW, WAR and WAW dependencies are kept (R0 and R1 carry none).
+ * The stall prediction is static: each block counted once, cache hits,
+ * a single thread and the fall-through block's first instructions.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+#define SCHED_MAX_BLOCK     64  // Longer straight-line runs are split
+#define SCHED_LOOKAHEAD     3   // Successor instructions in the cost model
+
+// One instruction with its register and memory footprint
+typedef struct {
+    uint32_t    raw;
+    Instruction inst;
+    int         dest;           // Register written (>= 2), or -1
+    int         src[3];         // Registers read (>= 2)
+    bool        src_decode[3];  // Operand consumed in ID (branches)
+    int         nsrc;
+    bool        mem;            // Memory access, BAR or MWAIT
+    bool        load;           // Result produced in MEM
+    bool        nop;            // No architectural effect
+    bool        known;          // Valid opcode
+} SchedInst;
+
+typedef struct {
+    SchedInst   code[IMEM_DEPTH];
+    int         len;
+    bool        leader[IMEM_DEPTH];
+    bool        frozen[IMEM_DEPTH];
+    bool        forwarding;
+    bool        unresolved;     // Some branch target was not a constant
+} SchedProgram;
+
+static bool is_branch_op(uint8_t op) {
+    return op >= OP_BEQ && op <= OP_JAL;
+}
+
+static void sched_decode(SchedInst* si, uint32_t raw) {
+    memset(si, 0, sizeof(*si));
+    si->raw = raw;
+    si->inst = decode_instruction(raw);
+    uint8_t op = si->inst.opcode;
+    si->known = op <= OP_MWAIT && op != OP_OUT;
+
+    PipelineLatch latch;
+    memset(&latch, 0, sizeof(latch));
+    latch.valid = true;
+    latch.inst = si->inst;
+    int dest = get_dest_reg(&latch);
+    si->dest = dest >= 2 ? dest : -1;
+
+    int regs[3];
+    bool in_decode[3];
+    int n = get_source_regs(&si->inst, regs, in_decode);
+    for (int i = 0; i < n; i++) {
+        if (regs[i] < 2) continue;
+        si->src[si->nsrc] = regs[i];
+        si->src_decode[si->nsrc++] = in_decode[i];
+    }
+
+    si->load = is_load_op(op);
+    si->mem = op == OP_LW || op == OP_SW || is_atomic_op(op) || is_wait_op(op);
+    si->nop = op <= OP_SRL && si->dest < 0;
+}
+
+/* =============================================================================
+ * BASIC BLOCKS
+ * =============================================================================
+ */
+
+static void mark_leader(SchedProgram* prog, int32_t pc) {
+    if (pc >= 0 && pc < prog->len) prog->leader[pc] = true;
+}
+
+// Constant target of the branch at b, or -1. The target register must be
+// set from R0/R1 by an instruction of the same block.
+static int32_t branch_target(SchedProgram* prog, int b) {
+    int rd = prog->code[b].inst.rd;
+    if (rd == 0) return 0;
+    if (rd == 1) return prog->code[b].inst.immediate & PC_MASK;
+
+    for (int pc = b - 1; pc >= 0; pc--) {
+        SchedInst* si = &prog->code[pc];
+        if (si->dest == rd) {
+            Instruction* in = &si->inst;
+            bool r0_r1 = (in->rs == 0 && in->rt == 1) || (in->rs == 1 && in->rt == 0);
+            if ((in->opcode == OP_ADD || in->opcode == OP_OR || in->opcode == OP_XOR) && r0_r1) {
+                return in->immediate & PC_MASK;
+            }
+            if (in->opcode == OP_SUB && in->rs == 1 && in->rt == 0) {
+                return in->immediate & PC_MASK;
+            }
+            return -1;
+        }
+        if (prog->leader[pc]) break;
+        if (pc >= 2 && is_branch_op(prog->code[pc - 2].inst.opcode)) break;
+    }
+    return -1;
+}
+
+// Leaders grow until stable: a new leader can cut a target's definition
+// off from its branch
+static void find_leaders(SchedProgram* prog) {
+    memset(prog->leader, 0, sizeof(prog->leader));
+    memset(prog->frozen, 0, sizeof(prog->frozen));
+    mark_leader(prog, 0);
+
+    bool changed = true;
+    while (changed) {
+        changed = false;
+        bool before[IMEM_DEPTH];
+        memcpy(before, prog->leader, sizeof(before));
+        prog->unresolved = false;
+
+        for (int pc = 0; pc < prog->len; pc++) {
+            SchedInst* si = &prog->code[pc];
+            if (!si->known) {
+                mark_leader(prog, pc);
+                mark_leader(prog, pc + 1);
+            } else if (si->inst.opcode == OP_HALT) {
+                mark_leader(prog, pc + 1);
+            } else if (is_branch_op(si->inst.opcode)) {
+                mark_leader(prog, pc + 2);
+                if (si->inst.opcode == OP_JAL) mark_leader(prog, pc + 1);
+                int32_t target = branch_target(prog, pc);
+                if (target >= 0) {
+                    mark_leader(prog, target);
+                } else if (si->inst.rd != 15) {
+                    prog->unresolved = true;
+                }
+            }
+        }
+        // R15 targets not set in the block are JAL returns, unless there is no JAL
+        bool has_jal = false;
+        for (int pc = 0; pc < prog->len; pc++) {
+            if (prog->code[pc].inst.opcode == OP_JAL) has_jal = true;
+        }
+        if (!has_jal) {
+            for (int pc = 0; pc < prog->len; pc++) {
+                SchedInst* si = &prog->code[pc];
+                if (is_branch_op(si->inst.opcode) && si->inst.rd == 15 &&
+                    branch_target(prog, pc) < 0) {
+                    prog->unresolved = true;
+                }
+            }
+        }
+        if (prog->unresolved) {
+            for (int pc = 0; pc < prog->len; pc++) {
+                mark_leader(prog, prog->code[pc].inst.immediate);
+            }
+        }
+        if (memcmp(before, prog->leader, sizeof(before)) != 0) changed = true;
+    }
+
+    // After a HALT, everything up to the next leader stays in place
+    for (int pc = 0; pc < prog->len; pc++) {
+        if (prog->code[pc].inst.opcode != OP_HALT) continue;
+        for (int i = pc + 1; i < prog->len && !prog->leader[i]; i++) {
+            prog->frozen[i] = true;
+        }
+    }
+    for (int pc = 0; pc < prog->len; pc++) {
+        if (!prog->code[pc].known) prog->frozen[pc] = true;
+    }
+}
+
+// End (exclusive) of the block starting at start
+static int block_end(SchedProgram* prog, int start) {
+    int pc = start;
+    while (pc < prog->len) {
+        SchedInst* si = &prog->code[pc];
+        if (prog->frozen[pc] != prog->frozen[start]) return pc;
+        if (si->inst.opcode == OP_HALT) return pc + 1;
+        if (is_branch_op(si->inst.opcode)) {
+            bool slot = pc + 1 < prog->len && !prog->leader[pc + 1];
+            return slot ? pc + 2 : pc + 1;
+        }
+        pc++;
+        if (pc < prog->len && prog->leader[pc]) return pc;
+        if (pc - start >= SCHED_MAX_BLOCK) return pc;
+    }
+    return pc;
+}
+
+/* =============================================================================
+ * COST MODEL
+ * =============================================================================
+ * Decode cycle of each instruction, in order, from register ready times.
+ * ready_ex/ready_id: first cycle a consumer may decode when it reads the
+ * register in EX or in ID.
+ */
+
+typedef struct {
+    int ready_ex[NUM_REGISTERS];
+    int ready_id[NUM_REGISTERS];
+    int cycle;                  // Decode cycle of the last instruction
+    int stalls;
+} SchedState;
+
+static void state_init(SchedState* st) {
+    memset(st, 0, sizeof(*st));
+    st->cycle = -1;
+}
+
+// Earliest decode cycle of si after the state's last instruction
+static int earliest(const SchedState* st, const SchedInst* si) {
+    int c = st->cycle + 1;
+    for (int i = 0; i < si->nsrc; i++) {
+        int r = si->src[i];
+        int ready = si->src_decode[i] ? st->ready_id[r] : st->ready_ex[r];
+        if (ready > c) c = ready;
+    }
+    return c;
+}
+
+static void issue(SchedState* st, const SchedInst* si, bool forwarding) {
+    int c = earliest(st, si);
+    st->stalls += c - st->cycle - 1;
+    st->cycle = c;
+    if (si->dest >= 0) {
+        st->ready_id[si->dest] = c + 4;
+        st->ready_ex[si->dest] = forwarding ? c + (si->load ? 2 : 1) : c + 4;
+    }
+}
+
+// Cycles and stalls of order[0..n). horizon also runs the first
+// instructions of the fall-through block, so results left late count.
+static void block_cost(SchedProgram* prog, const int* order, int n, int next,
+                       int* cycles, int* stalls, int* horizon) {
+    SchedState st;
+    state_init(&st);
+    for (int i = 0; i < n; i++) issue(&st, &prog->code[order[i]], prog->forwarding);
+    *cycles = st.cycle + 1;
+    *stalls = st.stalls;
+    for (int i = 0; i < SCHED_LOOKAHEAD && next >= 0 && next + i < prog->len; i++) {
+        issue(&st, &prog->code[next + i], prog->forwarding);
+    }
+    *horizon = st.cycle + 1;
+}
+
+/* =============================================================================
+ * LIST SCHEDULER
+ * =============================================================================
+ */
+
+// Must a keep its order before b (a earlier in program order)?
+static bool depends(const SchedInst* a, const SchedInst* b) {
+    if (a->mem && b->mem) return true;
+    for (int i = 0; i < b->nsrc; i++) {
+        if (b->src[i] == a->dest) return true;              // RAW
+    }
+    if (b->dest >= 0) {
+        if (b->dest == a->dest) return true;                // WAW
+        for (int i = 0; i < a->nsrc; i++) {
+            if (a->src[i] == b->dest) return true;          // WAR
+        }
+    }
+    return false;
+}
+
+typedef struct {
+    int  start, n;
+    int  term;                  // Index of the branch/HALT kept last, or -1
+    bool has_slot;              // Branch at n - 2, delay slot at n - 1
+    bool dep[SCHED_MAX_BLOCK + 1][SCHED_MAX_BLOCK + 1];
+    int  height[SCHED_MAX_BLOCK + 1];
+} SchedBlock;
+
+// Latency-weighted longest path from each instruction to the block end
+static void compute_heights(SchedProgram* prog, SchedBlock* blk) {
+    for (int i = blk->n - 1; i >= 0; i--) {
+        blk->height[i] = 0;
+        for (int j = i + 1; j < blk->n; j++) {
+            if (!blk->dep[i][j]) continue;
+            int lat = prog->forwarding ? 1 : 4;
+            if (prog->code[blk->start + i].load && prog->forwarding) lat = 2;
+            if (blk->height[j] + lat > blk->height[i]) blk->height[i] = blk->height[j] + lat;
+        }
+    }
+}
+
+// New order (block offsets) for the block; returns the delay slot filler
+// offset or -1
+static int list_schedule(SchedProgram* prog, SchedBlock* blk, int* order) {
+    int n = blk->n;
+    int slot_node = -1;
+    int branch = blk->term;
+
+    // Pick a delay slot filler: an instruction nothing after it depends
+    // on, the branch included. Memory ops are not delayed: a later lock
+    // release or store costs the other cores more than the slot saves.
+    int filler = -1;
+    if (blk->has_slot && prog->code[blk->start + n - 1].nop) {
+        for (int i = n - 3; i >= 0; i--) {
+            SchedInst* si = &prog->code[blk->start + i];
+            if (si->nop || si->mem) continue;
+            bool free = true;
+            for (int j = i + 1; j < n && free; j++) {
+                if (blk->dep[i][j]) free = false;
+            }
+            if (free) { filler = i; break; }
+        }
+    }
+    if (blk->has_slot) slot_node = filler >= 0 ? filler : n - 1;
+
+    bool placed[SCHED_MAX_BLOCK + 1] = {false};
+    int body = n - (branch >= 0 ? 1 : 0) - (blk->has_slot ? 1 : 0);
+    SchedState st;
+    state_init(&st);
+
+    for (int p = 0; p < body; p++) {
+        int best = -1, best_c = 0;
+        for (int i = 0; i < n; i++) {
+            if (placed[i] || i == branch || i == slot_node) continue;
+            bool ready = true;
+            for (int j = 0; j < i && ready; j++) {
+                if (blk->dep[j][i] && !placed[j]) ready = false;
+            }
+            if (!ready) continue;
+            SchedInst* si = &prog->code[blk->start + i];
+            int c = earliest(&st, si);
+            if (best < 0 || c < best_c) {
+                best = i; best_c = c;
+                continue;
+            }
+            if (c > best_c) continue;
+            SchedInst* bi = &prog->code[blk->start + best];
+            // Same cycle: useful work before NOPs, memory ops first (misses
+            // start sooner, lock releases are not delayed), then the
+            // critical path
+            if (bi->nop != si->nop) {
+                if (bi->nop) best = i;
+            } else if (bi->mem != si->mem) {
+                if (si->mem) best = i;
+            } else if (blk->height[i] > blk->height[best]) {
+                best = i;
+            }
+        }
+        placed[best] = true;
+        order[p] = best;
+        issue(&st, &prog->code[blk->start + best], prog->forwarding);
+    }
+
+    int p = body;
+    if (branch >= 0) order[p++] = branch;
+    if (slot_node >= 0) order[p++] = slot_node;
+    return filler;
+}
+
+/* =============================================================================
+ * DRIVER
+ * =============================================================================
+ */
+
+static bool read_imem(const char* filename, SchedProgram* prog) {
+    FILE* fp = fopen(filename, "r");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot open IMEM file %s\n", filename);
+        return false;
+    }
+    char line[64];
+    prog->len = 0;
+    while (fgets(line, sizeof(line), fp) && prog->len < IMEM_DEPTH) {
+        char* p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\n' || *p == '\r' || *p == '\0') continue;
+        uint32_t raw;
+        if (sscanf(p, "%x", &raw) == 1) sched_decode(&prog->code[prog->len++], raw);
+    }
+    fclose(fp);
+    return true;
+}
+
+static void print_block(SchedProgram* prog, SchedBlock* blk, const int* order) {
+    for (int i = 0; i < blk->n; i++) {
+        char text[64];
+        disassemble(prog->code[blk->start + i].raw, text, sizeof(text));
+        int from = blk->start + order[i];
+        if (from != blk->start + i) {
+            printf("    %03X  (was %03X)  %s\n", blk->start + i, from, text);
+        } else {
+            printf("    %03X             %s\n", blk->start + i, text);
+        }
+    }
+}
+
+int schedule_imem(const SimConfig* config, const char* in_file, const char* out_file) {
+    SchedProgram* prog = (SchedProgram*)calloc(1, sizeof(SchedProgram));
+    SchedBlock* blk = (SchedBlock*)malloc(sizeof(SchedBlock));
+    if (!prog || !blk) {
+        fprintf(stderr, "Error: Failed to allocate scheduler\n");
+        free(prog);
+        free(blk);
+        return 1;
+    }
+    if (!read_imem(in_file, prog)) {
+        free(prog);
+        free(blk);
+        return 1;
+    }
+    prog->forwarding = config->forwarding;
+    find_leaders(prog);
+
+    printf("Scheduling %s (%d instructions, %s cost model)\n", in_file, prog->len,
+           prog->forwarding ? "forwarding" : "no-forwarding");
+    if (prog->unresolved) {
+        printf("Note: some branch targets are computed; every immediate that is a\n"
+               "      valid address is treated as a target\n");
+    }
+
+    int blocks = 0, changed = 0, slots = 0;
+    long stalls_before = 0, stalls_after = 0, cycles_before = 0, cycles_after = 0;
+    int start = 0;
+    while (start < prog->len) {
+        int end = block_end(prog, start);
+        int n = end - start;
+        blocks++;
+
+        // Fall-through successor for the cost model
+        int last = prog->code[end - 1].inst.opcode;
+        int br = n >= 2 && is_branch_op(prog->code[end - 2].inst.opcode) ? end - 2 :
+                 is_branch_op((uint8_t)last) ? end - 1 : -1;
+        bool uncond = br >= 0 && (prog->code[br].inst.opcode == OP_JAL ||
+                      (prog->code[br].inst.opcode == OP_BEQ &&
+                       prog->code[br].inst.rs == prog->code[br].inst.rt));
+        int next = (last == OP_HALT || uncond || end >= prog->len) ? -1 : end;
+
+        int orig[SCHED_MAX_BLOCK + 1], order[SCHED_MAX_BLOCK + 1];
+        for (int i = 0; i < n; i++) orig[i] = start + i;
+        int cyc0, st0, hor0;
+        block_cost(prog, orig, n, next, &cyc0, &st0, &hor0);
+        int cyc1 = cyc0, st1 = st0, hor1 = hor0;
+
+        if (!prog->frozen[start] && n > 1) {
+            blk->start = start;
+            blk->n = n;
+            blk->has_slot = br >= 0 && br == end - 2;
+            blk->term = br >= 0 ? br - start : (last == OP_HALT ? n - 1 : -1);
+            for (int i = 0; i < n; i++) {
+                for (int j = 0; j < n; j++) {
+                    blk->dep[i][j] = j > i &&
+                        depends(&prog->code[start + i], &prog->code[start + j]);
+                }
+            }
+            compute_heights(prog, blk);
+            int filler = list_schedule(prog, blk, order);
+
+            int abs_order[SCHED_MAX_BLOCK + 1];
+            for (int i = 0; i < n; i++) abs_order[i] = start + order[i];
+            block_cost(prog, abs_order, n, next, &cyc1, &st1, &hor1);
+
+            if (hor1 < hor0) {
+                SchedInst old[SCHED_MAX_BLOCK + 1];
+                memcpy(old, &prog->code[start], n * sizeof(SchedInst));
+                for (int i = 0; i < n; i++) prog->code[start + i] = old[order[i]];
+                changed++;
+                if (filler >= 0) slots++;
+                printf("  block %03X-%03X: %d -> %d cycles, %d -> %d stalls%s\n",
+                       start, end - 1, cyc0, cyc1, st0, st1,
+                       filler >= 0 ? ", delay slot filled" : "");
+                print_block(prog, blk, order);
+            } else {
+                cyc1 = cyc0;
+                st1 = st0;
+            }
+        }
+        cycles_before += cyc0;
+        cycles_after += cyc1;
+        stalls_before += st0;
+        stalls_after += st1;
+        start = end;
+    }
+
+    printf("Blocks: %d, rescheduled %d, delay slots filled %d\n", blocks, changed, slots);
+    printf("Predicted decode stalls: %ld -> %ld", stalls_before, stalls_after);
+    if (stalls_before > 0) {
+        printf(" (%.1f%% fewer)", 100.0 * (stalls_before - stalls_after) / stalls_before);
+    }
+    printf("\nPredicted cycles: %ld -> %ld (each block once, cache hits)\n",
+           cycles_before, cycles_after);
+
+    int code = 0;
+    if (out_file) {
+        FILE* fp = fopen(out_file, "w");
+        if (!fp) {
+            fprintf(stderr, "Error: Cannot write %s\n", out_file);
+            code = 1;
+        } else {
+            for (int pc = 0; pc < prog->len; pc++) fprintf(fp, "%08X\n", prog->code[pc].raw);
+            fclose(fp);
+            printf("Wrote %s\n", out_file);
+        }
+    }
+    free(prog);
+    free(blk);
+    return code;
+}
@@ -0,0 +1,226 @@
+/*
+ * =============================================================================
+ * Coherence / False-Sharing Profiler
+ * =============================================================================
+ * Optional (config.sharing_profile, --sharing-profile). Per 8-word block:
+ * - invalidations: copies dropped by a BusRdX snoop (one per cache)
+ * - downgrades:    M -> S on a BusRd snoop
+ * - c2c supplies:  fills answered by another cache instead of memory
+ * - per word:      mask of cores that read it and cores that wrote it
+ * A block written by two or more cores is classified from the word masks:
+ * - false sharing: the cores write different words, and no word is written
+ *   by one core and touched by another
+ * - true sharing:  some word is written by one core and touched by another
+ * - mixed:         both
+ * Blocks are allocated on first touch from a table indexed by block number,
+ * so only the blocks a program uses cost memory.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+#define SHARING_NUM_BLOCKS  (MAIN_MEM_SIZE / CACHE_BLOCK_SIZE)
+
+typedef enum {
+    SHARING_NONE = 0,       // At most one writer
+    SHARING_FALSE,
+    SHARING_TRUE,
+    SHARING_MIXED
+} SharingKind;
+
+static const char* const sharing_names[] = { "-", "false", "true", "mixed" };
+
+static SharingBlock* sharing_block(Simulator* sim, uint32_t addr) {
+    uint32_t n = (addr & 0x1FFFFF) / CACHE_BLOCK_SIZE;
+    if (!sim->sharing[n]) {
+        sim->sharing[n] = (SharingBlock*)calloc(1, sizeof(SharingBlock));
+    }
+    return sim->sharing[n];     // NULL if out of memory: the event is dropped
+}
+
+/* =============================================================================
+ * SETUP
+ * =============================================================================
+ */
+
+bool sharing_init(Simulator* sim) {
+    sim->sharing = (SharingBlock**)calloc(SHARING_NUM_BLOCKS, sizeof(SharingBlock*));
+    if (!sim->sharing) {
+        fprintf(stderr, "Error: Failed to allocate sharing profile\n");
+        return false;
+    }
+    return true;
+}
+
+void sharing_free(Simulator* sim) {
+    if (!sim->sharing) return;
+    for (uint32_t n = 0; n < SHARING_NUM_BLOCKS; n++) {
+        free(sim->sharing[n]);
+    }
+    free(sim->sharing);
+    sim->sharing = NULL;
+}
+
+/* =============================================================================
+ * COLLECTION HOOKS
+ * =============================================================================
+ */
+
+// Completed LW (is_write = false) or SW/FAA/CAS by core_id
+void sharing_access(Simulator* sim, int core_id, uint32_t addr, bool is_write) {
+    SharingBlock* b = sharing_block(sim, addr);
+    if (!b) return;
+
+    int offset = cache_get_offset(addr);
+    if (is_write) {
+        b->writers[offset] |= CORE_BIT(core_id);
+    } else {
+        b->readers[offset] |= CORE_BIT(core_id);
+    }
+}
+
+void sharing_invalidate(Simulator* sim, uint32_t block_addr) {
+    SharingBlock* b = sharing_block(sim, block_addr);
+    if (b) b->invalidations++;
+}
+
+void sharing_downgrade(Simulator* sim, uint32_t block_addr) {
+    SharingBlock* b = sharing_block(sim, block_addr);
+    if (b) b->downgrades++;
+}
+
+void sharing_c2c(Simulator* sim, uint32_t block_addr) {
+    SharingBlock* b = sharing_block(sim, block_addr);
+    if (b) b->c2c_supplies++;
+}
+
+/* =============================================================================
+ * REPORT
+ * =============================================================================
+ */
+
+typedef struct {
+    uint32_t    block_addr;
+    uint64_t    cost;       // invalidations + downgrades
+    SharingKind kind;
+} SharingRank;
+
+static int core_count(uint64_t mask) {
+    int n = 0;
+    for (; mask; mask &= mask - 1) n++;
+    return n;
+}
+
+static SharingKind classify(SharingBlock* b) {
+    uint64_t all_writers = 0;
+    bool true_sharing = false;
+
+    for (int w = 0; w < CACHE_BLOCK_SIZE; w++) {
+        all_writers |= b->writers[w];
+        // A written word touched by any other core
+        if (b->writers[w] && core_count(b->writers[w] | b->readers[w]) > 1) {
+            true_sharing = true;
+        }
+    }
+    if (core_count(all_writers) < 2) return true_sharing ? SHARING_TRUE : SHARING_NONE;
+
+    // Different cores writing different words
+    bool false_sharing = false;
+    for (int i = 0; i < CACHE_BLOCK_SIZE && !false_sharing; i++) {
+        for (int j = 0; j < CACHE_BLOCK_SIZE; j++) {
+            if (i != j && b->writers[i] && b->writers[j] &&
+                core_count(b->writers[i] | b->writers[j]) > 1) {
+                false_sharing = true;
+                break;
+            }
+        }
+    }
+    if (false_sharing && true_sharing) return SHARING_MIXED;
+    if (false_sharing) return SHARING_FALSE;
+    return SHARING_TRUE;
+}
+
+static int compare_ranks(const void* a, const void* b) {
+    const SharingRank* x = (const SharingRank*)a;
+    const SharingRank* y = (const SharingRank*)b;
+    if (x->cost != y->cost) return (x->cost < y->cost) ? 1 : -1;
+    return (x->block_addr < y->block_addr) ? -1 : (x->block_addr > y->block_addr);
+}
+
+// "0x3" per word, '.' for a word nobody wrote
+static void format_word_masks(uint64_t* masks, char* buf, size_t size) {
+    size_t len = 0;
+    buf[0] = '\0';
+    for (int w = 0; w < CACHE_BLOCK_SIZE && len < size; w++) {
+        if (masks[w]) {
+            len += snprintf(buf + len, size - len, "%s%llx", w ? " " : "",
+                            (unsigned long long)masks[w]);
+        } else {
+            len += snprintf(buf + len, size - len, "%s.", w ? " " : "");
+        }
+    }
+}
+
+void sharing_write(Simulator* sim, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return;
+    }
+
+    // Blocks with coherence traffic, most expensive first
+    int nranks = 0, capacity = 256;
+    SharingRank* ranks = (SharingRank*)malloc(sizeof(SharingRank) * capacity);
+    int kinds[4] = {0};
+    uint64_t totals[4] = {0};   // indexed by SharingKind: invalidations + downgrades
+
+    for (uint32_t n = 0; n < SHARING_NUM_BLOCKS && ranks; n++) {
+        SharingBlock* b = sim->sharing[n];
+        if (!b) continue;
+        uint64_t cost = (uint64_t)b->invalidations + b->downgrades;
+        SharingKind kind = classify(b);
+        if (cost == 0 && kind == SHARING_NONE) continue;
+
+        kinds[kind]++;
+        totals[kind] += cost;
+        if (nranks == capacity) {
+            capacity *= 2;
+            SharingRank* grown = (SharingRank*)realloc(ranks, sizeof(SharingRank) * capacity);
+            if (!grown) break;
+            ranks = grown;
+        }
+        ranks[nranks].block_addr = n * CACHE_BLOCK_SIZE;
+        ranks[nranks].cost = cost;
+        ranks[nranks].kind = kind;
+        nranks++;
+    }
+    if (ranks) qsort(ranks, nranks, sizeof(SharingRank), compare_ranks);
+
+    fprintf(fp, "Coherence profile (%d shared blocks)\n", nranks);
+    fprintf(fp, "false sharing: %d blocks, %llu invalidations+downgrades\n",
+            kinds[SHARING_FALSE] + kinds[SHARING_MIXED],
+            (unsigned long long)(totals[SHARING_FALSE] + totals[SHARING_MIXED]));
+    fprintf(fp, "true sharing:  %d blocks, %llu invalidations+downgrades\n\n",
+            kinds[SHARING_TRUE], (unsigned long long)totals[SHARING_TRUE]);
+
+    // Writer masks: bit c = core c wrote the word (hex), '.' = not written
+    fprintf(fp, "%-8s %8s %8s %8s  %-6s %-8s %-8s %s\n", "block", "inval", "M->S",
+            "c2c", "kind", "writers", "readers", "word writers (w0..w7)");
+    for (int i = 0; i < nranks && i < SHARING_REPORT_BLOCKS; i++) {
+        SharingBlock* b = sim->sharing[ranks[i].block_addr / CACHE_BLOCK_SIZE];
+        uint64_t writers = 0, readers = 0;
+        for (int w = 0; w < CACHE_BLOCK_SIZE; w++) {
+            writers |= b->writers[w];
+            readers |= b->readers[w];
+        }
+        char words[CACHE_BLOCK_SIZE * 18];
+        format_word_masks(b->writers, words, sizeof(words));
+        fprintf(fp, "0x%06X %8llu %8llu %8llu  %-6s %-8llx %-8llx %s\n", ranks[i].block_addr,
+                (unsigned long long)b->invalidations, (unsigned long long)b->downgrades,
+                (unsigned long long)b->c2c_supplies,
+                sharing_names[ranks[i].kind], (unsigned long long)writers,
+                (unsigned long long)readers, words);
+    }
+    free(ranks);
+    fclose(fp);
+}
@@ -15,6 +15,7 @@
 #include <string.h>
 #include <stdint.h>
 #include <stdbool.h>
+#include <limits.h>
 
 /* =============================================================================
  * SYSTEM CONSTANTS (FROM PDF SPEC)
@@ -22,7 +23,12 @@
  */
 
 // Core Configuration
-#define NUM_CORES           4
+#ifndef NUM_CORES
+#define NUM_CORES           4       // Spec value; build with /DNUM_CORES=N to scale
+#endif
+#if NUM_CORES > 64
+#error "NUM_CORES is limited to 64 (core masks are uint64_t)"
+#endif
 #define NUM_REGISTERS       16
 #define REGISTER_WIDTH      32      // bits
 
@@ -47,7 +53,65 @@
 #define BUS_ADDR_BITS       21      // 21-bit word address
 
 // Timing Constants
-#define MEM_RESPONSE_DELAY  16      // cycles before first Flush word from memory
+#define MEM_RESPONSE_DELAY  16      // cycles before first Flush word from memory (--mem-delay)
+#define C2C_DEFAULT_LATENCY 4       // cycles before first Flush word from a peer cache
+
+// Writeback Buffer (optional, per core)
+#define WB_BUFFER_MAX_DEPTH 16      // Upper bound for --wb-depth
+#define WB_DEFAULT_DEPTH    4       // Dirty victims queued per core
+
+// Per-PC profiler (optional)
+#define PROFILE_HOTSPOTS    20      // Rows in the hot-spot table
+#define SHARING_REPORT_BLOCKS 32    // Rows in the coherence profile
+#define CORE_BIT(c)         (1ULL << (c))   // Core masks are uint64_t
+#define BUS_HIST_BUCKETS    16      // Power-of-two latency buckets
+#define BUFW_SIZE           65536   // BufWriter chunk (bytes)
+
+// Run length
+#define DEFAULT_MAX_CYCLES  1000000 // Safety limit, --max-cycles=N (0 = none)
+
+// Verification (--verify, --test-suite)
+#define VERIFY_HASH_FILE    "hashes.txt"    // "<fnv1a-64 hex> <file>" per line
+#define VERIFY_MAX_HASHES   64
+#define VERIFY_MESSAGE_SIZE 256
+#define SUITE_DEFAULT_DIR   "tests"
+#define SUITE_MAX_TESTS     64
+#define SUITE_OPTIONS_FILE  "options.txt"   // Per-test model options
+
+// Benchmark mode (--bench)
+#define BENCH_DEFAULT_TESTS     "tests"
+#define BENCH_DEFAULT_OUT       "bench_out"
+#define BENCH_DEFAULT_REPS      3
+#define BENCH_DEFAULT_THRESHOLD 10      // Percent slowdown flagged as regression
+#define BENCH_MAX_WORKLOADS     32
+
+// Parameter sweep (--sweep)
+#define SWEEP_MAX_AXES      8
+#define SWEEP_MAX_VALUES    16      // Values per axis
+#define SWEEP_MAX_POINTS    4096    // Grid size limit
+
+// Memory-reference trace (--mem-trace, --replay)
+#define MEM_TRACE_MAGIC     "MESITRC1"  // File header, then uint32 core count
+#define MEM_TRACE_FILE      "memtrace.bin"
+#define MEM_TRACE_BUF_WORDS 16384       // Record words buffered before a write
+
+// Stack distance analysis (--stack-distance)
+#define SD_MAX_BLOCKS       4096    // Largest capacity on the miss-ratio curves
+#define SD_LEVELS           13      // Set counts 1, 2, 4, ... SD_MAX_BLOCKS
+
+// Functional mode (--functional) and its block translator
+#define FUNC_QUANTUM        1024    // Instructions per core turn (whole blocks)
+#define FUNC_HALT_SHADOW    3       // Instructions behind a HALT that still commit
+#define JIT_HOT_THRESHOLD   16      // Entries at a PC before its block is translated
+#define JIT_MAX_BLOCK       64      // Instructions per translated block
+#define JIT_CODE_SIZE       (1 << 20)   // Executable buffer per core (bytes)
+
+// Lockstep batch of functional runs (--batch)
+#define BATCH_LANES         8       // Instances per lockstep group (one AVX2 vector)
+#define BATCH_MAX_INSTANCES 1024
+
+// Hardware multithreading (optional, per core)
+#define MAX_HW_THREADS      4       // Upper bound for --threads
 
 /* =============================================================================
  * INSTRUCTION SET ARCHITECTURE
@@ -81,10 +145,12 @@ typedef enum {
     OP_JAL  = 15,   // R[15] = pc+1, pc = rd[9:0]
     OP_LW   = 16,   // rd = MEM[rs + rt]
     OP_SW   = 17,   // MEM[rs + rt] = rd
-    OP_RSVD = 18,   // Reserved
-    OP_IN   = 19,   // Reserved (not used in this sim)
+    OP_FAA  = 18,   // atomic: rd = MEM[rs + rt], MEM[rs + rt] += old rd
+    OP_CAS  = 19,   // atomic: rd = MEM[rs], if (old == rt) MEM[rs] = old rd
     OP_OUT  = 21,   // Reserved (not used in this sim)
-    OP_HALT = 20    // Stop core (opcode 20 = 0x14)
+    OP_HALT = 20,   // Stop core (opcode 20 = 0x14)
+    OP_BAR  = 22,   // Sleep until every running core reaches a BAR
+    OP_MWAIT = 23   // Sleep until block of rs + rt is invalidated (if cached)
 } Opcode;
 
 // Decoded instruction
@@ -119,25 +185,75 @@ typedef enum {
 } BusCommand;
 
 // Bus originator IDs
-#define BUS_ORIG_MEMORY     4
+#define BUS_ORIG_MEMORY     NUM_CORES   // 4 in the spec build
 
-// TSRAM Entry: {MESI(2 bits), Tag(12 bits)}
+// Designated responder for clean cache-to-cache transfers
+typedef enum {
+    C2C_RESPONDER_LOWEST_ID = 0,    // Lowest-numbered core holding the block
+    C2C_RESPONDER_FORWARD   = 1     // MESIF-style: the sharer tagged Forward
+} C2CResponder;
+
+// TSRAM Entry, 16 bits: {Tag(12 bits), MESI(2 bits)} in bits 13-0, exactly
+// as dumped to tsramN.txt, plus the MESIF F tag of a Shared line in bit 15
+typedef uint16_t TSRAMEntry;
+
+#define TSRAM_MESI_MASK     0x0003
+#define TSRAM_TAG_SHIFT     2
+#define TSRAM_DUMP_MASK     0x3FFF
+#define TSRAM_FORWARD       0x8000
+#define TSRAM_MESI(e)       ((MESIState)((e) & TSRAM_MESI_MASK))
+#define TSRAM_TAG(e)        (((uint32_t)(e) >> TSRAM_TAG_SHIFT) & 0xFFF)
+#define TSRAM_HOLDS(e, tag) (TSRAM_MESI(e) != MESI_INVALID && TSRAM_TAG(e) == (tag))
+#define TSRAM_SET_MESI(e, m) ((e) = (TSRAMEntry)(((e) & ~TSRAM_MESI_MASK) | (m)))
+#define TSRAM_SET_TAG(e, tag) \
+    ((e) = (TSRAMEntry)(((e) & ~(0xFFF << TSRAM_TAG_SHIFT)) | ((tag) << TSRAM_TAG_SHIFT)))
+
+// The TSRAMs of all caches form one [index][core] table (Simulator.tsram),
+// so a snoop finds every holder of a block with a vector compare of one
+// row. Rows are padded to whole 8-entry vectors; padding stays Invalid.
+#define TSRAM_ROW           ((NUM_CORES + 7) & ~7)
+
+// Cache. The DSRAM words live in the core's CoreMemory, the tags in its
+// column of Simulator.tsram.
 typedef struct {
-    uint32_t  tag;   // 12 bits
-    MESIState mesi;  // 2 bits
-} TSRAMEntry;
+    int32_t*    dsram;                      // 512 words (signed for proper handling)
+    TSRAMEntry* tsram;                      // 64 entries, TSRAM_ROW apart
+} Cache;
 
-// Cache
+#define CACHE_TSRAM(cache, index)   ((cache)->tsram[(index) * TSRAM_ROW])
+
+// When queued dirty victims are drained onto the bus
+typedef enum {
+    WB_DRAIN_EAGER     = 0,     // Any idle bus cycle
+    WB_DRAIN_THRESHOLD = 1      // Only once occupancy reaches wb_drain_threshold
+} WBDrainPolicy;
+
+// Dirty victim waiting to be written back
 typedef struct {
-    int32_t    dsram[CACHE_SIZE];           // 512 words (signed for proper handling)
-    TSRAMEntry tsram[CACHE_NUM_BLOCKS];     // 64 entries
-} Cache;
+    uint32_t   block_addr;
+    int32_t    data[CACHE_BLOCK_SIZE];
+} WBEntry;
+
+// Per-core FIFO of dirty victims (circular)
+typedef struct {
+    WBEntry    entries[WB_BUFFER_MAX_DEPTH];
+    int        head;            // Oldest entry
+    int        count;
+} WritebackBuffer;
 
 /* =============================================================================
  * PIPELINE STRUCTURES
  * =============================================================================
  */
 
+// Cause of a decode stall
+typedef enum {
+    HAZARD_NONE     = 0,
+    HAZARD_RAW      = 1,    // ALU/address/store operand in flight (no forwarding)
+    HAZARD_LOAD_USE = 2,    // Operand produced by an LW not yet through MEM
+    HAZARD_BRANCH   = 3     // Branch/JAL operand, compared in decode
+} HazardKind;
+
 typedef struct {
     bool        valid;
     uint32_t    pc;             // PC of this instruction
@@ -147,36 +263,95 @@ typedef struct {
     int32_t     rd_val;         // Value of rd register (for SW and branches)
     int32_t     alu_result;     // ALU output
     int32_t     mem_data;       // Data from memory (LW)
+    uint8_t     tid;            // Hardware thread that fetched it
+    uint32_t    next_pc;        // Program-order successor (replay after a park)
 } PipelineLatch;
 
+// Pipeline latch slots, one per stage boundary. Each slot is double
+// buffered: stages read the live buffer and write the spare one in place,
+// and core_cycle flips the slots that advanced (latch_live bit = index of
+// the live buffer). The spare MEM_WB buffer is what completed WB last cycle.
+typedef enum {
+    LATCH_IF_ID  = 0,   // Fetch -> Decode
+    LATCH_ID_EX  = 1,   // Decode -> Execute
+    LATCH_EX_MEM = 2,   // Execute -> Mem
+    LATCH_MEM_WB = 3,   // Mem -> Writeback
+    LATCH_SLOTS  = 4
+} LatchSlot;
+
+#define LATCH_BIT(s)            (1u << LATCH_##s)
+#define LATCH_ALL               ((1u << LATCH_SLOTS) - 1)
+#define CUR_LATCH(core, s)      (&(core)->latch[LATCH_##s][((core)->latch_live >> LATCH_##s) & 1])
+#define NEXT_LATCH(core, s)     (&(core)->latch[LATCH_##s][(((core)->latch_live >> LATCH_##s) & 1) ^ 1])
+#define WB_DONE_LATCH(core)     NEXT_LATCH(core, MEM_WB)
+// Second issue lane (dual-issue)
+#define CUR_LATCH2(core, s)     (&(core)->latch2[LATCH_##s][((core)->latch_live2 >> LATCH_##s) & 1])
+#define NEXT_LATCH2(core, s)    (&(core)->latch2[LATCH_##s][(((core)->latch_live2 >> LATCH_##s) & 1) ^ 1])
+#define WB_DONE_LATCH2(core)    NEXT_LATCH2(core, MEM_WB)
+
+// Thread selection for multithreaded cores
+typedef enum {
+    MT_SWITCH_ON_STALL = 0,     // Stay on one thread until it parks on a miss
+    MT_ROUND_ROBIN     = 1      // Rotate among ready threads every fetch
+} MTPolicy;
+
+// Architectural state of one hardware thread
 typedef struct {
-    int             core_id;
-    
-    // PC
     uint32_t        pc;
-    
-    // Registers (current state - reads return this value)
     int32_t         regs[NUM_REGISTERS];
+    uint32_t*       imem;               // IMEM_DEPTH words in the core's CoreMemory
     
-    // IMEM (private)
-    uint32_t        imem[IMEM_DEPTH];
-    
-    // Pipeline latches (current state)
-    PipelineLatch   IF_ID;      // Fetch -> Decode
-    PipelineLatch   ID_EX;      // Decode -> Execute
-    PipelineLatch   EX_MEM;     // Execute -> Mem
-    PipelineLatch   MEM_WB;     // Mem -> Writeback
-    PipelineLatch   WB_completed; // Tracks what completed WB last cycle (for trace)
+    bool            halted;             // HALT committed (or no image loaded)
+    bool            parked;             // Waiting for its cache miss to fill
+    bool            branch_pending;     // Taken branch, delay slot not fetched yet
+    uint32_t        branch_target;
+    bool            resume_pending;     // Next fetch replays a parked instruction
+    uint32_t        resume_next_pc;     // ...whose successor is this
+    PipelineLatch   parked_op;          // The memory op that missed
+    bool            replay_ready;       // parked_op performed at fill time
+    int32_t         replay_data;        // ...and its loaded value
     
-    // Cache
-    Cache           cache;
+    // Statistics
+    uint64_t        instruction_count;
+    uint64_t        decode_stall_cycles;
+    uint64_t        park_cycles;
+    uint64_t        parks;
+} HwThread;
+
+// MWAIT monitor on one block
+typedef enum {
+    MONITOR_IDLE  = 0,
+    MONITOR_ARMED = 1,      // Asleep until a BusRdX snoop hits the block
+    MONITOR_FIRED = 2       // Woken, the MWAIT completes on its retry
+} MonitorState;
+
+// Host cache line; Core starts on one so cores never share a line
+#define HOST_CACHE_LINE     64
+#ifdef _MSC_VER
+#define HOST_CACHE_ALIGNED  __declspec(align(HOST_CACHE_LINE))
+#else
+#define HOST_CACHE_ALIGNED  __attribute__((aligned(HOST_CACHE_LINE)))
+#endif
+
+// Bulk per-core storage, kept apart from Core (Simulator.core_mem) so
+// stepping the cores walks only their control, latch and tag state
+typedef struct {
+    uint32_t        imem[MAX_HW_THREADS][IMEM_DEPTH];
+    int32_t         dsram[CACHE_SIZE];
+} CoreMemory;
+
+// Per-cycle state of one core. Fields read every cycle come first; the
+// IMEM images and DSRAM are in CoreMemory.
+typedef struct {
+    HOST_CACHE_ALIGNED int core_id;
     
     // Control
-    bool            halted;             // HALT executed (pipeline may still drain)
+    bool            halted;             // Every thread executed HALT (pipeline may still drain)
     bool            decode_stall;       // Data hazard stall
     bool            mem_stall;          // Cache miss stall
     bool            waiting_for_bus;    // Bus transaction pending
     bool            fetch_enabled;      // Can fetch new instructions
+    bool            sleeping;           // BAR / MWAIT: skipped by run_simulation
     
     // Pending bus request
     bool            bus_request_pending;
@@ -186,15 +361,63 @@ typedef struct {
     int32_t         pending_write_data; // Data to write after fill
     uint32_t        pending_store_addr; // Full address for store
     
+    int             fetch_thread;       // Thread fetched from last
+    int             miss_thread;        // Thread whose miss owns the bus request (-1 if none)
+    
+    // Pipeline latches, [LatchSlot][buffer] (CUR_LATCH / NEXT_LATCH)
+    uint8_t         latch_live;         // Bit per slot: live buffer index
+    uint8_t         latch_live2;        // Same for lane 1
+    HOST_CACHE_ALIGNED PipelineLatch latch[LATCH_SLOTS][2];
+    
+    // Hardware threads: PC, registers and private IMEM image each.
+    // Thread 0 is the spec's single context; the others run only with
+    // config.hw_threads > 1 and an image loaded (start halted otherwise).
+    HwThread        thread[MAX_HW_THREADS];
+    
+    // Cache
+    Cache           cache;
+    
+    // Second issue lane (dual-issue mode only, always invalid otherwise).
+    // Within a stage lane 0 holds the older instruction.
+    HOST_CACHE_ALIGNED PipelineLatch latch2[LATCH_SLOTS][2];
+    
+    WritebackBuffer wb_buffer;          // Used only with config.wb_buffer
+    
+    // BAR / MWAIT
+    bool            bar_waiting;            // Arrived, waiting for the release
+    uint32_t        bar_generation;         // Barrier generation it arrived in
+    MonitorState    monitor;
+    uint32_t        monitor_block;
+    
     // Statistics
-    uint32_t        cycle_count;
-    uint32_t        instruction_count;
-    uint32_t        read_hits;
-    uint32_t        write_hits;
-    uint32_t        read_misses;
-    uint32_t        write_misses;
-    uint32_t        decode_stall_cycles;
-    uint32_t        mem_stall_cycles;
+    uint64_t        cycle_count;
+    uint64_t        instruction_count;
+    uint64_t        read_hits;
+    uint64_t        write_hits;
+    uint64_t        read_misses;
+    uint64_t        write_misses;
+    uint64_t        decode_stall_cycles;
+    uint64_t        mem_stall_cycles;
+    uint64_t        c2c_fills;          // Misses filled by a peer cache
+    uint64_t        c2c_supplies;       // Blocks this cache supplied to a peer
+    uint64_t        wb_queued;          // Dirty victims placed in the buffer
+    uint64_t        wb_drained;         // Buffered victims written back over the bus
+    uint64_t        wb_snoop_hits;      // Buffered victims handed to a bus request
+    uint64_t        wb_full_stalls;     // Grants delayed by a forced drain
+    uint64_t        stall_raw_cycles;       // decode_stall split by HazardKind
+    uint64_t        stall_load_use_cycles;
+    uint64_t        stall_branch_cycles;
+    uint64_t        issue_dual_cycles;      // Dual-issue: cycles issuing 2 / 1
+    uint64_t        issue_single_cycles;
+    uint64_t        pair_break_dep;         // Slot 1 held back: reads slot 0's result
+    uint64_t        pair_break_struct;      // Slot 1 held back: 2nd memory op or branch
+    uint64_t        atomic_ops;             // FAA/CAS performed
+    uint64_t        cas_fail;               // CAS that found an unexpected value
+    uint64_t        barrier_waits;          // BARs executed
+    uint64_t        mwait_sleeps;           // MWAITs that went to sleep
+    uint64_t        sleep_cycles;
+    uint64_t        native_instructions;    // Functional mode: run as translated code
+    uint64_t        native_blocks;          // Functional mode: blocks translated
 } Core;
 
 /* =============================================================================
@@ -205,7 +428,7 @@ typedef struct {
 typedef struct {
     bool        active;
     BusCommand  cmd;
-    int         origid;         // 0-3 = core, 4 = memory
+    int         origid;         // Core ID, or BUS_ORIG_MEMORY
     uint32_t    addr;           // 21-bit word address
     int32_t     data;           // 32-bit data (signed for memory values)
     bool        shared;         // bus_shared signal
@@ -218,12 +441,17 @@ typedef struct {
     int         cycles_remaining;   // Countdown to first word
     int         words_sent;         // 0-7
     bool        is_rdx;
-    int         data_source;        // -1=memory, 0-3=cache with M
+    int         data_source;        // -1=memory, 0-3=supplying cache
+    bool        source_dirty;       // Supplying cache had the block in M
     bool        shared;             // Was bus_shared set during request?
+    bool        is_writeback;       // Buffered victim drain (requesting_core = owner)
+    bool        data_buffered;      // Words come from block_data, not a DSRAM
+    int32_t     block_data[CACHE_BLOCK_SIZE];
 } MemoryResponse;
 
 typedef struct {
     int         last_granted;   // For round-robin (lowest priority next)
+    int         last_drained;   // Round-robin among writeback buffers
     bool        transaction_in_progress;  // BusRd/BusRdX not yet completed
 } BusArbiter;
 
@@ -236,44 +464,389 @@ typedef struct {
     bool            snoop_shared;           // Any cache has the block
     bool            snoop_has_modified;     // Some cache has M state
     int             snoop_modified_core;    // Which core has M (-1 if none)
+    int             snoop_clean_core;       // Designated clean (E/S) responder (-1 if none)
+    int             snoop_buffer_core;      // Writeback buffer holding the block (-1 if none)
+    int32_t         snoop_buffer_data[CACHE_BLOCK_SIZE];
 } Bus;
 
+// Hardware barrier shared by all cores
+typedef struct {
+    uint64_t        arrived;        // Bit per core waiting at BAR
+    uint32_t        generation;     // Incremented on every release
+} BarrierUnit;
+
+// Per-PC profile counters (config.profile)
+typedef struct {
+    uint64_t        exec;                   // Committed
+    uint64_t        decode_stall;           // Cycles held in decode...
+    uint64_t        stall_reg[NUM_REGISTERS];   // ...by producer register
+    uint64_t        mem_read;               // Cycles waiting on a LW miss
+    uint64_t        mem_write;              // ...SW/atomic miss
+    uint64_t        mem_upgrade;            // ...SW/atomic on a Shared line
+    uint64_t        bus_wait;               // Part of the above before the grant
+} PcProfile;
+
+// Coherence counters of one 8-word block (config.sharing_profile)
+typedef struct {
+    uint64_t        invalidations;          // Copies dropped by BusRdX snoops
+    uint64_t        downgrades;             // M -> S on BusRd snoops
+    uint64_t        c2c_supplies;           // Fills served by another cache
+    uint64_t        readers[CACHE_BLOCK_SIZE];  // Core masks per word
+    uint64_t        writers[CACHE_BLOCK_SIZE];
+} SharingBlock;
+
+// Bus contention statistics (config.bus_stats)
+typedef enum {
+    BUS_PHASE_IDLE = 0,
+    BUS_PHASE_COMMAND,          // BusRd/BusRdX on the bus
+    BUS_PHASE_DELAY,            // Waiting for the first Flush word
+    BUS_PHASE_FLUSH,            // Fill words
+    BUS_PHASE_WRITEBACK,        // Buffered victim drain words
+    BUS_PHASE_COUNT
+} BusPhase;
+
+typedef struct {
+    uint64_t        count;
+    uint64_t        sum;
+    uint64_t        max;
+    uint64_t        buckets[BUS_HIST_BUCKETS];  // [2^b, 2^(b+1))
+} LatencyHist;
+
+typedef struct {
+    bool            request_open[NUM_CORES];    // Issued, fill not yet done
+    uint64_t        request_cycle[NUM_CORES];
+    uint64_t        requests[NUM_CORES];
+    LatencyHist     grant[NUM_CORES];           // Request -> grant
+    LatencyHist     fill[NUM_CORES];            // Request -> last Flush word
+    uint64_t        phase_cycles[BUS_PHASE_COUNT];
+    uint64_t        queue_depth[NUM_CORES + 1]; // Cycles with N requests waiting
+} BusStats;
+
+// Miss classification (config.miss_classes)
+typedef enum {
+    MISS_COMPULSORY = 0,
+    MISS_CAPACITY,
+    MISS_CONFLICT,
+    MISS_COHERENCE,
+    MISS_UPGRADE,               // Write to a Shared line
+    MISS_CLASS_COUNT
+} MissClass;
+
+typedef struct {
+    uint8_t*        touched;        // First-touch bitmap, bit per memory block
+    uint8_t*        invalidated;    // Lost to a BusRdX snoop since last fill
+    uint32_t        shadow[CACHE_NUM_BLOCKS];   // Fully associative LRU, MRU first
+    int             shadow_count;
+    uint64_t        misses[MISS_CLASS_COUNT];
+    uint64_t        set_conflicts[CACHE_NUM_BLOCKS];
+} MissClassCore;
+
+// Buffered text output: formatted into buf, written in BUFW_SIZE chunks
+typedef struct {
+    FILE*           fp;
+    size_t          len;
+    char            buf[BUFW_SIZE];
+} BufWriter;
+
+// Interval time series (config.interval)
+typedef enum {
+    INTERVAL_CSV = 0,
+    INTERVAL_JSONL
+} IntervalFormat;
+
+typedef struct {
+    uint64_t        cycles;
+    uint64_t        instructions;
+    uint64_t        read_hits;
+    uint64_t        write_hits;
+    uint64_t        read_misses;
+    uint64_t        write_misses;
+    uint64_t        decode_stall;
+    uint64_t        mem_stall;
+} IntervalCounters;
+
+typedef struct {
+    BufWriter        out;
+    uint64_t         last_cycle;        // End of the previous sample
+    uint64_t         bus_busy;          // Busy bus cycles since then
+    IntervalCounters prev[NUM_CORES];   // Counters at the previous sample
+} IntervalLog;
+
+// LRU stack distances for one set count (config.stack_distance). Each set
+// keeps a window of 2 * depth slots in access order, one live slot per
+// block (its last access), and a Fenwick tree counting live slots; the
+// distance of a reuse is the number of live slots after the block's own.
+typedef struct {
+    int             sets;
+    int             depth;          // SD_MAX_BLOCKS / sets, deepest distance kept
+    uint16_t*       slot;           // [memory block] 1 + window slot, 0 = not kept
+    uint32_t*       owner;          // [set][2 * depth] block in each slot
+    uint16_t*       tree;           // [set][2 * depth] Fenwick tree of live slots
+    uint16_t*       next;           // [set] next free slot
+    uint64_t*       hist;           // [depth + 1] reuses at distance d, last = deeper
+} StackLevel;
+
+typedef struct {
+    StackLevel      level[SD_LEVELS];   // level L has 2^L sets
+    uint64_t        refs;
+} StackDistCore;
+
+// Memory-reference trace (config.mem_trace). A record is two uint32 words:
+// the gap, cycles since the core's previous reference completed, and
+// addr | kind << 21 | core << 24. The gap leaves out memory latency, so a
+// replay under other timing keeps each core's compute time fixed.
+typedef enum {
+    MEM_REF_READ = 0,           // LW
+    MEM_REF_WRITE,              // SW
+    MEM_REF_ATOMIC,             // FAA/CAS (read-modify-write)
+    MEM_REF_IDLE,               // Gap too long for one record, no access
+    MEM_REF_END                 // Core done: its last active cycle
+} MemRefKind;
+
+typedef struct {
+    FILE*           fp;
+    int             len;                        // Words in buf
+    uint32_t        buf[MEM_TRACE_BUF_WORDS];
+    uint64_t        last_done[NUM_CORES];       // Cycle the previous reference completed
+    bool            issued[NUM_CORES];          // Current reference already recorded
+    uint64_t        records;
+} MemTrace;
+
+/* =============================================================================
+ * SIMULATOR CONFIGURATION
+ * =============================================================================
+ * Optional behaviour beyond the PDF spec. Defaults (config_init) reproduce the
+ * spec exactly; every extension is opt-in from the command line.
+ */
+
+typedef struct {
+    // Cache-to-cache transfer of clean (E/S) blocks
+    bool            c2c_clean;          // Clean peer supplies data instead of memory
+    int             c2c_latency;        // Cycles before first Flush word from a cache
+    int             mem_delay;          // Cycles before first Flush word from memory
+    C2CResponder    c2c_responder;      // Which sharer answers a BusRd/BusRdX
+    
+    // Asynchronous writeback buffer for dirty evictions
+    bool            wb_buffer;          // Queue victims instead of instant writeback
+    int             wb_depth;           // Entries per core (1..WB_BUFFER_MAX_DEPTH)
+    WBDrainPolicy   wb_drain;
+    int             wb_drain_threshold; // Occupancy that starts a drain (THRESHOLD)
+    
+    // Pipeline
+    bool            forwarding;         // EX->EX, MEM->EX, WB->ID bypass network
+    bool            stall_causes;       // Report decode stalls per HazardKind
+    int             issue_width;        // 1 = spec pipeline, 2 = dual-issue in-order
+    
+    // Fine-grained multithreading
+    int             hw_threads;         // Thread contexts per core (1 = spec)
+    MTPolicy        mt_policy;
+    
+    // Instrumentation
+    bool            profile;            // Per-PC profile (profileN.txt)
+    bool            sharing_profile;    // Per-block coherence profile (sharing.txt)
+    bool            bus_stats;          // Bus latency/occupancy (busstats.json)
+    bool            miss_classes;       // 3C + coherence miss classes (conflicts.txt)
+    uint64_t        interval;           // Sample counters every N cycles (0 = off)
+    IntervalFormat  interval_format;
+    bool            mem_trace;          // Memory-reference stream (memtrace.bin)
+    bool            stack_distance;     // LRU miss-ratio curves (missratio.txt)
+    
+    // Functional mode: ISA semantics and cache contents, no timing
+    bool            functional;
+    bool            jit;                // Translate hot blocks (x86-64 Linux hosts)
+    
+    // Run control
+    uint64_t        max_cycles;         // Stop with an error after this many (0 = no limit)
+    bool            quiet;              // No progress messages (benchmark runs)
+    const char*     verify_dir;         // Compare outputs with this directory (NULL = write)
+} SimConfig;
+
+/* =============================================================================
+ * RUN FILES AND HOST TIMING
+ * =============================================================================
+ */
+
+// File names of one run: the 27 positional arguments plus --thread-imem
+typedef struct {
+    const char*     imem[NUM_CORES];
+    const char*     thread_imem[NUM_CORES][MAX_HW_THREADS];    // [c][0] unused
+    const char*     memin;
+    const char*     memout;
+    const char*     regout[NUM_CORES];
+    const char*     core_trace[NUM_CORES];
+    const char*     bus_trace;
+    const char*     dsram[NUM_CORES];
+    const char*     tsram[NUM_CORES];
+    const char*     stats[NUM_CORES];
+} SimFiles;
+
+// Host time of one run, in seconds (benchmark mode)
+typedef struct {
+    double          core_s;             // core_cycle, barrier, interval sampling
+    double          bus_s;              // bus_cycle and bus statistics
+    double          trace_s;            // Core and bus trace lines
+    double          io_s;               // Loading inputs, writing outputs
+    double          total_s;
+    uint64_t        cycles;             // Simulated
+    uint64_t        instructions;       // Committed, all cores
+    bool            finished;           // Every core halted (no deadlock or cycle limit)
+} RunTiming;
+
+// Benchmark mode options (--bench...)
+typedef struct {
+    bool            enabled;
+    const char*     tests_dir;
+    const char*     out_dir;
+    const char*     only;               // Name filter, NULL = all
+    const char*     save_file;
+    const char*     baseline_file;
+    int             reps;
+    int             threshold;          // Percent
+} BenchOptions;
+
+// Parameter sweep options (--sweep...)
+typedef struct {
+    const char*     axes[SWEEP_MAX_AXES];   // "name=v1,v2,..." or "flag"
+    int             naxes;
+    const char*     in_dir;             // Inputs (imem0-3, memin)
+    const char*     out_file;           // CSV results, NULL = table only
+} SweepOptions;
+
+/* =============================================================================
+ * OUTPUT FILES AND VERIFICATION
+ * =============================================================================
+ * Traces and dumps are written a line at a time through an OutputFile. With
+ * --verify each line is compared with the expected file (or folded into a
+ * hash checked against hashes.txt) instead of being written.
+ */
+
+// Which output a stream carries, to name the field of a mismatch
+typedef enum {
+    OUT_CORE_TRACE = 0,
+    OUT_BUS_TRACE,
+    OUT_MEMOUT,
+    OUT_REGOUT,
+    OUT_DSRAM,
+    OUT_TSRAM,
+    OUT_STATS
+} OutputKind;
+
+typedef struct VerifyStream VerifyStream;  // verify.c
+
+typedef struct {
+    FILE*           fp;                 // Written output
+    VerifyStream*   check;              // Compared output (--verify)
+} OutputFile;
+
+// Outcome of a verified run
+typedef struct {
+    bool            passed;
+    int             checked;            // Outputs compared
+    int             missing;            // Outputs with no expected file or hash
+    uint64_t        cycles;
+    char            message[VERIFY_MESSAGE_SIZE];   // First divergence
+} VerifyResult;
+
+typedef struct {
+    const char*     expected_dir;
+    char            hash_names[VERIFY_MAX_HASHES][64];
+    uint64_t        hashes[VERIFY_MAX_HASHES];
+    int             nhashes;
+    bool            failed;             // Stops the run at the first divergence
+    VerifyResult    result;
+} Verifier;
+
 /* =============================================================================
  * SIMULATOR STATE
  * =============================================================================
  */
 
+// Why a run ended before every core finished
+typedef enum {
+    STOP_NONE = 0,
+    STOP_DEADLOCK,              // Every core asleep in BAR/MWAIT
+    STOP_CYCLE_LIMIT,           // config.max_cycles reached
+    STOP_VERIFY                 // First --verify mismatch
+} StopReason;
+
 typedef struct {
-    Core        cores[NUM_CORES];
+    SimConfig   config;
+    Core*       cores;          // [NUM_CORES], contiguous and cache-line aligned
+    CoreMemory* core_mem;       // [NUM_CORES] IMEM images and DSRAM
+    TSRAMEntry* tsram;          // [CACHE_NUM_BLOCKS][TSRAM_ROW] tags of every cache
     int32_t*    main_memory;    // 2^21 words, dynamically allocated
     Bus         bus;
+    BarrierUnit barrier;
     uint64_t    cycle;
+    StopReason  stopped;
+    
+    PcProfile*  profile;        // [core][thread][pc], NULL unless config.profile
+    SharingBlock** sharing;     // [block], NULL unless config.sharing_profile
+    BusStats*   bus_stats;      // NULL unless config.bus_stats
+    MissClassCore* miss_class;  // [core], NULL unless config.miss_classes
+    IntervalLog* intervals;     // NULL unless config.interval
+    MemTrace*   mem_trace;      // NULL unless config.mem_trace
+    StackDistCore* stack_dist;  // [core], NULL unless config.stack_distance
+    RunTiming*  timing;         // Host time split, NULL unless measured
+    Verifier*   verify;         // NULL unless config.verify_dir
     
     // Trace files
-    FILE*       core_trace[NUM_CORES];
-    FILE*       bus_trace;
+    OutputFile  core_trace[NUM_CORES];
+    OutputFile  bus_trace;
 } Simulator;
 
+// One core in functional mode (config.functional). Translated code gets a
+// FuncCore* and addresses regs at offset 0.
+typedef struct JitCache JitCache;
+
+typedef struct {
+    int32_t         regs[NUM_REGISTERS];    // Must stay first (jit.c)
+    Simulator*      sim;
+    Core*           core;
+    Instruction     code[IMEM_DEPTH];       // Predecoded imem of thread 0
+    uint32_t        pc;
+    uint32_t        npc;                    // Differs from pc + 1 in a delay slot
+    int             shadow;                 // Instructions left behind a HALT (-1 = none)
+    bool            done;
+    bool            at_barrier;
+    JitCache*       jit;                    // NULL: interpret only
+} FuncCore;
+
 /* =============================================================================
  * FUNCTION PROTOTYPES
  * =============================================================================
  */
 
 // Init
-void sim_init(Simulator* sim);
-void core_init(Core* core, int id);
+void config_init(SimConfig* config);
+bool sim_init(Simulator* sim);
+void core_init(Core* core, int id, CoreMemory* mem, TSRAMEntry* tsram);
 void cache_init(Cache* cache);
 void bus_init(Bus* bus);
 void sim_cleanup(Simulator* sim);
 
 // File I/O
-bool load_imem(Core* core, const char* filename);
+bool load_imem(Core* core, int tid, const char* filename);
 bool load_memin(Simulator* sim, const char* filename);
 void write_memout(Simulator* sim, const char* filename);
-void write_regout(Core* core, const char* filename);
-void write_dsram(Core* core, const char* filename);
-void write_tsram(Core* core, const char* filename);
-void write_stats(Core* core, const char* filename);
+void write_regout(Simulator* sim, Core* core, int tid, const char* filename);
+void write_dsram(Simulator* sim, Core* core, const char* filename);
+void write_tsram(Simulator* sim, Core* core, const char* filename);
+void write_stats(Simulator* sim, Core* core, const char* filename);
+
+// Output files and verification
+bool output_open(Simulator* sim, OutputFile* out, const char* filename, OutputKind kind, int index);
+void output_line(OutputFile* out, const char* line);
+void output_printf(OutputFile* out, const char* fmt, ...);
+void output_close(OutputFile* out);
+bool verify_init(Simulator* sim, const char* expected_dir);
+void verify_finish(Simulator* sim, VerifyResult* result);
+void verify_free(Simulator* sim);
+bool verify_make_hashes(const char* dir);
+int run_test_suite(const SimConfig* config, const char* dir, int jobs);
+
+// Static instruction scheduler (offline, --schedule)
+int schedule_imem(const SimConfig* config, const char* in_file, const char* out_file);
 
 // Instructions
 Instruction decode_instruction(uint32_t raw);
@@ -281,17 +854,46 @@ int32_t sign_extend_12(uint32_t value);
 
 // Pipeline
 void core_cycle(Core* core, Simulator* sim);
-bool check_data_hazard(Core* core);
+HazardKind check_data_hazard(Core* core, bool forwarding, int* stall_reg);
 int  get_dest_reg(PipelineLatch* latch);
+bool is_load_op(uint8_t op);
+bool is_atomic_op(uint8_t op);
+bool is_wait_op(uint8_t op);
+int  get_source_regs(Instruction* inst, int regs[3], bool in_decode[3]);
+
+// Pipeline stages (shared by the single- and dual-issue cycles)
+bool do_writeback(Core* core, PipelineLatch* latch);
+bool do_mem(Core* core, Simulator* sim, PipelineLatch* ex_mem, PipelineLatch* next_MEM_WB);
+void do_execute(Core* core, Simulator* sim, PipelineLatch* completing,
+                PipelineLatch* id_ex, PipelineLatch* next_EX_MEM);
+bool decode_issue(Core* core, PipelineLatch* if_id, PipelineLatch* next_ID_EX,
+                  uint32_t* branch_target);
+void count_decode_stall(Core* core, HazardKind hazard);
+void do_fetch(Core* core, PipelineLatch* next_IF_ID);
+
+// Multithreading
+void mt_begin_cycle(Core* core, Simulator* sim);
+void mt_select_thread(Core* core, Simulator* sim);
+void mt_park_thread(Core* core, PipelineLatch* miss);
+
+// Dual-issue pipeline
+void core_cycle_dual(Core* core, Simulator* sim);
 
 // Cache
 bool cache_read(Core* core, Simulator* sim, uint32_t addr, int32_t* data);
 bool cache_write(Core* core, Simulator* sim, uint32_t addr, int32_t data);
+bool cache_atomic(Core* core, Simulator* sim, Instruction* inst, uint32_t addr,
+                  int32_t operand, int32_t expected, int32_t* old);
 int  cache_get_index(uint32_t addr);
 uint32_t cache_get_tag(uint32_t addr);
 uint32_t cache_get_block_addr(uint32_t addr);
 int  cache_get_offset(uint32_t addr);
+uint64_t cache_holders(const Simulator* sim, uint32_t addr);
 void cache_writeback_block(Core* core, Simulator* sim, int index);
+void wb_buffer_push(Core* core, int index);
+bool wb_buffer_take(Core* core, uint32_t block_addr, int32_t* data);
+void wb_buffer_pop(Core* core, WBEntry* out);
+void wb_buffer_flush(Core* core, Simulator* sim);
 
 // Bus
 void bus_cycle(Simulator* sim);
@@ -302,6 +904,98 @@ void bus_issue_request(Core* core, BusCommand cmd, uint32_t block_addr);
 // Memory
 void memory_cycle(Simulator* sim);
 
+// Synchronization (BAR / MWAIT)
+bool barrier_wait(Core* core, Simulator* sim);
+void barrier_update(Simulator* sim);
+bool monitor_wait(Core* core, uint32_t addr);
+
+// Profiler
+bool profile_init(Simulator* sim);
+void profile_free(Simulator* sim);
+void profile_commit(Simulator* sim, Core* core, PipelineLatch* latch);
+void profile_decode_stall(Simulator* sim, Core* core, PipelineLatch* latch, int reg);
+void profile_mem_stall(Simulator* sim, Core* core, PipelineLatch* latch, bool bus_wait);
+void profile_write(Simulator* sim, Core* core, const char* filename);
+void disassemble(uint32_t raw, char* buf, size_t size);
+
+// Coherence profiler
+bool sharing_init(Simulator* sim);
+void sharing_free(Simulator* sim);
+void sharing_access(Simulator* sim, int core_id, uint32_t addr, bool is_write);
+void sharing_invalidate(Simulator* sim, uint32_t block_addr);
+void sharing_downgrade(Simulator* sim, uint32_t block_addr);
+void sharing_c2c(Simulator* sim, uint32_t block_addr);
+void sharing_write(Simulator* sim, const char* filename);
+
+// Bus statistics
+bool bus_stats_init(Simulator* sim);
+void bus_stats_free(Simulator* sim);
+void bus_stats_grant(Simulator* sim, int core_id);
+void bus_stats_fill(Simulator* sim, int core_id);
+void bus_stats_cycle(Simulator* sim);
+void bus_stats_write(Simulator* sim, const char* filename);
+
+// Miss classification
+bool miss_class_init(Simulator* sim);
+void miss_class_free(Simulator* sim);
+void miss_class_hit(Simulator* sim, Core* core, uint32_t addr);
+void miss_class_miss(Simulator* sim, Core* core, uint32_t addr, bool upgrade);
+void miss_class_invalidate(Simulator* sim, Core* core, uint32_t block_addr);
+void miss_class_write_stats(Simulator* sim, Core* core, OutputFile* out);
+void miss_class_write_heatmap(Simulator* sim, const char* filename);
+
+// Stack distance analysis
+bool stack_dist_init(Simulator* sim);
+void stack_dist_free(Simulator* sim);
+void stack_dist_access(Simulator* sim, int core_id, uint32_t addr);
+void stack_dist_write(Simulator* sim, const char* filename);
+
+// Buffered output and interval statistics
+bool bufw_open(BufWriter* w, const char* filename);
+void bufw_printf(BufWriter* w, const char* fmt, ...);
+void bufw_flush(BufWriter* w);
+void bufw_close(BufWriter* w);
+bool interval_init(Simulator* sim, const char* filename);
+void interval_cycle(Simulator* sim);
+void interval_finish(Simulator* sim);
+
+// Memory-reference trace and trace-driven replay
+bool mem_trace_init(Simulator* sim, const char* filename);
+void mem_trace_access(Simulator* sim, Core* core, MemRefKind kind, uint32_t addr, bool done);
+void mem_trace_finish(Simulator* sim);
+int mem_replay_run(const SimConfig* config, const char* filename);
+
+// Functional mode and the x86-64 block translator
+void functional_run(Simulator* sim);
+void func_core_init(FuncCore* fc, Simulator* sim, int core_id);
+void func_core_finish(FuncCore* fc);
+void func_schedule(Simulator* sim, FuncCore* fcs, int first, uint64_t used);
+int32_t func_load(FuncCore* fc, uint32_t addr);
+void func_store(FuncCore* fc, uint32_t addr, int32_t value);
+int32_t func_faa(FuncCore* fc, uint32_t addr, int32_t add);
+int32_t func_cas(FuncCore* fc, uint32_t addr, int32_t expected, int32_t value);
+JitCache* jit_create(void);
+void jit_destroy(JitCache* jc);
+int jit_run(JitCache* jc, FuncCore* fc);
+
+// Runs and benchmark mode
+void sim_files_default(SimFiles* files);
+const char* option_value(const char* arg, const char* prefix);
+bool option_int(const char* val, long min, long max, int* out);
+bool parse_thread_imem(const char* arg, int* core, int* thread, const char** file);
+bool parse_option(SimConfig* config, const char* arg);
+const char* config_resolve(SimConfig* config);
+void write_outputs(Simulator* sim, const SimFiles* files);
+int simulate_files(const SimConfig* config, const SimFiles* files, RunTiming* timing,
+                   VerifyResult* verify);
+void bench_options_init(BenchOptions* opts);
+bool bench_parse_option(BenchOptions* opts, const char* arg);
+int bench_run(const SimConfig* config, const BenchOptions* opts);
+void sweep_options_init(SweepOptions* opts);
+bool sweep_parse_option(SweepOptions* opts, const char* arg);
+int sweep_run(const SimConfig* config, const SweepOptions* opts, int jobs);
+int batch_run(const SimConfig* config, const char* dir, bool compare, int jobs);
+
 // Trace
 void trace_core(Simulator* sim, int core_id);
 void trace_bus(Simulator* sim);
@@ -309,10 +1003,12 @@ void trace_bus(Simulator* sim);
 // Control
 bool all_cores_done(Simulator* sim);
 bool pipeline_active(Core* core);
+void sim_start(Simulator* sim);
+bool sim_step(Simulator* sim);
 void run_simulation(Simulator* sim);
 
 // MESI snooping
-void mesi_snoop_busrd(Core* core, Simulator* sim, uint32_t block_addr, int requester);
-void mesi_snoop_busrdx(Core* core, Simulator* sim, uint32_t block_addr, int requester);
+void mesi_snoop_busrd(Core* core, Simulator* sim, uint32_t block_addr);
+void mesi_snoop_busrdx(Core* core, Simulator* sim, uint32_t block_addr);
 
 #endif // SIM_H
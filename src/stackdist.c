@@ -0,0 +1,227 @@
+/*
+ * =============================================================================
+ * Stack Distance Analysis (Mattson)
+ * =============================================================================
+ * Optional (config.stack_distance, --stack-distance). Every completed load,
+ * store and atomic of a core is run through an LRU stack per set for every
+ * power-of-two set count from 1 (fully associative) to SD_MAX_BLOCKS. Its
+ * stack distance d (distinct blocks of the same set used since this block's
+ * last use) means a hit in every LRU cache of that set count with more
+ * than d ways. One run therefore gives the miss ratio of every power-of-two
+ * capacity up to SD_MAX_BLOCKS blocks and every associativity, written to
+ * missratio.txt next to stats0.txt.
+ *
+ * A stack is not kept as a list: each set has a window of slots in access
+ * order, where only a block's latest slot is live, and a Fenwick tree over
+ * the live slots. The distance is the live count after the old slot, in
+ * O(log depth). When the window fills, the depth most recent blocks move
+ * to its front; older ones are deeper than any curve point and forgotten.
+ *
+ * The curves model one core's own references with its block size
+ * (CACHE_BLOCK_SIZE); invalidations by other cores are not included, so
+ * the difference to statsN.txt at this build's geometry is coherence.
+ * =============================================================================
+ */
+
+#include "sim.h"
+
+#define SD_NUM_BLOCKS   (MAIN_MEM_SIZE / CACHE_BLOCK_SIZE)
+#define SD_EMPTY        0xFFFFFFFFu
+
+/* =============================================================================
+ * FENWICK TREE (live slots of one set)
+ * =============================================================================
+ */
+
+static void tree_add(uint16_t* tree, int n, int slot, int delta) {
+    for (int i = slot + 1; i <= n; i += i & -i) tree[i - 1] = (uint16_t)(tree[i - 1] + delta);
+}
+
+// Live slots in [0, end)
+static int tree_count(const uint16_t* tree, int end) {
+    int sum = 0;
+    for (int i = end; i > 0; i -= i & -i) sum += tree[i - 1];
+    return sum;
+}
+
+/* =============================================================================
+ * SETUP
+ * =============================================================================
+ */
+
+static bool level_init(StackLevel* lv, int sets) {
+    int n = 2 * (SD_MAX_BLOCKS / sets);
+    lv->sets = sets;
+    lv->depth = SD_MAX_BLOCKS / sets;
+    lv->slot = (uint16_t*)calloc(SD_NUM_BLOCKS, sizeof(uint16_t));
+    lv->owner = (uint32_t*)malloc((size_t)sets * n * sizeof(uint32_t));
+    lv->tree = (uint16_t*)calloc((size_t)sets * n, sizeof(uint16_t));
+    lv->next = (uint16_t*)calloc(sets, sizeof(uint16_t));
+    lv->hist = (uint64_t*)calloc(lv->depth + 1, sizeof(uint64_t));
+    if (!lv->slot || !lv->owner || !lv->tree || !lv->next || !lv->hist) return false;
+    for (int i = 0; i < sets * n; i++) lv->owner[i] = SD_EMPTY;
+    return true;
+}
+
+bool stack_dist_init(Simulator* sim) {
+    bool ok = true;
+    sim->stack_dist = (StackDistCore*)calloc(NUM_CORES, sizeof(StackDistCore));
+    for (int i = 0; i < NUM_CORES && sim->stack_dist && ok; i++) {
+        for (int l = 0; l < SD_LEVELS && ok; l++) {
+            ok = level_init(&sim->stack_dist[i].level[l], 1 << l);
+        }
+    }
+    if (!sim->stack_dist || !ok) {
+        fprintf(stderr, "Error: Failed to allocate stack distance analysis\n");
+        stack_dist_free(sim);
+        return false;
+    }
+    return true;
+}
+
+void stack_dist_free(Simulator* sim) {
+    if (!sim->stack_dist) return;
+    for (int i = 0; i < NUM_CORES; i++) {
+        for (int l = 0; l < SD_LEVELS; l++) {
+            StackLevel* lv = &sim->stack_dist[i].level[l];
+            free(lv->slot);
+            free(lv->owner);
+            free(lv->tree);
+            free(lv->next);
+            free(lv->hist);
+        }
+    }
+    free(sim->stack_dist);
+    sim->stack_dist = NULL;
+}
+
+/* =============================================================================
+ * COLLECTION
+ * =============================================================================
+ */
+
+// Window of the set is full: keep its depth most recent blocks, renumbered
+// from slot 0, and forget the rest (their next distance is beyond depth)
+static void level_compact(StackLevel* lv, int set) {
+    int n = 2 * lv->depth;
+    uint32_t* owner = &lv->owner[(size_t)set * n];
+    uint16_t* tree = &lv->tree[(size_t)set * n];
+    int drop = tree_count(tree, n) - lv->depth;
+    int kept = 0;
+
+    for (int s = 0; s < n; s++) {
+        uint32_t block = owner[s];
+        if (block == SD_EMPTY) continue;
+        if (drop > 0) {
+            lv->slot[block] = 0;
+            drop--;
+            continue;
+        }
+        owner[kept] = block;
+        lv->slot[block] = (uint16_t)(kept + 1);
+        kept++;
+    }
+    memset(tree, 0, n * sizeof(uint16_t));
+    for (int s = 0; s < n; s++) {
+        if (s < kept) {
+            tree_add(tree, n, s, 1);
+        } else {
+            owner[s] = SD_EMPTY;
+        }
+    }
+    lv->next[set] = (uint16_t)kept;
+}
+
+static void level_access(StackLevel* lv, uint32_t block) {
+    int set = block & (lv->sets - 1);
+    int n = 2 * lv->depth;
+    uint32_t* owner = &lv->owner[(size_t)set * n];
+    uint16_t* tree = &lv->tree[(size_t)set * n];
+    int d = lv->depth;      // First use, or deeper than kept
+
+    if (lv->slot[block]) {
+        int old = lv->slot[block] - 1;
+        int above = tree_count(tree, lv->next[set]) - tree_count(tree, old + 1);
+        if (above < d) d = above;
+        tree_add(tree, n, old, -1);
+        owner[old] = SD_EMPTY;
+    }
+    if (lv->next[set] == n) level_compact(lv, set);
+
+    int s = lv->next[set]++;
+    owner[s] = block;
+    tree_add(tree, n, s, 1);
+    lv->slot[block] = (uint16_t)(s + 1);
+    lv->hist[d]++;
+}
+
+// A completed load, store or atomic of core_id
+void stack_dist_access(Simulator* sim, int core_id, uint32_t addr) {
+    StackDistCore* sd = &sim->stack_dist[core_id];
+    uint32_t block = (addr & 0x1FFFFF) / CACHE_BLOCK_SIZE;
+    for (int l = 0; l < SD_LEVELS; l++) level_access(&sd->level[l], block);
+    sd->refs++;
+}
+
+/* =============================================================================
+ * REPORT
+ * =============================================================================
+ */
+
+// Misses of an LRU cache with 2^level sets and `ways` ways (ways <= depth)
+static uint64_t level_misses(const StackLevel* lv, uint64_t refs, int ways) {
+    uint64_t hits = 0;
+    for (int d = 0; d < ways; d++) hits += lv->hist[d];
+    return refs - hits;
+}
+
+// One table; core < 0 sums every core
+static void write_curves(FILE* fp, const StackDistCore* sd, int core) {
+    uint64_t refs = 0;
+    for (int c = 0; c < NUM_CORES; c++) {
+        if (core < 0 || c == core) refs += sd[c].refs;
+    }
+    if (core < 0) {
+        fprintf(fp, "\nAll cores: %llu references\n", (unsigned long long)refs);
+    } else {
+        fprintf(fp, "\nCore %d: %llu references\n", core, (unsigned long long)refs);
+    }
+
+    fprintf(fp, "%8s", "words");
+    for (int a = 0; a < SD_LEVELS; a++) fprintf(fp, " %7d-way", 1 << a);
+    fprintf(fp, "\n");
+
+    for (int l = 0; l < SD_LEVELS; l++) {
+        int blocks = 1 << l;
+        fprintf(fp, "%8d", blocks * CACHE_BLOCK_SIZE);
+        for (int a = 0; a <= l; a++) {
+            // 2^a ways, so 2^(l - a) sets
+            uint64_t misses = 0;
+            for (int c = 0; c < NUM_CORES; c++) {
+                if (core < 0 || c == core) {
+                    misses += level_misses(&sd[c].level[l - a], sd[c].refs, 1 << a);
+                }
+            }
+            bool current = (blocks == CACHE_NUM_BLOCKS && a == 0);
+            double pct = refs ? 100.0 * (double)misses / (double)refs : 0.0;
+            fprintf(fp, " %10.2f%c", pct, current ? '*' : ' ');
+        }
+        fprintf(fp, "\n");
+    }
+}
+
+void stack_dist_write(Simulator* sim, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return;
+    }
+
+    fprintf(fp, "LRU miss ratio (%%) by capacity (rows) and associativity (columns)\n");
+    fprintf(fp, "%d-word blocks; own references only, coherence misses not included\n",
+            CACHE_BLOCK_SIZE);
+    fprintf(fp, "* = this build's cache (%d words, direct-mapped)\n", CACHE_SIZE);
+    for (int c = 0; c < NUM_CORES; c++) write_curves(fp, sim->stack_dist, c);
+    write_curves(fp, sim->stack_dist, -1);
+    fclose(fp);
+}
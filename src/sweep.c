@@ -0,0 +1,421 @@
+/*
+ * =============================================================================
+ * Parameter Sweep
+ * =============================================================================
+ * sim --sweep=AXIS [--sweep=AXIS ...] runs every combination of the axis
+ * values (the cartesian grid) on one input set and prints one table.
+ * An axis is a run-time option with a value list, "mem-delay=8,16,32",
+ * a flag toggled off/on, "forward", or a named axis:
+ * - protocol=mesi,c2c,mesif   spec MESI, clean cache-to-cache transfer,
+ *                             MESIF Forward responder
+ * Cache size, block size and core count are compile-time constants
+ * (sim.h), so they cannot be swept in one process; rebuild per geometry.
+ *
+ * Inputs are parsed once into a template Simulator. Each point copies the
+ * template's IMEM images and the used prefix of memin into its own
+ * Simulator (a plain copy; the images are not shared copy-on-write); the
+ * rest of main memory stays lazily zeroed. Worker threads
+ * take the next point from a shared atomic counter, so long and short
+ * configurations balance across workers without a static split.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+
+#define SWEEP_LABEL_SIZE    24
+#define SWEEP_OPTION_SIZE   64
+#define SWEEP_MAX_OPTIONS   2       // Options applied for one axis value
+
+// One value of an axis: its column text and the options it stands for
+typedef struct {
+    char    label[SWEEP_LABEL_SIZE];
+    char    options[SWEEP_MAX_OPTIONS][SWEEP_OPTION_SIZE];
+    int     noptions;
+} SweepValue;
+
+typedef struct {
+    char        name[SWEEP_LABEL_SIZE];
+    SweepValue  values[SWEEP_MAX_VALUES];
+    int         nvalues;
+} SweepAxis;
+
+typedef struct {
+    SimConfig   config;
+    int         value[SWEEP_MAX_AXES];  // Index into each axis
+    // Results
+    uint64_t    cycles;
+    uint64_t    instructions;
+    uint64_t    hits;
+    uint64_t    misses;
+    uint64_t    decode_stalls;
+    uint64_t    mem_stalls;
+    StopReason  stopped;
+    double      seconds;
+    bool        failed;                 // Could not allocate the simulator
+} SweepPoint;
+
+typedef struct {
+    SweepAxis       axes[SWEEP_MAX_AXES];
+    int             naxes;
+    SweepPoint*     points;
+    long            npoints;
+    volatile long   next;               // Next point to run
+    Simulator*      input;              // Template with the loaded inputs (read-only)
+    int             memin_words;        // Used prefix of input->main_memory
+} Sweep;
+
+void sweep_options_init(SweepOptions* opts) {
+    memset(opts, 0, sizeof(SweepOptions));
+    opts->in_dir = ".";
+}
+
+// Apply one "--sweep..." argument. Returns false if not recognised.
+bool sweep_parse_option(SweepOptions* opts, const char* arg) {
+    const char* val;
+
+    if ((val = option_value(arg, "--sweep=")) != NULL) {
+        if (opts->naxes >= SWEEP_MAX_AXES) return false;
+        opts->axes[opts->naxes++] = val;
+    } else if ((val = option_value(arg, "--sweep-dir=")) != NULL) {
+        opts->in_dir = val;
+    } else if ((val = option_value(arg, "--sweep-out=")) != NULL) {
+        opts->out_file = val;
+    } else {
+        return false;
+    }
+    return true;
+}
+
+/* =============================================================================
+ * GRID
+ * =============================================================================
+ */
+
+static void add_option(SweepValue* v, const char* option) {
+    if (v->noptions < SWEEP_MAX_OPTIONS) {
+        snprintf(v->options[v->noptions++], SWEEP_OPTION_SIZE, "%s", option);
+    }
+}
+
+// Options for value text of axis name ("on"/"off" toggle a flag)
+static bool axis_value(SweepValue* v, const char* name, const char* text) {
+    if (strlen(text) >= sizeof(v->label)) return false;
+    snprintf(v->label, sizeof(v->label), "%.*s", SWEEP_LABEL_SIZE - 1, text);
+    v->noptions = 0;
+    if (strcmp(name, "protocol") == 0) {
+        if (strcmp(text, "mesi") == 0) return true;
+        add_option(v, "--c2c");
+        if (strcmp(text, "c2c") == 0) return true;
+        add_option(v, "--c2c-responder=forward");
+        return strcmp(text, "mesif") == 0;
+    }
+    char option[SWEEP_OPTION_SIZE];
+    if (strcmp(text, "off") == 0) return true;
+    if (strcmp(text, "on") == 0) {
+        snprintf(option, sizeof(option), "--%s", name);
+    } else {
+        snprintf(option, sizeof(option), "--%s=%.*s", name, SWEEP_LABEL_SIZE - 1, text);
+    }
+    add_option(v, option);
+    return true;
+}
+
+// "name=v1,v2,..." or "flag" -> axis. Every value is checked against
+// parse_option now, so a typo or a malformed number ("mem-delay=abc")
+// fails before any run starts.
+static bool parse_axis(SweepAxis* axis, const char* spec) {
+    static const char* const fixed[] = {"cores", "cache-size", "block-size", "ways"};
+
+    while (*spec == '-') spec++;
+    const char* eq = strchr(spec, '=');
+    size_t len = eq ? (size_t)(eq - spec) : strlen(spec);
+    if (len == 0 || len >= sizeof(axis->name)) {
+        fprintf(stderr, "Error: Bad sweep axis '%s'\n", spec);
+        return false;
+    }
+    memcpy(axis->name, spec, len);
+    axis->name[len] = '\0';
+
+    for (size_t i = 0; i < sizeof(fixed) / sizeof(fixed[0]); i++) {
+        if (strcmp(axis->name, fixed[i]) == 0) {
+            fprintf(stderr, "Error: %s is fixed at compile time (NUM_CORES and the cache\n"
+                            "       geometry in sim.h); rebuild to compare values\n", axis->name);
+            return false;
+        }
+    }
+
+    // A bare flag is swept off and on
+    char list[256];
+    snprintf(list, sizeof(list), "%s", eq ? eq + 1 : "off,on");
+
+    axis->nvalues = 0;
+    char* p = list;
+    while (p && *p) {
+        char* comma = strchr(p, ',');
+        if (comma) *comma = '\0';
+        if (axis->nvalues >= SWEEP_MAX_VALUES) {
+            fprintf(stderr, "Error: More than %d values for %s\n", SWEEP_MAX_VALUES, axis->name);
+            return false;
+        }
+        SweepValue* v = &axis->values[axis->nvalues++];
+        SimConfig check;
+        config_init(&check);
+        bool ok = axis_value(v, axis->name, p);
+        for (int i = 0; ok && i < v->noptions; i++) ok = parse_option(&check, v->options[i]);
+        if (!ok || check.profile || check.sharing_profile || check.bus_stats ||
+            check.miss_classes || check.interval > 0 || check.mem_trace ||
+            check.stack_distance || check.functional ||
+            check.verify_dir) {
+            fprintf(stderr, "Error: Cannot sweep %s=%s\n", axis->name, p);
+            return false;
+        }
+        p = comma ? comma + 1 : NULL;
+    }
+    return axis->nvalues > 0;
+}
+
+// Expand the grid; the first axis varies slowest
+static bool build_points(Sweep* sw, const SimConfig* base) {
+    long n = 1;
+    for (int a = 0; a < sw->naxes; a++) {
+        n *= sw->axes[a].nvalues;
+        if (n > SWEEP_MAX_POINTS) {
+            fprintf(stderr, "Error: Sweep grid exceeds %d points\n", SWEEP_MAX_POINTS);
+            return false;
+        }
+    }
+    sw->points = (SweepPoint*)calloc(n, sizeof(SweepPoint));
+    if (!sw->points) {
+        fprintf(stderr, "Error: Failed to allocate %ld sweep points\n", n);
+        return false;
+    }
+    sw->npoints = n;
+
+    for (long i = 0; i < n; i++) {
+        SweepPoint* pt = &sw->points[i];
+        pt->config = *base;
+        long rest = i;
+        for (int a = sw->naxes - 1; a >= 0; a--) {
+            pt->value[a] = (int)(rest % sw->axes[a].nvalues);
+            rest /= sw->axes[a].nvalues;
+        }
+        for (int a = 0; a < sw->naxes; a++) {
+            SweepValue* v = &sw->axes[a].values[pt->value[a]];
+            for (int k = 0; k < v->noptions; k++) parse_option(&pt->config, v->options[k]);
+        }
+        config_resolve(&pt->config);
+        pt->config.quiet = true;
+    }
+    return true;
+}
+
+/* =============================================================================
+ * RUNS
+ * =============================================================================
+ */
+
+static void run_point(Sweep* sw, SweepPoint* pt) {
+    double start = platform_now();
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    if (!sim || !sim_init(sim)) {
+        if (sim) sim_cleanup(sim);
+        free(sim);
+        pt->failed = true;
+        return;
+    }
+    sim->config = pt->config;
+
+    // Shared read-only inputs
+    for (int c = 0; c < NUM_CORES; c++) {
+        memcpy(sim->core_mem[c].imem[0], sw->input->core_mem[c].imem[0],
+               sizeof(sim->core_mem[c].imem[0]));
+    }
+    memcpy(sim->main_memory, sw->input->main_memory, (size_t)sw->memin_words * sizeof(int32_t));
+
+    run_simulation(sim);
+
+    pt->cycles = sim->cycle - 1;
+    for (int c = 0; c < NUM_CORES; c++) {
+        Core* core = &sim->cores[c];
+        pt->instructions += core->instruction_count;
+        pt->hits += core->read_hits + core->write_hits;
+        pt->misses += core->read_misses + core->write_misses;
+        pt->decode_stalls += core->decode_stall_cycles;
+        pt->mem_stalls += core->mem_stall_cycles;
+    }
+    pt->stopped = sim->stopped;
+    sim_cleanup(sim);
+    free(sim);
+    pt->seconds = platform_now() - start;
+}
+
+static void sweep_worker(void* arg, int worker) {
+    Sweep* sw = (Sweep*)arg;
+    (void)worker;
+    for (;;) {
+        long i = platform_fetch_add(&sw->next, 1);
+        if (i >= sw->npoints) break;
+        run_point(sw, &sw->points[i]);
+    }
+}
+
+// Parse imem0-3 and memin of dir once
+static Simulator* load_template(const char* dir, int* memin_words) {
+    Simulator* sim = (Simulator*)malloc(sizeof(Simulator));
+    if (!sim || !sim_init(sim)) {
+        if (sim) sim_cleanup(sim);
+        free(sim);
+        return NULL;
+    }
+    SimFiles names;
+    sim_files_default(&names);
+    char path[512];
+    bool ok = true;
+    for (int c = 0; c < NUM_CORES; c++) {
+        snprintf(path, sizeof(path), "%s/%s", dir, names.imem[c]);
+        ok = load_imem(&sim->cores[c], 0, path) && ok;
+    }
+    snprintf(path, sizeof(path), "%s/%s", dir, names.memin);
+    ok = load_memin(sim, path) && ok;
+    if (!ok) {
+        sim_cleanup(sim);
+        free(sim);
+        return NULL;
+    }
+
+    *memin_words = 0;
+    for (int i = 0; i < MAIN_MEM_SIZE; i++) {
+        if (sim->main_memory[i] != 0) *memin_words = i + 1;
+    }
+    return sim;
+}
+
+/* =============================================================================
+ * REPORT
+ * =============================================================================
+ */
+
+static const char* stop_name(const SweepPoint* pt) {
+    if (pt->failed) return "error";
+    switch (pt->stopped) {
+        case STOP_DEADLOCK:    return "deadlock";
+        case STOP_CYCLE_LIMIT: return "limit";
+        default:               return "ok";
+    }
+}
+
+static double ratio(uint64_t num, uint64_t den) {
+    return den ? (double)num / den : 0.0;
+}
+
+static void print_table(const Sweep* sw) {
+    int width[SWEEP_MAX_AXES];
+    printf("%5s", "point");
+    for (int a = 0; a < sw->naxes; a++) {
+        const SweepAxis* axis = &sw->axes[a];
+        width[a] = (int)strlen(axis->name);
+        for (int v = 0; v < axis->nvalues; v++) {
+            int len = (int)strlen(axis->values[v].label);
+            if (len > width[a]) width[a] = len;
+        }
+        printf("  %-*s", width[a], axis->name);
+    }
+    printf(" %11s %11s %6s %6s %11s %11s %8s %7s\n", "cycles", "instr", "IPC",
+           "miss%", "mem_stall", "dec_stall", "status", "time_s");
+
+    for (long i = 0; i < sw->npoints; i++) {
+        const SweepPoint* pt = &sw->points[i];
+        printf("%5ld", i);
+        for (int a = 0; a < sw->naxes; a++) {
+            printf("  %-*s", width[a], sw->axes[a].values[pt->value[a]].label);
+        }
+        printf(" %11llu %11llu %6.3f %6.2f %11llu %11llu %8s %7.3f\n",
+               (unsigned long long)pt->cycles, (unsigned long long)pt->instructions,
+               ratio(pt->instructions, pt->cycles),
+               100.0 * ratio(pt->misses, pt->hits + pt->misses),
+               (unsigned long long)pt->mem_stalls, (unsigned long long)pt->decode_stalls,
+               stop_name(pt), pt->seconds);
+    }
+}
+
+static bool write_csv(const Sweep* sw, const char* filename) {
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot write %s\n", filename);
+        return false;
+    }
+    fprintf(fp, "point");
+    for (int a = 0; a < sw->naxes; a++) fprintf(fp, ",%s", sw->axes[a].name);
+    fprintf(fp, ",cycles,instructions,ipc,hits,misses,miss_rate,mem_stall,decode_stall,status,seconds\n");
+    for (long i = 0; i < sw->npoints; i++) {
+        const SweepPoint* pt = &sw->points[i];
+        fprintf(fp, "%ld", i);
+        for (int a = 0; a < sw->naxes; a++) {
+            fprintf(fp, ",%s", sw->axes[a].values[pt->value[a]].label);
+        }
+        fprintf(fp, ",%llu,%llu,%.4f,%llu,%llu,%.4f,%llu,%llu,%s,%.4f\n",
+                (unsigned long long)pt->cycles, (unsigned long long)pt->instructions,
+                ratio(pt->instructions, pt->cycles),
+                (unsigned long long)pt->hits, (unsigned long long)pt->misses,
+                ratio(pt->misses, pt->hits + pt->misses),
+                (unsigned long long)pt->mem_stalls, (unsigned long long)pt->decode_stalls,
+                stop_name(pt), pt->seconds);
+    }
+    fclose(fp);
+    return true;
+}
+
+/* =============================================================================
+ * DRIVER
+ * =============================================================================
+ */
+
+static int sweep_execute(Sweep* sw, const SimConfig* config, const SweepOptions* opts,
+                         int jobs) {
+    sw->naxes = opts->naxes;
+    for (int a = 0; a < sw->naxes; a++) {
+        if (!parse_axis(&sw->axes[a], opts->axes[a])) return 1;
+    }
+    if (!build_points(sw, config)) return 1;
+
+    sw->input = load_template(opts->in_dir, &sw->memin_words);
+    if (!sw->input) {
+        fprintf(stderr, "Error: Cannot load sweep inputs from %s\n", opts->in_dir);
+        return 1;
+    }
+
+    int workers = (jobs > 0) ? jobs : platform_cpu_count();
+    if (workers > sw->npoints) workers = (int)sw->npoints;
+    printf("Sweep: %ld configurations of %s on %d threads\n\n", sw->npoints,
+           opts->in_dir, workers);
+
+    double start = platform_now();
+    platform_run_parallel(workers, sweep_worker, sw);
+    double wall = platform_now() - start;
+
+    print_table(sw);
+    printf("\n%ld runs in %.2fs (%.1f runs/s)\n", sw->npoints, wall,
+           wall > 0 ? sw->npoints / wall : 0.0);
+    if (opts->out_file) {
+        if (!write_csv(sw, opts->out_file)) return 1;
+        printf("Wrote %s\n", opts->out_file);
+    }
+    return 0;
+}
+
+int sweep_run(const SimConfig* config, const SweepOptions* opts, int jobs) {
+    Sweep* sw = (Sweep*)calloc(1, sizeof(Sweep));
+    if (!sw) {
+        fprintf(stderr, "Error: Failed to allocate sweep\n");
+        return 1;
+    }
+    int code = sweep_execute(sw, config, opts, jobs);
+    if (sw->input) {
+        sim_cleanup(sw->input);
+        free(sw->input);
+    }
+    free(sw->points);
+    free(sw);
+    return code;
+}
@@ -0,0 +1,577 @@
+/*
+ * =============================================================================
+ * Output Files, Verification and the Regression Suite
+ * =============================================================================
+ * Every trace and dump line goes through output_line. Normally the line is
+ * written to its file. With --verify=DIR the file is not written; each line
+ * is compared with the same line of DIR/<file name> as soon as it is
+ * produced, and the run stops at the first difference, which is reported
+ * as file, line, cycle, core and field. An output with no expected file
+ * may instead be listed in DIR/hashes.txt (--make-hashes); its lines are
+ * folded into a 64-bit FNV-1a hash that is compared when the file closes.
+ * Line ends are normalised (CR LF or LF), so expected files written on
+ * Windows compare equal.
+ *
+ * --test-suite runs every DIR/<test> that has imem0.txt and an expected/
+ * directory, each on its own Simulator, spread over worker threads. A test
+ * that needs model options lists them in DIR/<test>/options.txt.
+ * =============================================================================
+ */
+
+#include "sim.h"
+#include "platform.h"
+#include <stdarg.h>
+
+#define FNV_OFFSET          0xCBF29CE484222325ULL
+#define FNV_PRIME           0x00000100000001B3ULL
+#define VERIFY_LINE_SIZE    512
+#define VERIFY_MAX_FIELDS   24
+
+struct VerifyStream {
+    Verifier*       verifier;
+    OutputKind      kind;
+    int             index;              // Core
+    char            name[64];           // File name, for messages
+    FILE*           expected;           // Compared line by line, or NULL
+    bool            use_hash;           // Compared by hash at close
+    uint64_t        expected_hash;
+    uint64_t        hash;
+    uint64_t        line;               // Lines produced so far
+};
+
+static const char* base_name(const char* path) {
+    const char* slash = strrchr(path, '/');
+    const char* bslash = strrchr(path, '\\');
+    if (bslash > slash) slash = bslash;
+    return slash ? slash + 1 : path;
+}
+
+// Drop the line end (LF or CR LF) in place
+static void strip_eol(char* line) {
+    size_t len = strlen(line);
+    while (len > 0 && (line[len - 1] == '\n' || line[len - 1] == '\r')) line[--len] = '\0';
+}
+
+// Hash of one line without its line end, plus a LF
+static uint64_t hash_line(uint64_t hash, const char* line) {
+    for (const unsigned char* p = (const unsigned char*)line; *p; p++) {
+        hash = (hash ^ *p) * FNV_PRIME;
+    }
+    return (hash ^ '\n') * FNV_PRIME;
+}
+
+/* =============================================================================
+ * MISMATCH REPORT
+ * =============================================================================
+ */
+
+// Split at spaces in place (strtok is not safe across suite threads)
+static int split_fields(char* line, char** fields) {
+    int n = 0;
+    char* p = line;
+    while (*p && n < VERIFY_MAX_FIELDS) {
+        while (*p == ' ' || *p == '\t') *p++ = '\0';
+        if (!*p) break;
+        fields[n++] = p;
+        while (*p && *p != ' ' && *p != '\t') p++;
+    }
+    return n;
+}
+
+// Where the first differing field is: "cycle 12, core 1, R5", "address 0x000040"
+static void describe_field(VerifyStream* vs, char** fields, int field, char* buf, size_t size) {
+    static const char* const core_fields[] = { "cycle", "fetch", "decode", "exec", "mem", "wb" };
+    static const char* const bus_fields[] = { "cycle", "origid", "cmd", "addr", "data", "shared" };
+    unsigned long long item = vs->line - 1;
+
+    switch (vs->kind) {
+        case OUT_CORE_TRACE:
+            if (field < 6) {
+                snprintf(buf, size, "cycle %s, core %d, %s", fields[0], vs->index, core_fields[field]);
+            } else {
+                snprintf(buf, size, "cycle %s, core %d, R%d", fields[0], vs->index, field - 6 + 2);
+            }
+            break;
+        case OUT_BUS_TRACE:
+            snprintf(buf, size, "cycle %s, bus %s", fields[0], bus_fields[field < 6 ? field : 5]);
+            break;
+        case OUT_MEMOUT:
+            snprintf(buf, size, "address 0x%06llX", item);
+            break;
+        case OUT_REGOUT:
+            snprintf(buf, size, "core %d, R%llu", vs->index, item + 2);
+            break;
+        case OUT_DSRAM:
+            snprintf(buf, size, "core %d, dsram[%llu]", vs->index, item);
+            break;
+        case OUT_TSRAM:
+            snprintf(buf, size, "core %d, tsram[%llu]", vs->index, item);
+            break;
+        case OUT_STATS:
+            snprintf(buf, size, "core %d, %s", vs->index, fields[0]);
+            break;
+    }
+}
+
+// Record the first divergence; expected or got is NULL at end of file
+static void report_mismatch(VerifyStream* vs, const char* expected, const char* got) {
+    Verifier* v = vs->verifier;
+    char* msg = v->result.message;
+    size_t size = sizeof(v->result.message);
+
+    v->failed = true;
+    if (!expected) {
+        snprintf(msg, size, "%s line %llu: expected end of file, got \"%s\"", vs->name,
+                 (unsigned long long)vs->line, got);
+        return;
+    }
+    if (!got) {
+        snprintf(msg, size, "%s line %llu: expected \"%s\", got end of output", vs->name,
+                 (unsigned long long)vs->line, expected);
+        return;
+    }
+
+    char e_copy[VERIFY_LINE_SIZE], g_copy[VERIFY_LINE_SIZE], where[96];
+    char* e_fields[VERIFY_MAX_FIELDS];
+    char* g_fields[VERIFY_MAX_FIELDS];
+    snprintf(e_copy, sizeof(e_copy), "%s", expected);
+    snprintf(g_copy, sizeof(g_copy), "%s", got);
+    int ne = split_fields(e_copy, e_fields);
+    int ng = split_fields(g_copy, g_fields);
+
+    int field = 0;
+    while (field < ne && field < ng && strcmp(e_fields[field], g_fields[field]) == 0) field++;
+    if (ne == 0 || ng == 0) {
+        snprintf(msg, size, "%s line %llu: expected \"%s\", got \"%s\"", vs->name,
+                 (unsigned long long)vs->line, expected, got);
+        return;
+    }
+    describe_field(vs, (vs->kind == OUT_STATS) ? e_fields : g_fields, field, where, sizeof(where));
+    snprintf(msg, size, "%s line %llu: %s: expected %s, got %s", vs->name,
+             (unsigned long long)vs->line, where, field < ne ? e_fields[field] : "(nothing)",
+             field < ng ? g_fields[field] : "(nothing)");
+}
+
+/* =============================================================================
+ * OUTPUT FILES
+ * =============================================================================
+ */
+
+static bool find_hash(Verifier* v, const char* name, uint64_t* hash) {
+    for (int i = 0; i < v->nhashes; i++) {
+        if (strcmp(v->hash_names[i], name) == 0) {
+            *hash = v->hashes[i];
+            return true;
+        }
+    }
+    return false;
+}
+
+// Open an output for writing, or with --verify for comparison. An output
+// that has nothing to compare with is dropped (out stays closed).
+bool output_open(Simulator* sim, OutputFile* out, const char* filename, OutputKind kind, int index) {
+    Verifier* v = sim->verify;
+    out->fp = NULL;
+    out->check = NULL;
+
+    if (!v) {
+        out->fp = fopen(filename, "w");
+        if (!out->fp) {
+            fprintf(stderr, "Error: Cannot create %s\n", filename);
+            return false;
+        }
+        return true;
+    }
+
+    VerifyStream* vs = (VerifyStream*)calloc(1, sizeof(VerifyStream));
+    if (!vs) {
+        fprintf(stderr, "Error: Failed to allocate verify stream\n");
+        return false;
+    }
+    char path[512];
+    vs->verifier = v;
+    vs->kind = kind;
+    vs->index = index;
+    snprintf(vs->name, sizeof(vs->name), "%s", base_name(filename));
+    snprintf(path, sizeof(path), "%s/%s", v->expected_dir, vs->name);
+    vs->expected = fopen(path, "r");
+    if (!vs->expected) vs->use_hash = find_hash(v, vs->name, &vs->expected_hash);
+    if (!vs->expected && !vs->use_hash) {
+        v->result.missing++;
+        free(vs);
+        return true;
+    }
+    vs->hash = FNV_OFFSET;
+    v->result.checked++;
+    out->check = vs;
+    return true;
+}
+
+static void verify_line(VerifyStream* vs, const char* line) {
+    char got[VERIFY_LINE_SIZE], expected[VERIFY_LINE_SIZE];
+    if (vs->verifier->failed) return;
+
+    vs->line++;
+    snprintf(got, sizeof(got), "%s", line);
+    strip_eol(got);
+    if (vs->use_hash) {
+        vs->hash = hash_line(vs->hash, got);
+        return;
+    }
+    if (!fgets(expected, sizeof(expected), vs->expected)) {
+        report_mismatch(vs, NULL, got);
+        return;
+    }
+    strip_eol(expected);
+    if (strcmp(expected, got) != 0) report_mismatch(vs, expected, got);
+}
+
+// One complete line, including its '\n'
+void output_line(OutputFile* out, const char* line) {
+    if (out->fp) {
+        fputs(line, out->fp);
+    } else if (out->check) {
+        verify_line(out->check, line);
+    }
+}
+
+void output_printf(OutputFile* out, const char* fmt, ...) {
+    char line[VERIFY_LINE_SIZE];
+    va_list ap;
+    if (!out->fp && !out->check) return;
+
+    va_start(ap, fmt);
+    vsnprintf(line, sizeof(line), fmt, ap);
+    va_end(ap);
+    output_line(out, line);
+}
+
+// Close; a compared output must also have reached the end of the expected file
+void output_close(OutputFile* out) {
+    if (out->fp) {
+        fclose(out->fp);
+        out->fp = NULL;
+    }
+    VerifyStream* vs = out->check;
+    if (!vs) return;
+
+    Verifier* v = vs->verifier;
+    if (!v->failed && vs->use_hash && vs->hash != vs->expected_hash) {
+        v->failed = true;
+        snprintf(v->result.message, sizeof(v->result.message),
+                 "%s: %llu lines, hash %016llX, expected %016llX (%s)", vs->name,
+                 (unsigned long long)vs->line, (unsigned long long)vs->hash,
+                 (unsigned long long)vs->expected_hash, VERIFY_HASH_FILE);
+    }
+    if (!v->failed && vs->expected) {
+        char expected[VERIFY_LINE_SIZE];
+        while (fgets(expected, sizeof(expected), vs->expected)) {
+            strip_eol(expected);
+            if (expected[0] == '\0') continue;
+            vs->line++;
+            report_mismatch(vs, expected, NULL);
+            break;
+        }
+    }
+    if (vs->expected) fclose(vs->expected);
+    free(vs);
+    out->check = NULL;
+}
+
+/* =============================================================================
+ * VERIFIER
+ * =============================================================================
+ */
+
+bool verify_init(Simulator* sim, const char* expected_dir) {
+    Verifier* v = (Verifier*)calloc(1, sizeof(Verifier));
+    if (!v) {
+        fprintf(stderr, "Error: Failed to allocate verifier\n");
+        return false;
+    }
+    v->expected_dir = expected_dir;
+
+    // Optional hashes for outputs whose expected file is not kept
+    char path[512], line[256];
+    snprintf(path, sizeof(path), "%s/%s", expected_dir, VERIFY_HASH_FILE);
+    FILE* fp = fopen(path, "r");
+    while (fp && fgets(line, sizeof(line), fp) && v->nhashes < VERIFY_MAX_HASHES) {
+        unsigned long long hash;
+        if (sscanf(line, "%llx %63s", &hash, v->hash_names[v->nhashes]) == 2) {
+            v->hashes[v->nhashes++] = hash;
+        }
+    }
+    if (fp) fclose(fp);
+
+    sim->verify = v;
+    return true;
+}
+
+void verify_finish(Simulator* sim, VerifyResult* result) {
+    Verifier* v = sim->verify;
+    if (!v->failed && v->result.checked == 0) {
+        v->failed = true;
+        snprintf(v->result.message, sizeof(v->result.message), "no expected outputs in %s",
+                 v->expected_dir);
+    }
+    v->result.passed = !v->failed;
+    v->result.cycles = sim->cycle - 1;
+    *result = v->result;
+
+    if (sim->config.quiet) return;
+    if (result->passed) {
+        printf("Verify: PASS, %d outputs match %s\n", result->checked, v->expected_dir);
+    } else {
+        printf("Verify: FAIL, %s\n", result->message);
+    }
+    if (result->missing > 0) {
+        printf("Verify: %d outputs not checked (no expected file or hash)\n", result->missing);
+    }
+}
+
+void verify_free(Simulator* sim) {
+    free(sim->verify);
+    sim->verify = NULL;
+}
+
+// hashes.txt for the expected outputs present in dir
+bool verify_make_hashes(const char* dir) {
+    const char* names[5 * NUM_CORES + 2];
+    int nnames = 0, written = 0;
+    SimFiles files;
+    char path[512];
+
+    sim_files_default(&files);
+    names[nnames++] = files.memout;
+    names[nnames++] = files.bus_trace;
+    for (int i = 0; i < NUM_CORES; i++) {
+        names[nnames++] = files.regout[i];
+        names[nnames++] = files.core_trace[i];
+        names[nnames++] = files.dsram[i];
+        names[nnames++] = files.tsram[i];
+        names[nnames++] = files.stats[i];
+    }
+
+    snprintf(path, sizeof(path), "%s/%s", dir, VERIFY_HASH_FILE);
+    FILE* out = fopen(path, "w");
+    if (!out) {
+        fprintf(stderr, "Error: Cannot create %s\n", path);
+        return false;
+    }
+    for (int n = 0; n < nnames; n++) {
+        char line[VERIFY_LINE_SIZE];
+        uint64_t hash = FNV_OFFSET;
+        snprintf(path, sizeof(path), "%s/%s", dir, names[n]);
+        FILE* fp = fopen(path, "r");
+        if (!fp) continue;
+        while (fgets(line, sizeof(line), fp)) {
+            strip_eol(line);
+            hash = hash_line(hash, line);
+        }
+        fclose(fp);
+        fprintf(out, "%016llX %s\n", (unsigned long long)hash, names[n]);
+        written++;
+    }
+    fclose(out);
+    printf("Wrote %s/%s (%d files)\n", dir, VERIFY_HASH_FILE, written);
+    return written > 0;
+}
+
+/* =============================================================================
+ * REGRESSION SUITE
+ * =============================================================================
+ */
+
+typedef struct {
+    char            name[PLATFORM_NAME_MAX];
+    SimConfig       config;             // Suite options plus options.txt
+    char*           thread_imem[NUM_CORES][MAX_HW_THREADS];  // From options.txt
+    bool            options_ok;
+    VerifyResult    result;
+    double          seconds;
+} SuiteTest;
+
+typedef struct {
+    SimConfig       config;
+    const char*     dir;
+    SuiteTest*      tests;
+    int             count;
+    int             workers;
+} Suite;
+
+static bool file_exists(const char* path) {
+    FILE* fp = fopen(path, "r");
+    if (!fp) return false;
+    fclose(fp);
+    return true;
+}
+
+// Report options would write the same files from every test
+static void suite_quiet(SimConfig* config) {
+    config->quiet = true;
+    config->profile = false;
+    config->sharing_profile = false;
+    config->bus_stats = false;
+    config->miss_classes = false;
+    config->interval = 0;
+    config->mem_trace = false;
+    config->stack_distance = false;
+    config->functional = false;     // Expected traces need the pipeline
+}
+
+// Apply DIR/<test>/options.txt: whitespace-separated options, '#' comments
+// "--thread-imem=C:T:FILE" in options.txt, FILE relative to the test directory
+static bool suite_thread_imem(const Suite* suite, SuiteTest* test, const char* opt) {
+    int c, t;
+    const char* file;
+
+    if (!parse_thread_imem(opt, &c, &t, &file)) return false;
+    size_t size = strlen(suite->dir) + strlen(test->name) + strlen(file) + 3;
+    char* path = (char*)malloc(size);
+    if (!path) return false;
+    snprintf(path, size, "%s/%s/%s", suite->dir, test->name, file);
+    free(test->thread_imem[c][t]);
+    test->thread_imem[c][t] = path;
+    return true;
+}
+
+static bool suite_test_options(const Suite* suite, SuiteTest* test) {
+    char path[512], line[VERIFY_LINE_SIZE];
+    bool ok = true;
+
+    test->config = suite->config;
+    snprintf(path, sizeof(path), "%s/%s/%s", suite->dir, test->name, SUITE_OPTIONS_FILE);
+    FILE* fp = fopen(path, "r");
+    if (!fp) return true;
+    while (ok && fgets(line, sizeof(line), fp)) {
+        char* comment = strchr(line, '#');
+        if (comment) *comment = '\0';
+        for (char* opt = strtok(line, " \t\r\n"); opt; opt = strtok(NULL, " \t\r\n")) {
+            bool opt_ok = (strncmp(opt, "--thread-imem=", 14) == 0) ?
+                          suite_thread_imem(suite, test, opt) :
+                          parse_option(&test->config, opt);
+            if (!opt_ok) {
+                snprintf(test->result.message, sizeof(test->result.message),
+                         "%s: bad option %s", SUITE_OPTIONS_FILE, opt);
+                ok = false;
+                break;
+            }
+        }
+    }
+    fclose(fp);
+    config_resolve(&test->config);
+    suite_quiet(&test->config);
+
+    // As on the command line, an image for a thread that does not run fails
+    for (int c = 0; ok && c < NUM_CORES; c++) {
+        for (int t = test->config.hw_threads; ok && t < MAX_HW_THREADS; t++) {
+            if (!test->thread_imem[c][t]) continue;
+            snprintf(test->result.message, sizeof(test->result.message),
+                     "%s: --thread-imem=%d:%d needs --threads=%d or more",
+                     SUITE_OPTIONS_FILE, c, t, t + 1);
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+static void suite_run_test(const Suite* suite, SuiteTest* test) {
+    char imem[NUM_CORES][512], memin[512], expected[512];
+    SimConfig config = test->config;
+    SimFiles files;
+
+    // Output names only select the expected file; nothing is written
+    sim_files_default(&files);
+    for (int i = 0; i < NUM_CORES; i++) {
+        snprintf(imem[i], sizeof(imem[i]), "%s/%s/imem%d.txt", suite->dir, test->name, i);
+        files.imem[i] = imem[i];
+        for (int t = 1; t < MAX_HW_THREADS; t++) files.thread_imem[i][t] = test->thread_imem[i][t];
+    }
+    snprintf(memin, sizeof(memin), "%s/%s/memin.txt", suite->dir, test->name);
+    snprintf(expected, sizeof(expected), "%s/%s/expected", suite->dir, test->name);
+    files.memin = memin;
+    config.verify_dir = expected;
+
+    snprintf(test->result.message, sizeof(test->result.message), "simulator did not start");
+    double start = platform_now();
+    simulate_files(&config, &files, NULL, &test->result);
+    test->seconds = platform_now() - start;
+}
+
+// Worker w runs tests w, w + workers, ...
+static void suite_worker(void* arg, int worker) {
+    Suite* suite = (Suite*)arg;
+    for (int i = worker; i < suite->count; i += suite->workers) {
+        if (suite->tests[i].options_ok) suite_run_test(suite, &suite->tests[i]);
+    }
+}
+
+static int compare_names(const void* a, const void* b) {
+    return strcmp((const char*)a, (const char*)b);
+}
+
+int run_test_suite(const SimConfig* config, const char* dir, int jobs) {
+    char (*names)[PLATFORM_NAME_MAX] =
+        (char (*)[PLATFORM_NAME_MAX])calloc(SUITE_MAX_TESTS, PLATFORM_NAME_MAX);
+    Suite suite;
+    int failed = 0;
+
+    memset(&suite, 0, sizeof(Suite));
+    suite.tests = (SuiteTest*)calloc(SUITE_MAX_TESTS, sizeof(SuiteTest));
+    int n = names ? platform_list_dirs(dir, names, SUITE_MAX_TESTS) : -1;
+    if (n < 0 || !suite.tests) {
+        fprintf(stderr, "Error: Cannot read test directory %s\n", dir);
+        free(names);
+        free(suite.tests);
+        return 1;
+    }
+    qsort(names, n, PLATFORM_NAME_MAX, compare_names);
+
+    suite.config = *config;
+    suite_quiet(&suite.config);
+    suite.dir = dir;
+
+    // A test has inputs and an expected/ directory with a file or hashes
+    for (int i = 0; i < n; i++) {
+        char imem[512], memout[512], hashes[512];
+        snprintf(imem, sizeof(imem), "%s/%s/imem0.txt", dir, names[i]);
+        snprintf(memout, sizeof(memout), "%s/%s/expected/memout.txt", dir, names[i]);
+        snprintf(hashes, sizeof(hashes), "%s/%s/expected/%s", dir, names[i], VERIFY_HASH_FILE);
+        if (!file_exists(imem) || (!file_exists(memout) && !file_exists(hashes))) {
+            printf("%-20s skipped (no expected outputs)\n", names[i]);
+            continue;
+        }
+        SuiteTest* t = &suite.tests[suite.count++];
+        snprintf(t->name, PLATFORM_NAME_MAX, "%s", names[i]);
+        t->options_ok = suite_test_options(&suite, t);
+    }
+    free(names);
+
+    suite.workers = (jobs > 0) ? jobs : platform_cpu_count();
+    if (suite.workers > suite.count) suite.workers = suite.count;
+
+    double start = platform_now();
+    if (suite.count > 0) platform_run_parallel(suite.workers, suite_worker, &suite);
+    double elapsed = platform_now() - start;
+
+    for (int i = 0; i < suite.count; i++) {
+        SuiteTest* t = &suite.tests[i];
+        if (t->result.passed) {
+            printf("%-20s PASS %10llu cycles %8.2fs\n", t->name,
+                   (unsigned long long)t->result.cycles, t->seconds);
+        } else {
+            printf("%-20s FAIL %s\n", t->name, t->result.message);
+            failed++;
+        }
+    }
+    printf("\n%d passed, %d failed in %.2fs (%d threads)\n", suite.count - failed, failed,
+           elapsed, suite.workers);
+
+    for (int i = 0; i < suite.count; i++) {
+        for (int c = 0; c < NUM_CORES; c++) {
+            for (int t = 1; t < MAX_HW_THREADS; t++) free(suite.tests[i].thread_imem[c][t]);
+        }
+    }
+    free(suite.tests);
+    return (failed > 0 || suite.count == 0) ? 1 : 0;
+}
@@ -1,121 +1,546 @@
+/*
+ * Workload generator: writes imemN.txt and memin.txt for the simulator,
+ * plus expected_memout.txt, the final memory computed natively.
+ *
+ *   testgen [--workload=W] [--out=DIR] [--cores=N] [--size=N] [--ws=N]
+ *           [--stride=N] [--iters=N] [--pattern=P] [--hold=N] [--seed=N]
+ *
+ * Workloads:
+ *   matmul   C = A * B, size x size, rows split across the cores
+ *   sharing  each core read-modify-writes ws words, stride apart, iters
+ *            times. --pattern picks where the words live:
+ *              private        own region per core
+ *              read-shared    one table read by all cores (sum stored)
+ *              migratory      one record updated by the cores in turn
+ *              false-sharing  core c owns word c of every shared block
+ *   lock     iters CAS spinlock acquisitions per core; the critical
+ *            section increments hold shared words (contention knob)
+ *   chase    walk a random cyclic list of ws nodes, stride words apart,
+ *            iters times around (one dependent load per step)
+ *
+ * The simulator writes dirty cache lines back before memout.txt, so a
+ * correct run matches exactly:
+ *   sim ... && fc memout.txt expected_memout.txt   (cmp on POSIX)
+ */
+
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
 #include <stdint.h>
 
-// Opcodes
+// Opcodes (must match src/sim.h)
 #define OP_ADD  0x00
 #define OP_SUB  0x01
+#define OP_OR   0x03
 #define OP_MUL  0x05
+#define OP_SLL  0x06
 #define OP_BEQ  0x09
 #define OP_BNE  0x0A
 #define OP_LW   0x10
 #define OP_SW   0x11
-#define OP_HALT 0x15
+#define OP_CAS  0x13
+#define OP_HALT 0x14
 
-// Registers
+// Registers: R0 reads 0, R1 reads the instruction's own immediate.
+// Branches jump to R[rd][9:0], so "rd = R1" makes the immediate the target.
 #define R0 0
-#define R1 1 // i (Row)
-#define R2 2 // j (Col)
-#define R3 3 // k (Dot Prod Iterator)
-#define R4 4 // Base A
-#define R5 5 // Base B
-#define R6 6 // Base C
-#define R7 7 // Sum
-#define R8 8 // Val A
-#define R9 9 // Val B
-#define R10 10 // Constant 16 (Matrix Size)
-#define R11 11 // Constant 1 (Step)
-#define R12 12 // Temp
-#define R13 13 // Loop Limit for i (End Row)
+#define R1 1
+#define R2 2
+#define R3 3
+#define R4 4
+#define R5 5
+#define R6 6
+#define R7 7
+#define R8 8
+#define R9 9
+#define R10 10
+#define R11 11
+#define R12 12
+#define R13 13
+#define R14 14
+
+// Machine (must match src/sim.h)
+#define MEM_WORDS       (1 << 21)
+#define IMEM_WORDS      1024
+#define BLOCK_WORDS     8
+#define SIM_CORES       4       // imem files the simulator always reads
+#define MAX_CORES       64
+
+// Memory layout
+#define SHARED_BASE     0x000000    // Matrices, shared tables, locks
+#define RESULT_BASE     0x007C00    // One block per core for results
+#define PRIVATE_BASE    0x008000    // Per-core regions
+#define PRIVATE_WORDS   0x004000
+
+typedef enum { W_MATMUL, W_SHARING, W_LOCK, W_CHASE } Workload;
+typedef enum { P_PRIVATE, P_READ_SHARED, P_MIGRATORY, P_FALSE_SHARING } Pattern;
+
+typedef struct {
+    Workload    workload;
+    Pattern     pattern;
+    const char* out;
+    int         cores;
+    int         size;       // Matrix size
+    int         ws;         // Working set: words (sharing) or nodes (chase)
+    int         stride;     // Words between consecutive accesses / nodes
+    int         iters;
+    int         hold;       // Lock: words updated in the critical section
+    unsigned    seed;
+} Params;
+
+typedef struct {
+    uint32_t code[IMEM_WORDS];
+    int n;
+} Prog;
+
+static int32_t* mem;        // memin image
+static int32_t* expect;     // Final memory, computed natively
 
 // Helper to format instruction
 uint32_t enc(int op, int rd, int rs, int rt, int imm) {
     return ((op & 0xFF) << 24) | ((rd & 0xF) << 20) | ((rs & 0xF) << 16) | ((rt & 0xF) << 12) | (imm & 0xFFF);
 }
 
-int main() {
-    // 1. Generate memin.txt (Inputs)
-    FILE *fmem = fopen("memin.txt", "w");
-    for (int i = 0; i < 512; i++) fprintf(fmem, "%08X\n", 1); // Fill A and B with 1s
-    for (int i = 512; i < 1024; i++) fprintf(fmem, "00000000\n");
-    fclose(fmem);
-    printf("Generated memin.txt\n");
-
-    // 2. Generate imemX.txt for ALL 4 CORES
-    for (int core = 0; core < 4; core++) {
-        char filename[20];
-        sprintf(filename, "imem%d.txt", core);
-        FILE *fimem = fopen(filename, "w");
-
-        int start_row = core * 4;
-        int end_row = start_row + 4;
-
-        // Init Constants
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R4, R0, R0, 0x000)); // Base A
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R5, R0, R0, 0x100)); // Base B
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R6, R0, R0, 0x200)); // Base C
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R10, R0, R0, 16));   // Size 16
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R11, R0, R0, 1));    // Step 1
-
-        // Init Loop Bounds for this Core
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R1, R0, R0, start_row)); // i = start_row
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R13, R0, R0, end_row));  // Limit = end_row
-
-        // [Label LOOP_I] Check if i != Limit. If i == Limit, jump to Halt.
-        // We do the check at the end (do-while style) or check before.
-        // Let's stick to the previous structure:
-
-        // 7: [Label LOOP_J_START] j = 0
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R2, R0, R0, 0));
-
-        // 8: [Label LOOP_K_START] Sum = 0
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R7, R0, R0, 0));
-        // 9: k = 0
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R3, R0, R0, 0));
-
-        // 10: [Label LOOP_K_BODY] Offset A = i * 16
-        fprintf(fimem, "%08X\n", enc(OP_MUL, R12, R1, R10, 0));
-        // 11: Offset A += k
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R12, R12, R3, 0));
-        // 12: Load A
-        fprintf(fimem, "%08X\n", enc(OP_LW,  R8, R4, R12, 0));
-
-        // 13: Offset B = k * 16
-        fprintf(fimem, "%08X\n", enc(OP_MUL, R12, R3, R10, 0));
-        // 14: Offset B += j
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R12, R12, R2, 0));
-        // 15: Load B
-        fprintf(fimem, "%08X\n", enc(OP_LW,  R9, R5, R12, 0));
-
-        // 16: Mult and Add
-        fprintf(fimem, "%08X\n", enc(OP_MUL, R12, R8, R9, 0));
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R7, R7, R12, 0));
-
-        // 17: k++
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R3, R3, R11, 0));
-        // 18: Branch K if k != 16. Target: Line 10. Offset = 10 - (18+1) = -9 (0xFF7)
-        fprintf(fimem, "%08X\n", enc(OP_BNE, 0, R3, R10, 0xFF7));
-
-        // 19: Offset C = i * 16
-        fprintf(fimem, "%08X\n", enc(OP_MUL, R12, R1, R10, 0));
-        // 20: Offset C += j
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R12, R12, R2, 0));
-        // 21: Store C
-        fprintf(fimem, "%08X\n", enc(OP_SW,  R7, R6, R12, 0));
-
-        // 22: j++
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R2, R2, R11, 0));
-        // 23: Branch J if j != 16. Target: Line 8 (Sum=0). Offset = 8 - (23+1) = -16 (0xFF0)
-        fprintf(fimem, "%08X\n", enc(OP_BNE, 0, R2, R10, 0xFF0));
-
-        // 24: i++
-        fprintf(fimem, "%08X\n", enc(OP_ADD, R1, R1, R11, 0));
-        // 25: Branch I if i != Limit (R13). Target: Line 7 (j=0). Offset = 7 - (25+1) = -19 (0xFED)
-        fprintf(fimem, "%08X\n", enc(OP_BNE, 0, R1, R13, 0xFED));
-
-        // 26: Halt
-        fprintf(fimem, "%08X\n", enc(OP_HALT, 0, 0, 0, 0));
-        fclose(fimem);
-        printf("Generated imem%d.txt for Rows %d-%d\n", core, start_row, end_row - 1);
-    }
-    return 0;
+/* ---------------------------------------------------------------------------
+ * Code emission
+ * ---------------------------------------------------------------------------
+ */
+
+static void emit(Prog* p, int op, int rd, int rs, int rt, int imm) {
+    if (p->n < IMEM_WORDS) p->code[p->n] = enc(op, rd, rs, rt, imm);
+    p->n++;
+}
+
+static int here(Prog* p) {
+    return p->n;
+}
+
+// rd = value, for any 32-bit value (12-bit signed immediates, built up 10 bits at a time)
+static void emit_li(Prog* p, int rd, int32_t value) {
+    if (value >= -2048 && value <= 2047) {
+        emit(p, OP_ADD, rd, R0, R1, value);
+        return;
+    }
+    emit_li(p, rd, value >> 10);
+    emit(p, OP_SLL, rd, rd, R1, 10);
+    emit(p, OP_OR, rd, rd, R1, value & 0x3FF);
+}
+
+// Branch to target if (rs op rt), with a NOP in the delay slot
+static void emit_branch(Prog* p, int op, int rs, int rt, int target) {
+    emit(p, op, R1, rs, rt, target);
+    emit(p, OP_ADD, R0, R0, R0, 0);
+}
+
+// Loop: for (addr = base; addr != base + count * step; addr += step) MEM[addr] += 1
+// Uses R2-R4 and R8
+static void emit_rmw_loop(Prog* p, int32_t base, int count, int step) {
+    emit_li(p, R2, base);
+    emit_li(p, R3, base + count * step);
+    emit_li(p, R4, step);
+    int loop = here(p);
+    emit(p, OP_LW, R8, R2, R0, 0);
+    emit(p, OP_ADD, R8, R8, R1, 1);
+    emit(p, OP_SW, R8, R2, R0, 0);
+    emit(p, OP_ADD, R2, R2, R4, 0);
+    emit_branch(p, OP_BNE, R2, R3, loop);
+}
+
+static int32_t private_base(int core) {
+    return PRIVATE_BASE + core * PRIVATE_WORDS;
+}
+
+static int32_t result_addr(int core) {
+    return RESULT_BASE + core * BLOCK_WORDS;
+}
+
+/* ---------------------------------------------------------------------------
+ * Workloads
+ * ---------------------------------------------------------------------------
+ */
+
+static void gen_matmul(const Params* prm, Prog* progs) {
+    int n = prm->size;
+    int32_t base_a = SHARED_BASE, base_b = base_a + n * n, base_c = base_b + n * n;
+
+    // 1. Inputs and native result
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            mem[base_a + i * n + j] = (i * 3 + j) % 7 + 1;
+            mem[base_b + i * n + j] = (i + j * 5) % 9 + 1;
+        }
+    }
+    memcpy(expect, mem, sizeof(int32_t) * MEM_WORDS);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j < n; j++) {
+            int32_t sum = 0;
+            for (int k = 0; k < n; k++) sum += mem[base_a + i * n + k] * mem[base_b + k * n + j];
+            expect[base_c + i * n + j] = sum;
+        }
+    }
+
+    // 2. Rows [start_row, end_row) per core
+    for (int core = 0; core < prm->cores; core++) {
+        Prog* p = &progs[core];
+        int start_row = core * n / prm->cores;
+        int end_row = (core + 1) * n / prm->cores;
+        if (start_row == end_row) continue;
+
+        emit_li(p, R5, base_a);
+        emit_li(p, R6, base_b);
+        emit_li(p, R7, base_c);
+        emit_li(p, R11, n);
+        emit_li(p, R2, start_row);                      // i
+        emit_li(p, R13, end_row);
+
+        int loop_i = here(p);
+        emit(p, OP_ADD, R3, R0, R0, 0);                 // j = 0
+        emit(p, OP_MUL, R14, R2, R11, 0);               // Row offset = i * n
+        int loop_j = here(p);
+        emit(p, OP_ADD, R8, R0, R0, 0);                 // sum = 0
+        emit(p, OP_ADD, R4, R0, R0, 0);                 // k = 0
+        int loop_k = here(p);
+        emit(p, OP_ADD, R12, R14, R4, 0);
+        emit(p, OP_LW, R9, R5, R12, 0);                 // A[i][k]
+        emit(p, OP_MUL, R12, R4, R11, 0);
+        emit(p, OP_ADD, R12, R12, R3, 0);
+        emit(p, OP_LW, R10, R6, R12, 0);                // B[k][j]
+        emit(p, OP_MUL, R12, R9, R10, 0);
+        emit(p, OP_ADD, R8, R8, R12, 0);
+        emit(p, OP_ADD, R4, R4, R1, 1);
+        emit_branch(p, OP_BNE, R4, R11, loop_k);
+        emit(p, OP_ADD, R12, R14, R3, 0);
+        emit(p, OP_SW, R8, R7, R12, 0);                 // C[i][j]
+        emit(p, OP_ADD, R3, R3, R1, 1);
+        emit_branch(p, OP_BNE, R3, R11, loop_j);
+        emit(p, OP_ADD, R2, R2, R1, 1);
+        emit_branch(p, OP_BNE, R2, R13, loop_i);
+    }
+}
+
+static void gen_sharing(const Params* prm, Prog* progs) {
+    int count = (prm->ws + prm->stride - 1) / prm->stride;
+    int32_t turn = SHARED_BASE;                         // Migratory token, own block
+    int32_t table = SHARED_BASE + BLOCK_WORDS;
+
+    // 1. Inputs
+    for (int core = 0; core < prm->cores; core++) {
+        for (int i = 0; i < count; i++) {
+            if (prm->pattern == P_PRIVATE) mem[private_base(core) + i * prm->stride] = core * 1000 + i;
+            if (prm->pattern == P_FALSE_SHARING) mem[table + i * prm->stride * prm->cores + core] = i;
+        }
+    }
+    if (prm->pattern == P_READ_SHARED || prm->pattern == P_MIGRATORY) {
+        for (int i = 0; i < count; i++) mem[table + i * prm->stride] = i + 1;
+    }
+    memcpy(expect, mem, sizeof(int32_t) * MEM_WORDS);
+
+    // 2. Native result
+    for (int core = 0; core < prm->cores; core++) {
+        int32_t sum = 0;
+        for (int i = 0; i < count; i++) {
+            switch (prm->pattern) {
+                case P_PRIVATE:       expect[private_base(core) + i * prm->stride] += prm->iters; break;
+                case P_FALSE_SHARING: expect[table + i * prm->stride * prm->cores + core] += prm->iters; break;
+                case P_MIGRATORY:     expect[table + i * prm->stride] += prm->iters; break;
+                case P_READ_SHARED:   sum += mem[table + i * prm->stride]; break;
+            }
+        }
+        if (prm->pattern == P_READ_SHARED) expect[result_addr(core)] = sum * prm->iters;
+    }
+
+    // 3. Programs
+    for (int core = 0; core < prm->cores; core++) {
+        Prog* p = &progs[core];
+        emit_li(p, R6, 0);                              // Iteration
+        emit_li(p, R7, prm->iters);
+        if (prm->pattern == P_MIGRATORY) {
+            emit_li(p, R9, turn);
+            emit_li(p, R10, core);                      // My turn
+            emit_li(p, R11, (core + 1) % prm->cores);   // Next turn
+        }
+        if (prm->pattern == P_READ_SHARED) emit_li(p, R5, 0);
+
+        int loop = here(p);
+        switch (prm->pattern) {
+            case P_PRIVATE:
+                emit_rmw_loop(p, private_base(core), count, prm->stride);
+                break;
+            case P_FALSE_SHARING:
+                emit_rmw_loop(p, table + core, count, prm->stride * prm->cores);
+                break;
+            case P_MIGRATORY: {
+                int wait = here(p);
+                emit(p, OP_LW, R12, R9, R0, 0);
+                emit_branch(p, OP_BNE, R12, R10, wait);
+                emit_rmw_loop(p, table, count, prm->stride);
+                emit(p, OP_SW, R11, R9, R0, 0);         // Pass the record on
+                break;
+            }
+            case P_READ_SHARED: {
+                emit_li(p, R2, table);
+                emit_li(p, R3, table + count * prm->stride);
+                emit_li(p, R4, prm->stride);
+                int read = here(p);
+                emit(p, OP_LW, R8, R2, R0, 0);
+                emit(p, OP_ADD, R5, R5, R8, 0);
+                emit(p, OP_ADD, R2, R2, R4, 0);
+                emit_branch(p, OP_BNE, R2, R3, read);
+                break;
+            }
+        }
+        emit(p, OP_ADD, R6, R6, R1, 1);
+        emit_branch(p, OP_BNE, R6, R7, loop);
+
+        if (prm->pattern == P_READ_SHARED) {
+            emit_li(p, R2, result_addr(core));
+            emit(p, OP_SW, R5, R2, R0, 0);
+        }
+    }
+}
+
+static void gen_lock(const Params* prm, Prog* progs) {
+    int32_t lock = SHARED_BASE;                         // Own block
+    int32_t record = SHARED_BASE + BLOCK_WORDS;
+
+    for (int i = 0; i < prm->hold; i++) expect[record + i] = prm->cores * prm->iters;
+
+    for (int core = 0; core < prm->cores; core++) {
+        Prog* p = &progs[core];
+        emit_li(p, R9, lock);
+        emit_li(p, R6, 0);
+        emit_li(p, R7, prm->iters);
+
+        int loop = here(p);
+        int spin = here(p);
+        emit(p, OP_LW, R10, R9, R0, 0);                 // Test: spin in the cache
+        emit_branch(p, OP_BNE, R10, R0, spin);
+        emit(p, OP_ADD, R10, R0, R1, 1);
+        emit(p, OP_CAS, R10, R9, R0, 0);                // Test-and-set
+        emit_branch(p, OP_BNE, R10, R0, spin);          // Lost the race
+        emit_rmw_loop(p, record, prm->hold, 1);         // Critical section
+        emit(p, OP_SW, R0, R9, R0, 0);                  // Release
+        emit(p, OP_ADD, R6, R6, R1, 1);
+        emit_branch(p, OP_BNE, R6, R7, loop);
+    }
+}
+
+// Cyclic permutation of the nodes (Sattolo), walked from node 0
+static void gen_chase(const Params* prm, Prog* progs) {
+    int* order = (int*)malloc(sizeof(int) * prm->ws);
+    unsigned rng = prm->seed;
+
+    for (int core = 0; core < prm->cores; core++) {
+        int32_t base = private_base(core);
+        for (int i = 0; i < prm->ws; i++) order[i] = i;
+        for (int i = prm->ws - 1; i > 0; i--) {
+            rng = rng * 1103515245u + 12345u;
+            int j = (int)((rng >> 8) % (unsigned)i);
+            int t = order[i]; order[i] = order[j]; order[j] = t;
+        }
+        // order[] is a single cycle: node k points to node order[k]
+        int32_t sum = 0;
+        for (int k = 0; k < prm->ws; k++) {
+            mem[base + k * prm->stride] = base + order[k] * prm->stride;
+            sum += base + k * prm->stride;
+        }
+        expect[result_addr(core)] = base;               // Back at the start
+        expect[result_addr(core) + 1] = sum * prm->iters;
+    }
+    for (int i = 0; i < MEM_WORDS; i++) {
+        if (mem[i] != 0) expect[i] = mem[i];
+    }
+    free(order);
+
+    for (int core = 0; core < prm->cores; core++) {
+        Prog* p = &progs[core];
+        emit_li(p, R2, private_base(core));             // Node pointer
+        emit_li(p, R3, prm->ws * prm->iters);           // Steps
+        emit_li(p, R4, 0);
+        emit_li(p, R5, 0);                              // Sum of visited nodes
+        int loop = here(p);
+        emit(p, OP_LW, R2, R2, R0, 0);
+        emit(p, OP_ADD, R5, R5, R2, 0);
+        emit(p, OP_ADD, R4, R4, R1, 1);
+        emit_branch(p, OP_BNE, R4, R3, loop);
+        emit_li(p, R6, result_addr(core));
+        emit(p, OP_SW, R2, R6, R0, 0);
+        emit(p, OP_SW, R5, R6, R1, 1);
+    }
+}
+
+/* ---------------------------------------------------------------------------
+ * Output
+ * ---------------------------------------------------------------------------
+ */
+
+// Words 0..last non-zero (at least one line), as the simulator reads and writes them
+static int write_image(const char* dir, const char* name, const int32_t* image) {
+    char filename[512];
+    int last = 0;
+    snprintf(filename, sizeof(filename), "%s/%s", dir, name);
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return 0;
+    }
+    for (int i = 0; i < MEM_WORDS; i++) {
+        if (image[i] != 0) last = i;
+    }
+    for (int i = 0; i <= last; i++) fprintf(fp, "%08X\n", (uint32_t)image[i]);
+    fclose(fp);
+    printf("Generated %s\n", filename);
+    return 1;
+}
+
+static int write_prog(const char* dir, int core, const Prog* p) {
+    char filename[512];
+    snprintf(filename, sizeof(filename), "%s/imem%d.txt", dir, core);
+    FILE* fp = fopen(filename, "w");
+    if (!fp) {
+        fprintf(stderr, "Error: Cannot create %s\n", filename);
+        return 0;
+    }
+    for (int i = 0; i < p->n; i++) fprintf(fp, "%08X\n", p->code[i]);
+    fclose(fp);
+    printf("Generated %s (%d instructions)\n", filename, p->n);
+    return 1;
+}
+
+/* ---------------------------------------------------------------------------
+ * Options
+ * ---------------------------------------------------------------------------
+ */
+
+static void usage(const char* prog) {
+    printf("Usage: %s [options]\n", prog);
+    printf("  --workload=W    matmul (default), sharing, lock, chase\n");
+    printf("  --out=DIR       Output directory, must exist (default .)\n");
+    printf("  --cores=N       Cores running the workload, 1-%d (default 4)\n", MAX_CORES);
+    printf("  --size=N        matmul: matrix size (default 16)\n");
+    printf("  --ws=N          sharing: words per core, chase: nodes (default 64)\n");
+    printf("  --stride=N      Words between accesses / nodes (default 1)\n");
+    printf("  --iters=N       Passes / lock acquisitions (default 4)\n");
+    printf("  --pattern=P     sharing: private (default), read-shared, migratory,\n");
+    printf("                  false-sharing\n");
+    printf("  --hold=N        lock: words updated while holding the lock (default 1)\n");
+    printf("  --seed=N        chase: permutation seed (default 1)\n");
+}
+
+static const char* value_of(const char* arg, const char* prefix) {
+    size_t len = strlen(prefix);
+    return (strncmp(arg, prefix, len) == 0) ? arg + len : NULL;
+}
+
+static int parse_args(int argc, char** argv, Params* prm) {
+    static const char* const workloads[] = { "matmul", "sharing", "lock", "chase" };
+    static const char* const patterns[] = { "private", "read-shared", "migratory", "false-sharing" };
+    const char* v;
+
+    for (int i = 1; i < argc; i++) {
+        const char* a = argv[i];
+        int ok = 1;
+        if ((v = value_of(a, "--workload=")) != NULL) {
+            ok = 0;
+            for (int w = 0; w < 4; w++) {
+                if (strcmp(v, workloads[w]) == 0) { prm->workload = (Workload)w; ok = 1; }
+            }
+        } else if ((v = value_of(a, "--pattern=")) != NULL) {
+            ok = 0;
+            for (int k = 0; k < 4; k++) {
+                if (strcmp(v, patterns[k]) == 0) { prm->pattern = (Pattern)k; ok = 1; }
+            }
+        } else if ((v = value_of(a, "--out=")) != NULL) {
+            prm->out = v;
+        } else if ((v = value_of(a, "--cores=")) != NULL) {
+            prm->cores = atoi(v);
+        } else if ((v = value_of(a, "--size=")) != NULL) {
+            prm->size = atoi(v);
+        } else if ((v = value_of(a, "--ws=")) != NULL) {
+            prm->ws = atoi(v);
+        } else if ((v = value_of(a, "--stride=")) != NULL) {
+            prm->stride = atoi(v);
+        } else if ((v = value_of(a, "--iters=")) != NULL) {
+            prm->iters = atoi(v);
+        } else if ((v = value_of(a, "--hold=")) != NULL) {
+            prm->hold = atoi(v);
+        } else if ((v = value_of(a, "--seed=")) != NULL) {
+            prm->seed = (unsigned)strtoul(v, NULL, 0);
+        } else {
+            ok = 0;
+        }
+        if (!ok) {
+            printf("Bad option: %s\n", a);
+            return 0;
+        }
+    }
+    return 1;
+}
+
+// Parameters that fit the memory layout
+static int check_params(const Params* prm) {
+    int span = ((prm->ws + prm->stride - 1) / prm->stride) * prm->stride;
+    const char* err = NULL;
+
+    if (prm->cores < 1 || prm->cores > MAX_CORES) err = "--cores out of range";
+    else if (prm->ws < 1 || prm->stride < 1 || prm->iters < 1 || prm->hold < 1) err = "--ws, --stride, --iters and --hold must be >= 1";
+    else if (prm->workload == W_MATMUL && (prm->size < 1 || 3 * prm->size * prm->size > RESULT_BASE)) err = "--size too large";
+    else if (prm->workload == W_CHASE && prm->ws * prm->stride > PRIVATE_WORDS) err = "--ws * --stride exceeds the per-core region";
+    else if (prm->workload == W_SHARING && prm->pattern == P_PRIVATE && span > PRIVATE_WORDS) err = "--ws exceeds the per-core region";
+    else if (prm->workload == W_SHARING && prm->pattern == P_FALSE_SHARING && span * prm->cores > RESULT_BASE - BLOCK_WORDS) err = "--ws * --cores exceeds the shared region";
+    else if (prm->workload == W_SHARING && span > RESULT_BASE - BLOCK_WORDS) err = "--ws exceeds the shared region";
+    else if (prm->workload == W_LOCK && prm->hold > RESULT_BASE - BLOCK_WORDS) err = "--hold exceeds the shared region";
+    if (err) printf("Error: %s\n", err);
+    return err == NULL;
+}
+
+int main(int argc, char** argv) {
+    Params prm = { W_MATMUL, P_PRIVATE, ".", 4, 16, 64, 1, 4, 1, 1 };
+    Prog* progs;
+    int ok = 1;
+
+    if (argc > 1 && strcmp(argv[1], "--help") == 0) {
+        usage(argv[0]);
+        return 0;
+    }
+    if (!parse_args(argc, argv, &prm) || !check_params(&prm)) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    int nfiles = (prm.cores > SIM_CORES) ? prm.cores : SIM_CORES;
+    mem = (int32_t*)calloc(MEM_WORDS, sizeof(int32_t));
+    expect = (int32_t*)calloc(MEM_WORDS, sizeof(int32_t));
+    progs = (Prog*)calloc(nfiles, sizeof(Prog));
+    if (!mem || !expect || !progs) {
+        printf("Error: Out of memory\n");
+        return 1;
+    }
+
+    // 1. Workload body and native results
+    switch (prm.workload) {
+        case W_MATMUL:  gen_matmul(&prm, progs); break;
+        case W_SHARING: gen_sharing(&prm, progs); break;
+        case W_LOCK:    gen_lock(&prm, progs); break;
+        case W_CHASE:   gen_chase(&prm, progs); break;
+    }
+
+    // 2. Halt; idle cores only halt
+    for (int core = 0; core < nfiles; core++) {
+        emit(&progs[core], OP_HALT, 0, 0, 0, 0);
+        if (progs[core].n > IMEM_WORDS) {
+            printf("Error: imem%d needs %d instructions (max %d)\n", core, progs[core].n, IMEM_WORDS);
+            return 1;
+        }
+    }
+
+    // 3. Files
+    ok &= write_image(prm.out, "memin.txt", mem);
+    ok &= write_image(prm.out, "expected_memout.txt", expect);
+    for (int core = 0; core < nfiles && ok; core++) ok &= write_prog(prm.out, core, &progs[core]);
+
+    free(progs);
+    free(expect);
+    free(mem);
+    return ok ? 0 : 1;
 }
@@ -0,0 +1,29 @@
+    ADD R4, R0, R0, 0       % [00] R4 = Address of Counter (0)
+    ADD R3, R0, R1, 16      % [01] R3 = Address of Lock (16, own block)
+    ADD R7, R0, R1, 32      % [02] R7 = 32 (Loop Limit)
+    ADD R6, R0, R0, 0       % [03] R6 = 0 (Loop Counter i)
+
+LOOP_START:
+    ADD R5, R0, R1, 1       % [04] R5 = 1
+    FAA R5, R4, R0, 0       % [05] Counter += 1 (atomic, R5 = old value)
+
+SPIN_LOCK:
+    LW  R2, R3, R0, 0       % [06] Test: load Lock (cache hit while held)
+    ADD R15, R0, R1, 6      % [07] R15 = SPIN_LOCK target (PC=6)
+    BNE R15, R2, R0, 0      % [08] If Lock != 0, keep spinning
+    ADD R2, R0, R1, 1       % [09] Delay slot: R2 = 1 (locked)
+    CAS R2, R3, R0, 0       % [10] Test-and-set: if Lock == 0, Lock = 1
+    BNE R15, R2, R0, 0      % [11] Lost the race (old != 0), spin again
+    ADD R0, R0, R0, 0       % [12] Delay slot
+
+    LW  R5, R4, R1, 8       % [13] Critical section: MEM[8]++
+    ADD R5, R5, R1, 1       % [14]
+    SW  R5, R4, R1, 8       % [15]
+    SW  R0, R3, R0, 0       % [16] Release Lock
+
+    ADD R6, R6, R1, 1       % [17] i++
+    ADD R15, R0, R1, 4      % [18] R15 = LOOP_START target (PC=4)
+    BNE R15, R6, R7, 0      % [19] If i != 32, Loop
+    ADD R0, R0, R0, 0       % [20] Delay slot
+
+    HALT                    % [21]
@@ -0,0 +1,56 @@
+% Barrier exchange, then an MWAIT flag hand-off.
+% Each core writes 100 + ID to its own block, meets the others at a BAR,
+% and copies its neighbour's value ((ID + 1) mod 4) to MEM[64 + 8*ID].
+% After a second BAR, core 0 waits a while, then writes DATA (777) and
+% sets FLAG; cores 1-3 sleep in MWAIT until the flag write invalidates
+% their copy, then copy DATA to MEM[96 + 8*ID].
+
+    % Get Core ID (Set per core before assembling)
+    ADD R12, R0, R1, 0      % [00] R12 = MyCoreID (0/1/2/3)
+    ADD R3, R0, R1, 3       % [01] R3 = 3 (8 words per block)
+    SLL R4, R12, R3, 0      % [02] R4 = 8 * ID (my block)
+    ADD R5, R12, R1, 100    % [03] R5 = 100 + ID
+    SW  R5, R4, R0, 0       % [04] MEM[8*ID] = 100 + ID
+    BAR                     % [05] Every value written
+
+    ADD R6, R12, R1, 1      % [06] R6 = ID + 1
+    AND R6, R6, R1, 3       % [07] Neighbour = (ID + 1) mod 4
+    SLL R6, R6, R3, 0       % [08] R6 = 8 * neighbour
+    LW  R7, R6, R0, 0       % [09] R7 = neighbour's value
+    SW  R7, R4, R1, 64      % [10] MEM[64 + 8*ID] = neighbour's value
+    BAR                     % [11] Every copy done
+
+    ADD R15, R0, R1, 29     % [12] R15 = PRODUCER target (PC=29)
+    BEQ R15, R12, R0, 0     % [13] Core 0 produces
+    ADD R0, R0, R0, 0       % [14] Delay slot
+
+SPIN:
+    LW  R2, R0, R1, 128     % [15] Load FLAG (MEM[128])
+    ADD R15, R0, R1, 23     % [16] R15 = DONE target (PC=23)
+    BNE R15, R2, R0, 0      % [17] FLAG set: leave
+    ADD R0, R0, R0, 0       % [18] Delay slot
+    MWAIT R0, R0, R1, 128   % [19] Sleep until FLAG's block is invalidated
+    ADD R15, R0, R1, 15     % [20] R15 = SPIN target (PC=15)
+    BEQ R15, R0, R0, 0      % [21] Back to SPIN
+    ADD R0, R0, R0, 0       % [22] Delay slot
+
+DONE:
+    LW  R8, R0, R1, 136     % [23] R8 = DATA (MEM[136])
+    SW  R8, R4, R1, 96      % [24] MEM[96 + 8*ID] = DATA
+    HALT                    % [25]
+    ADD R0, R0, R0, 0       % [26] HALT shadow
+    ADD R0, R0, R0, 0       % [27]
+    ADD R0, R0, R0, 0       % [28]
+
+PRODUCER:
+    ADD R9, R0, R1, 20      % [29] R9 = 20 (delay, so the others sleep)
+DELAY:
+    SUB R9, R9, R1, 1       % [30] R9--
+    ADD R15, R0, R1, 30     % [31] R15 = DELAY target (PC=30)
+    BNE R15, R9, R0, 0      % [32] Loop until R9 == 0
+    ADD R0, R0, R0, 0       % [33] Delay slot
+    ADD R10, R0, R1, 777    % [34] R10 = 777
+    SW  R10, R0, R1, 136    % [35] DATA = 777
+    ADD R10, R0, R1, 1      % [36] R10 = 1
+    SW  R10, R0, R1, 128    % [37] FLAG = 1
+    HALT                    % [38]
@@ -0,0 +1,48 @@
+% Run with --c2c (options.txt): the lowest-numbered clean holder supplies.
+% tests/c2c_forward runs the same program with --c2c-responder=forward.
+% A (MEM[0]) and B (MEM[8]) are read clean and passed between cores, one
+% core per phase, with a BAR between phases:
+%   1. core 0 reads A and B from memory (E)
+%   2. core 1 reads A: core 0 supplies from E, both S
+%   3. core 2 reads A: core 0 (lowest) or core 1 (F) supplies, then
+%      core 2 evicts A, dropping the F copy
+%   4. core 3 reads A: core 0 (lowest) or memory (no F left), then
+%      writes B: the BusRdX is answered by core 0's E copy
+% memout matches the run without --c2c.
+
+    % Get Core ID (Set per core before assembling)
+    ADD R12, R0, R1, 0      % [00] R12 = MyCoreID (0/1/2/3)
+
+    ADD R11, R0, R1, 0      % [01] Phase 1, core 0:
+    ADD R15, R0, R1, 7      % [02] R15 = BAR target (PC=7)
+    BNE R15, R12, R11, 0    % [03] Other cores skip
+    ADD R0, R0, R0, 0       % [04] Delay slot
+    LW  R2, R0, R1, 0       % [05] A (MEM[0]) from memory, E
+    LW  R3, R0, R1, 8       % [06] B (MEM[8]) from memory, E
+    BAR                     % [07]
+
+    ADD R11, R0, R1, 1      % [08] Phase 2, core 1:
+    ADD R15, R0, R1, 13     % [09] R15 = BAR target (PC=13)
+    BNE R15, R12, R11, 0    % [10]
+    ADD R0, R0, R0, 0       % [11] Delay slot
+    LW  R2, R0, R1, 0       % [12] A from core 0's E copy
+    BAR                     % [13]
+
+    ADD R11, R0, R1, 2      % [14] Phase 3, core 2:
+    ADD R15, R0, R1, 20     % [15] R15 = BAR target (PC=20)
+    BNE R15, R12, R11, 0    % [16]
+    ADD R0, R0, R0, 0       % [17] Delay slot
+    LW  R2, R0, R1, 0       % [18] A from core 0 (lowest) or core 1 (F)
+    LW  R4, R0, R1, 512     % [19] Evicts A, which was core 2's F copy
+    BAR                     % [20]
+
+    ADD R11, R0, R1, 3      % [21] Phase 4, core 3:
+    ADD R15, R0, R1, 27     % [22] R15 = HALT target (PC=27)
+    BNE R15, R12, R11, 0    % [23]
+    ADD R0, R0, R0, 0       % [24] Delay slot
+    LW  R2, R0, R1, 0       % [25] A from core 0 (lowest) or memory (no F)
+    SW  R2, R0, R1, 8       % [26] B = A; BusRdX answered by core 0's E copy
+    HALT                    % [27]
+    ADD R0, R0, R0, 0       % [28] HALT shadow
+    ADD R0, R0, R0, 0       % [29]
+    ADD R0, R0, R0, 0       % [30]
@@ -0,0 +1,15 @@
+% Run with --dual-issue (options.txt). The instructions behind a HALT
+% must commit as with single issue: R2-R4 only, R5-R8 stay 0.
+% Core 0 issues the HALT in lane 0. Core 1 is assembled with
+% "ADD R10, R0, R1, 10" inserted at [01], which pairs the HALT into
+% lane 1. Cores 2 and 3 are a single HALT.
+
+    ADD R9, R0, R1, 9       % [00] R9 = 9
+    HALT                    % [01]
+    ADD R2, R0, R1, 2       % [02] Shadow of the HALT: commits
+    ADD R3, R0, R1, 3       % [03] commits
+    ADD R4, R0, R1, 4       % [04] commits
+    ADD R5, R0, R1, 5       % [05] must not commit
+    ADD R6, R0, R1, 6       % [06]
+    ADD R7, R0, R1, 7       % [07]
+    ADD R8, R0, R1, 8       % [08]
@@ -0,0 +1,28 @@
+% Run with --forward (options.txt). tests/stall_causes runs the same
+% program with --stall-causes and no forwarding. Both must produce the
+% same registers and memory. Core 0 covers each bypass case; cores 1-3
+% are a single HALT.
+
+    ADD R2, R0, R1, 5       % [00] R2 = 5
+    ADD R3, R2, R1, 1       % [01] EX->EX: R3 = 6
+    ADD R4, R2, R3, 0       % [02] EX->EX (R3), MEM->EX (R2): R4 = 11
+    SW  R4, R0, R1, 16      % [03] Store data EX->EX: MEM[16] = 11
+    LW  R5, R0, R1, 16      % [04] R5 = 11
+    ADD R6, R5, R1, 1       % [05] Load-use interlock: R6 = 12
+    ADD R15, R0, R1, 11     % [06] R15 = target (PC=11)
+    BNE R15, R6, R0, 0      % [07] Branch operands wait for WB
+    ADD R7, R0, R1, 7       % [08] Delay slot: R7 = 7
+    ADD R8, R0, R1, 8       % [09] Skipped
+    ADD R8, R0, R1, 9       % [10] Skipped
+    ADD R10, R0, R1, 14     % [11] R10 = JAL target (PC=14)
+    JAL R10, R0, R0, 0      % [12] R15 = 13
+    SW  R15, R0, R1, 17     % [13] Delay slot: MEM[17] = 13
+    MUL R11, R4, R6, 0      % [14] R11 = 132
+    SW  R11, R0, R1, 18     % [15] MEM[18] = 132
+    LW  R12, R0, R1, 18     % [16] R12 = 132
+    ADD R0, R0, R0, 0       % [17]
+    ADD R13, R12, R1, 1     % [18] Load at distance 2: R13 = 133
+    HALT                    % [19]
+    ADD R0, R0, R0, 0       % [20] HALT shadow
+    ADD R0, R0, R0, 0       % [21]
+    ADD R0, R0, R0, 0       % [22]
@@ -0,0 +1,22 @@
+% Run with --threads=2 --mt-policy=rr and mt_fill_t1.asm as thread 1 of
+% core 0 (options.txt). Thread 0 stores to eight blocks of set 0, so each
+% of its misses evicts the block thread 1 is counting in, and thread 1's
+% misses evict thread 0's. While a fill lands, the other thread must miss
+% instead of reading the half-overwritten frame: MEM[1] ends at 8 and
+% MEM[512k + 1] at 100 + k. Cores 1-3 are a single HALT.
+
+    ADD R2, R0, R1, 512     % [00] R2 = 512 (set 0)
+    ADD R3, R0, R1, 8       % [01] R3 = 8 blocks
+    ADD R4, R0, R1, 100     % [02] R4 = 100
+LOOP:
+    ADD R4, R4, R1, 1       % [03] R4++
+    SW  R4, R2, R1, 1       % [04] MEM[R2 + 1] = R4, evicts set 0
+    ADD R2, R2, R1, 512     % [05] Next block of set 0
+    SUB R3, R3, R1, 1       % [06]
+    ADD R15, R0, R1, 3      % [07] R15 = LOOP target (PC=3)
+    BNE R15, R3, R0, 0      % [08]
+    ADD R0, R0, R0, 0       % [09] Delay slot
+    HALT                    % [10]
+    ADD R0, R0, R0, 0       % [11] HALT shadow
+    ADD R0, R0, R0, 0       % [12]
+    ADD R0, R0, R0, 0       % [13]
@@ -0,0 +1,16 @@
+% Thread 1 of core 0 (imem0_t1.txt): increment MEM[1], in block 0 of
+% set 0, eight times.
+
+    ADD R3, R0, R1, 8       % [00] R3 = 8
+LOOP:
+    LW  R2, R0, R1, 1       % [01] R2 = MEM[1]
+    ADD R2, R2, R1, 1       % [02]
+    SW  R2, R0, R1, 1       % [03] MEM[1] = R2 + 1
+    SUB R3, R3, R1, 1       % [04]
+    ADD R15, R0, R1, 1      % [05] R15 = LOOP target (PC=1)
+    BNE R15, R3, R0, 0      % [06]
+    ADD R0, R0, R0, 0       % [07] Delay slot
+    HALT                    % [08]
+    ADD R0, R0, R0, 0       % [09] HALT shadow
+    ADD R0, R0, R0, 0       % [10]
+    ADD R0, R0, R0, 0       % [11]
@@ -0,0 +1,62 @@
+% Run with --wb-buffer --wb-depth=2 --wb-drain=threshold:2 (options.txt).
+% Core 0 evicts dirty lines while cores 2 and 3 keep the bus busy with
+% read misses, so its buffer fills (wb_full_stall). It then leaves the
+% victim of block 8 queued, and core 1 reads block 8 from the buffer
+% (wb_snoop_hit). The victim of block 520 is still queued when core 0
+% halts and reaches memory at the end. memout matches the run without
+% the buffer.
+
+    % Get Core ID (Set per core before assembling)
+    ADD R12, R0, R1, 0      % [00] R12 = MyCoreID (0/1/2/3)
+    ADD R11, R0, R1, 1      % [01] R11 = 1
+    ADD R15, R0, R1, 29     % [02] R15 = READER target (PC=29)
+    BEQ R15, R12, R11, 0    % [03] Core 1 reads
+    ADD R11, R0, R1, 2      % [04] Delay slot: R11 = 2
+    ADD R15, R0, R1, 38     % [05] R15 = STREAM target (PC=38)
+    BGE R15, R12, R11, 0    % [06] Cores 2 and 3 stream
+    ADD R0, R0, R0, 0       % [07] Delay slot
+
+    ADD R2, R0, R1, 1       % [08] Core 0: five stores to set 0
+    SW  R2, R0, R1, 0       % [09] MEM[0] = 1
+    ADD R2, R0, R1, 2       % [10]
+    SW  R2, R0, R1, 512     % [11] MEM[512] = 2, evicts 0
+    ADD R2, R0, R1, 3       % [12]
+    SW  R2, R0, R1, 1024    % [13] MEM[1024] = 3, evicts 512
+    ADD R2, R0, R1, 4       % [14]
+    SW  R2, R0, R1, 1536    % [15] MEM[1536] = 4, evicts 1024
+    ADD R2, R0, R1, 5       % [16]
+    SW  R2, R0, R1, 0       % [17] MEM[0] = 5, evicts 1536
+    ADD R2, R0, R1, 6       % [18]
+    SW  R2, R0, R1, 8       % [19] MEM[8] = 6
+    ADD R2, R0, R1, 7       % [20]
+    SW  R2, R0, R1, 520     % [21] MEM[520] = 7, evicts 8
+    BAR                     % [22] Core 1 reads MEM[8]
+    BAR                     % [23]
+    ADD R2, R0, R1, 8       % [24]
+    SW  R2, R0, R1, 1032    % [25] MEM[1032] = 8, evicts 520
+    HALT                    % [26]
+    ADD R0, R0, R0, 0       % [27] HALT shadow
+    ADD R0, R0, R0, 0       % [28]
+
+    BAR                     % [29] READER (core 1)
+    LW  R3, R0, R1, 8       % [30] R3 = MEM[8]
+    SW  R3, R0, R1, 72      % [31] MEM[72] = MEM[8]
+    BAR                     % [32]
+    HALT                    % [33]
+    ADD R0, R0, R0, 0       % [34] HALT shadow
+    ADD R0, R0, R0, 0       % [35]
+    ADD R0, R0, R0, 0       % [36]
+    ADD R0, R0, R0, 0       % [37]
+
+    ADD R4, R12, R1, 2      % [38] STREAM (cores 2, 3): R4 = ID + 2
+    ADD R5, R0, R1, 10      % [39] R5 = 10
+    SLL R4, R4, R5, 0       % [40] R4 = (ID + 2) * 1024
+    ADD R6, R0, R1, 24      % [41] R6 = 24 blocks
+LOOP:
+    LW  R7, R4, R0, 0       % [42] Read miss
+    ADD R4, R4, R1, 8       % [43] Next block
+    SUB R6, R6, R1, 1       % [44]
+    ADD R15, R0, R1, 42     % [45] R15 = LOOP target (PC=42)
+    BNE R15, R6, R0, 0      % [46]
+    ADD R0, R0, R0, 0       % [47] Delay slot
+    HALT                    % [48]